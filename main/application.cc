@@ -8,9 +8,19 @@
 #include "font_awesome_symbols.h"
 #include "assets/lang_config.h"
 #include "mcp_server.h"
+#if CONFIG_USE_LOCAL_COMMANDS
+#include "local_commands.h"
+#endif
+#include "boot_sequence.h"
+#include "settings.h"
+#if CONFIG_DISPLAY_BENCHMARK
+#include "display_benchmark.h"
+#endif
 
 #include <cstring>
+#include <algorithm>
 #include <esp_log.h>
+#include <esp_app_desc.h>
 #include <cJSON.h>
 #include <driver/gpio.h>
 #include <arpa/inet.h>
@@ -72,11 +82,9 @@ void Application::CheckNewVersion(Ota& ota) {
     int retry_count = 0;
     int retry_delay = 10; // 初始重试延迟为10秒
 
-    auto& board = Board::GetInstance();
     while (true) {
         SetDeviceState(kDeviceStateActivating);
-        auto display = board.GetDisplay();
-        display->SetStatus(Lang::Strings::CHECKING_NEW_VERSION);
+        display_queue_->SetStatus(Lang::Strings::CHECKING_NEW_VERSION);
 
         if (!ota.CheckVersion()) {
             retry_count++;
@@ -102,80 +110,241 @@ void Application::CheckNewVersion(Ota& ota) {
         retry_count = 0;
         retry_delay = 10; // 重置重试延迟时间
 
-        if (ota.HasNewVersion()) {
+        if (HandleVersionResult(ota, false)) {
+            // Exit the loop if done checking new version
+            break;
+        }
+    }
+}
+
+// 处理 CheckVersion 得到的结果：升级、模型包升级和激活。下载和激活请求在调用者的任务中进行；
+// on_main_loop 为 true 时（后台检查），状态切换、提示、音频启停和重启都放到主循环中执行。
+// 返回 false 表示激活没有完成，需要重新检查
+bool Application::HandleVersionResult(Ota& ota, bool on_main_loop) {
+    // 后台检查时，用户可能已经在激活状态下按键或唤醒，此时不再切换状态，放弃这次升级或激活
+    auto run = [this, on_main_loop](std::function<void()> callback) {
+        if (!on_main_loop) {
+            callback();
+            return true;
+        }
+        bool done = false;
+        RunOnMainLoop([this, &callback, &done]() {
+            if (device_state_ == kDeviceStateActivating || device_state_ == kDeviceStateUpgrading) {
+                callback();
+                done = true;
+            }
+        });
+        return done;
+    };
+    auto& board = Board::GetInstance();
+    auto on_progress = [this](const OtaProgress& progress) {
+        // Posting to the display queue is cheap, no need to spawn a thread for each report
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%d%% %uKB/s", progress.progress, progress.speed / 1024);
+        display_queue_->SetChatMessage("system", buffer);
+    };
+
+    if (ota.HasNewVersion()) {
+        if (!run([this]() {
             Alert(Lang::Strings::OTA_UPGRADE, Lang::Strings::UPGRADING, "happy", Lang::Sounds::P3_UPGRADE);
+        })) {
+            return true;
+        }
 
-            vTaskDelay(pdMS_TO_TICKS(3000));
+        vTaskDelay(pdMS_TO_TICKS(3000));
 
+        if (!run([this, &board, &ota]() {
             SetDeviceState(kDeviceStateUpgrading);
-            
-            display->SetIcon(FONT_AWESOME_DOWNLOAD);
+
+            display_queue_->SetIcon(FONT_AWESOME_DOWNLOAD);
             std::string message = std::string(Lang::Strings::NEW_VERSION) + ota.GetFirmwareVersion();
-            display->SetChatMessage("system", message.c_str());
+            display_queue_->SetChatMessage("system", message.c_str());
 
             board.SetPowerSaveMode(false);
             audio_service_.Stop();
-            vTaskDelay(pdMS_TO_TICKS(1000));
+        })) {
+            return true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(1000));
 
-            bool upgrade_success = ota.StartUpgrade([display](int progress, size_t speed) {
-                std::thread([display, progress, speed]() {
-                    char buffer[32];
-                    snprintf(buffer, sizeof(buffer), "%d%% %uKB/s", progress, speed / 1024);
-                    display->SetChatMessage("system", buffer);
-                }).detach();
-            });
+        bool upgrade_success = ota.StartUpgrade(on_progress);
 
-            if (!upgrade_success) {
-                // Upgrade failed, restart audio service and continue running
-                ESP_LOGE(TAG, "Firmware upgrade failed, restarting audio service and continuing operation...");
+        if (!upgrade_success) {
+            // Upgrade failed, restart audio service and continue running
+            ESP_LOGE(TAG, "Firmware upgrade failed, restarting audio service and continuing operation...");
+            run([this, &board]() {
                 audio_service_.Start(); // Restart audio service
                 board.SetPowerSaveMode(true); // Restore power save mode
+                SetDeviceState(kDeviceStateActivating);
                 Alert(Lang::Strings::ERROR, Lang::Strings::UPGRADE_FAILED, "sad", Lang::Sounds::P3_EXCLAMATION);
-                vTaskDelay(pdMS_TO_TICKS(3000));
-                // Continue to normal operation (don't break, just fall through)
-            } else {
-                // Upgrade success, reboot immediately
-                ESP_LOGI(TAG, "Firmware upgrade successful, rebooting...");
-                display->SetChatMessage("system", "Upgrade successful, rebooting...");
-                vTaskDelay(pdMS_TO_TICKS(1000)); // Brief pause to show message
+            });
+            vTaskDelay(pdMS_TO_TICKS(3000));
+            // Continue to normal operation (don't break, just fall through)
+        } else {
+            // Upgrade success, reboot immediately
+            ESP_LOGI(TAG, "Firmware upgrade successful, rebooting...");
+            display_queue_->SetChatMessage("system", "Upgrade successful, rebooting...");
+            vTaskDelay(pdMS_TO_TICKS(1000)); // Brief pause to show message
+            run([this]() {
                 Reboot();
-                return; // This line will never be reached after reboot
-            }
+            });
+            return true; // This line will never be reached after reboot
         }
+    }
 
-        // No new version, mark the current version as valid
-        ota.MarkCurrentVersionValid();
-        if (!ota.HasActivationCode() && !ota.HasActivationChallenge()) {
-            xEventGroupSetBits(event_group_, MAIN_EVENT_CHECK_NEW_VERSION_DONE);
-            // Exit the loop if done checking new version
-            break;
+    // No new version, mark the current version as valid
+    ota.MarkCurrentVersionValid();
+
+    // 模型包单独升级，不需要下载整个固件
+    if (ota.HasNewModels()) {
+        if (!run([this, &board, &ota]() {
+            SetDeviceState(kDeviceStateUpgrading);
+            display_queue_->SetIcon(FONT_AWESOME_DOWNLOAD);
+            std::string message = std::string(Lang::Strings::NEW_VERSION) + ota.GetModelsVersion();
+            display_queue_->SetChatMessage("system", message.c_str());
+
+            board.SetPowerSaveMode(false);
+            audio_service_.Stop();
+        })) {
+            return true;
         }
+        bool models_loaded = !Ota::IsModelsUpdatePending();
+        bool upgrade_success = ota.StartModelsUpgrade(on_progress);
 
-        display->SetStatus(Lang::Strings::ACTIVATION);
+        // 模型在启动时加载，新模型包需要重启生效；原地写入失败时已加载的旧模型也已损坏
+        if (upgrade_success || (models_loaded && Ota::IsModelsUpdatePending())) {
+            ESP_LOGI(TAG, "Models upgrade %s, rebooting...", upgrade_success ? "successful" : "interrupted");
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            run([this]() {
+                Reboot();
+            });
+            return true;
+        }
+        ESP_LOGE(TAG, "Models upgrade failed, keeping the current models");
+        run([this, &board]() {
+            audio_service_.Start();
+            board.SetPowerSaveMode(true);
+            SetDeviceState(kDeviceStateActivating);
+            Alert(Lang::Strings::ERROR, Lang::Strings::UPGRADE_FAILED, "sad", Lang::Sounds::P3_EXCLAMATION);
+        });
+    }
+    if (!ota.HasActivationCode() && !ota.HasActivationChallenge()) {
+        SaveBootCache(ota);
+        xEventGroupSetBits(event_group_, MAIN_EVENT_CHECK_NEW_VERSION_DONE);
+        return true;
+    }
+
+    if (!run([this, &ota]() {
+        display_queue_->SetStatus(Lang::Strings::ACTIVATION);
         // Activation code is shown to the user and waiting for the user to input
         if (ota.HasActivationCode()) {
             ShowActivationCode(ota.GetActivationCode(), ota.GetActivationMessage());
         }
+    })) {
+        return true;
+    }
 
-        // This will block the loop until the activation is done or timeout
-        for (int i = 0; i < 10; ++i) {
-            ESP_LOGI(TAG, "Activating... %d/%d", i + 1, 10);
-            esp_err_t err = ota.Activate();
-            if (err == ESP_OK) {
-                xEventGroupSetBits(event_group_, MAIN_EVENT_CHECK_NEW_VERSION_DONE);
-                break;
-            } else if (err == ESP_ERR_TIMEOUT) {
-                vTaskDelay(pdMS_TO_TICKS(3000));
-            } else {
-                vTaskDelay(pdMS_TO_TICKS(10000));
+    // This will block the loop until the activation is done or timeout
+    for (int i = 0; i < 10; ++i) {
+        ESP_LOGI(TAG, "Activating... %d/%d", i + 1, 10);
+        esp_err_t err = ota.Activate();
+        if (err == ESP_OK) {
+            SaveBootCache(ota);
+            xEventGroupSetBits(event_group_, MAIN_EVENT_CHECK_NEW_VERSION_DONE);
+            // 启动时重新检查一次以取得激活后的配置；后台检查时协议已在运行，新配置下次连接时生效
+            return on_main_loop;
+        } else if (err == ESP_ERR_TIMEOUT) {
+            vTaskDelay(pdMS_TO_TICKS(3000));
+        } else {
+            vTaskDelay(pdMS_TO_TICKS(10000));
+        }
+        // 用户按键或唤醒会把设备切出激活状态，放弃这次激活
+        if (device_state_ != kDeviceStateActivating) {
+            break;
+        }
+    }
+    return on_main_loop;
+}
+
+// 在主循环中执行 callback 并等待它完成，供后台任务切换状态、提示或启停音频
+void Application::RunOnMainLoop(std::function<void()> callback) {
+    auto task = xTaskGetCurrentTaskHandle();
+    Schedule([callback = std::move(callback), task]() {
+        callback();
+        xTaskNotifyGive(task);
+    });
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+// Only called when the protocol was started from the cached config
+void Application::CheckNewVersionInBackground() {
+    BaseType_t ret = xTaskCreate([](void* arg) {
+        auto app = (Application*)arg;
+        const int MAX_RETRY = 10;
+        Ota ota;
+        int retry_count = 0;
+        int retry_delay = 10;
+        while (!ota.CheckVersion()) {
+            if (++retry_count >= MAX_RETRY) {
+                // 缓存的配置继续使用，TTL 耗尽后下次启动会走完整的版本检查
+                ESP_LOGE(TAG, "Background version check failed %d times, giving up", retry_count);
+                vTaskDelete(NULL);
+                return;
             }
-            if (device_state_ == kDeviceStateIdle) {
-                break;
+            ESP_LOGW(TAG, "Background version check failed, retry in %d seconds (%d/%d)", retry_delay, retry_count, MAX_RETRY);
+            vTaskDelay(pdMS_TO_TICKS(retry_delay * 1000));
+            retry_delay = std::min(retry_delay * 2, 600);
+        }
+        app->has_server_time_ = ota.HasServerTime();
+
+        if (ota.HasNewVersion() || ota.HasNewModels() || ota.HasActivationCode() || ota.HasActivationChallenge()) {
+            // 升级和激活需要提示用户：等设备空闲，由主循环关闭音频通道并切到激活状态。
+            // 之后直接使用这次检查的结果，下载和激活请求在本任务中进行，不阻塞主循环
+            bool ready = false;
+            while (!ready) {
+                while (app->device_state_ != kDeviceStateIdle) {
+                    vTaskDelay(pdMS_TO_TICKS(1000));
+                }
+                app->RunOnMainLoop([app, &ready]() {
+                    ready = app->device_state_ == kDeviceStateIdle;
+                    if (ready) {
+                        if (app->protocol_ && app->protocol_->IsAudioChannelOpened()) {
+                            app->protocol_->CloseAudioChannel();
+                        }
+                        app->SetDeviceState(kDeviceStateActivating);
+                    }
+                });
             }
+            app->HandleVersionResult(ota, true);
+            app->Schedule([app]() {
+                // 激活过程中用户可能已经唤醒设备，只恢复仍停留在激活状态的设备
+                if (app->device_state_ == kDeviceStateActivating) {
+                    app->SetDeviceState(kDeviceStateIdle);
+                }
+            });
+        } else {
+            // 新的协议配置已写入设置，协议下次连接时生效
+            ota.MarkCurrentVersionValid();
+            app->SaveBootCache(ota);
+            xEventGroupSetBits(app->event_group_, MAIN_EVENT_CHECK_NEW_VERSION_DONE);
         }
+        vTaskDelete(NULL);
+    }, "check_version", CONFIG_ESP_MAIN_TASK_STACK_SIZE, this, uxTaskPriorityGet(NULL), &check_new_version_task_handle_);
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create check_version task, using the cached config until it expires");
+        check_new_version_task_handle_ = nullptr;
     }
 }
 
+void Application::SaveBootCache(Ota& ota) {
+    if (!ota.HasMqttConfig() && !ota.HasWebsocketConfig()) {
+        return;
+    }
+    Settings settings("boot", true);
+    settings.SetString("protocol", ota.HasMqttConfig() ? "mqtt" : "websocket");
+    settings.SetInt("ttl", CONFIG_BOOT_CONFIG_CACHE_TTL);
+}
+
 void Application::ShowActivationCode(const std::string& code, const std::string& message) {
     struct digit_sound {
         char digit;
@@ -208,21 +377,21 @@ void Application::ShowActivationCode(const std::string& code, const std::string&
 
 void Application::Alert(const char* status, const char* message, const char* emotion, const std::string_view& sound) {
     ESP_LOGW(TAG, "Alert %s: %s [%s]", status, message, emotion);
-    auto display = Board::GetInstance().GetDisplay();
-    display->SetStatus(status);
-    display->SetEmotion(emotion);
-    display->SetChatMessage("system", message);
+    display_queue_->SetStatus(status);
+    display_queue_->SetEmotion(emotion);
+    display_queue_->SetChatMessage("system", message);
     if (!sound.empty()) {
+        // 网络步骤可能在音频初始化完成之前发出提示
+        xEventGroupWaitBits(event_group_, MAIN_EVENT_AUDIO_READY, pdFALSE, pdTRUE, portMAX_DELAY);
         audio_service_.PlaySound(sound);
     }
 }
 
 void Application::DismissAlert() {
     if (device_state_ == kDeviceStateIdle) {
-        auto display = Board::GetInstance().GetDisplay();
-        display->SetStatus(Lang::Strings::STANDBY);
-        display->SetEmotion("neutral");
-        display->SetChatMessage("system", "");
+        display_queue_->SetStatus(Lang::Strings::STANDBY);
+        display_queue_->SetEmotion("neutral");
+        display_queue_->SetChatMessage("system", "");
     }
 }
 
@@ -295,7 +464,9 @@ void Application::StartListening() {
         });
     } else if (device_state_ == kDeviceStateSpeaking) {
         Schedule([this]() {
-            AbortSpeaking(kAbortReasonNone);
+            // 直接从说话切到手动聆听，不经过空闲状态（否则会关闭再打开音频处理）
+            listening_mode_ = kListeningModeManualStop;
+            AbortSpeaking(kAbortReasonNone, kDeviceStateListening);
             SetListeningMode(kListeningModeManualStop);
         });
     }
@@ -328,53 +499,124 @@ void Application::StopListening() {
 
 void Application::Start() {
     auto& board = Board::GetInstance();
+
+    /* Setup the display, all updates from the application go through the display queue */
+    display_queue_ = std::make_unique<DisplayQueue>(board.GetDisplay());
+#if CONFIG_DISPLAY_BENCHMARK
+    DisplayBenchmark(board.GetDisplay()).Run();
+#endif
     SetDeviceState(kDeviceStateStarting);
 
-    /* Setup the display */
-    auto display = board.GetDisplay();
+    /* Start the clock timer to print the debug info */
+    esp_timer_start_periodic(clock_timer_handle_, 1000000);
+
+    /* Battery, network, mute and clock are sampled by the status service */
+    status_service_ = std::make_unique<StatusService>(display_queue_.get());
 
-    /* Setup the audio service */
+    /* Audio (including model loading) and network bring-up do not depend on each other */
+    BootSequence boot;
     auto codec = board.GetAudioCodec();
-    audio_service_.Initialize(codec);
-    audio_service_.Start();
+    int audio_step = boot.AddStep("audio", [this, codec]() {
+        audio_service_.Initialize(codec);
+        audio_service_.Start();
+
+        AudioServiceCallbacks callbacks;
+        callbacks.on_send_queue_available = [this]() {
+            xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
+        };
+        callbacks.on_decode_queue_available = [this]() {
+            xEventGroupSetBits(event_group_, MAIN_EVENT_DECODE_CREDIT);
+        };
+        callbacks.on_wake_word_detected = [this](const std::string& wake_word) {
+            xEventGroupSetBits(event_group_, MAIN_EVENT_WAKE_WORD_DETECTED);
+        };
+#if CONFIG_USE_LOCAL_COMMANDS
+        callbacks.on_local_command = [this](int command) {
+            auto detect_time = esp_timer_get_time();
+            Schedule([this, command, detect_time]() {
+                OnLocalCommand(command, detect_time);
+            });
+        };
+#endif
+        callbacks.on_vad_change = [this](bool speaking) {
+            xEventGroupSetBits(event_group_, MAIN_EVENT_VAD_CHANGE);
+        };
+        audio_service_.SetCallbacks(callbacks);
+#if CONFIG_USE_TTS_CACHE
+        tts_cache_.Initialize([this](std::unique_ptr<AudioStreamPacket> packet) {
+            return audio_service_.PushPacketToDecodeQueue(std::move(packet), true);
+        });
+#endif
+        xEventGroupSetBits(event_group_, MAIN_EVENT_AUDIO_READY);
+    }, {}, CONFIG_ESP_MAIN_TASK_STACK_SIZE);
+
+    int network_step = boot.AddStep("network", [this, &board]() {
+        board.StartNetwork();
+        // Update the status bar immediately to show the network state
+        status_service_->Refresh();
+    }, {}, CONFIG_ESP_MAIN_TASK_STACK_SIZE);
+
+    // 上次检查得到的协议配置仍在有效期内时直接使用，版本检查放到后台
+    Settings boot_cache("boot", true);
+    std::string protocol_type = boot_cache.GetString("protocol");
+    int cache_ttl = boot_cache.GetInt("ttl");
+    bool use_cache = !protocol_type.empty() && cache_ttl > 0;
+    int version_step = boot.AddStep("version", [&]() {
+        if (use_cache) {
+            ESP_LOGI(TAG, "Using cached %s config, %d boots left", protocol_type.c_str(), cache_ttl - 1);
+            boot_cache.SetInt("ttl", cache_ttl - 1);
+            CheckNewVersionInBackground();
+            return;
+        }
+        // Check for new firmware version or get the MQTT broker address
+        Ota ota;
+        CheckNewVersion(ota);
+        has_server_time_ = ota.HasServerTime();
+        if (ota.HasMqttConfig()) {
+            protocol_type = "mqtt";
+        } else if (ota.HasWebsocketConfig()) {
+            protocol_type = "websocket";
+        } else {
+            ESP_LOGW(TAG, "No protocol specified in the OTA config, using MQTT");
+            protocol_type = "mqtt";
+        }
+    }, {audio_step, network_step}, CONFIG_ESP_MAIN_TASK_STACK_SIZE);
 
-    AudioServiceCallbacks callbacks;
-    callbacks.on_send_queue_available = [this]() {
-        xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
-    };
-    callbacks.on_wake_word_detected = [this](const std::string& wake_word) {
-        xEventGroupSetBits(event_group_, MAIN_EVENT_WAKE_WORD_DETECTED);
-    };
-    callbacks.on_vad_change = [this](bool speaking) {
-        xEventGroupSetBits(event_group_, MAIN_EVENT_VAD_CHANGE);
-    };
-    audio_service_.SetCallbacks(callbacks);
+    bool protocol_started = false;
+    boot.AddStep("protocol", [&]() {
+        InitializeProtocol(protocol_type);
+        protocol_started = protocol_->Start();
+    }, {version_step}, CONFIG_ESP_MAIN_TASK_STACK_SIZE);
 
-    /* Start the clock timer to update the status bar */
-    esp_timer_start_periodic(clock_timer_handle_, 1000000);
+    boot.Run();
+
+    SetDeviceState(kDeviceStateIdle);
 
-    /* Wait for the network to be ready */
-    board.StartNetwork();
+    if (protocol_started) {
+        std::string message = std::string(Lang::Strings::VERSION) + esp_app_get_description()->version;
+        display_queue_->ShowNotification(message.c_str());
+        display_queue_->SetChatMessage("system", "");
+        // Play the success sound to indicate the device is ready
+        audio_service_.PlaySound(Lang::Sounds::P3_SUCCESS);
+    }
 
-    // Update the status bar immediately to show the network state
-    display->UpdateStatusBar(true);
+    // Print heap stats
+    SystemInfo::PrintHeapStats();
+}
 
-    // Check for new firmware version or get the MQTT broker address
-    Ota ota;
-    CheckNewVersion(ota);
+void Application::InitializeProtocol(const std::string& type) {
+    auto& board = Board::GetInstance();
+    auto codec = board.GetAudioCodec();
 
     // Initialize the protocol
-    display->SetStatus(Lang::Strings::LOADING_PROTOCOL);
+    display_queue_->SetStatus(Lang::Strings::LOADING_PROTOCOL);
 
     // Add MCP common tools before initializing the protocol
     McpServer::GetInstance().AddCommonTools();
 
-    if (ota.HasMqttConfig()) {
-        protocol_ = std::make_unique<MqttProtocol>();
-    } else if (ota.HasWebsocketConfig()) {
+    if (type == "websocket") {
         protocol_ = std::make_unique<WebsocketProtocol>();
     } else {
-        ESP_LOGW(TAG, "No protocol specified in the OTA config, using MQTT");
         protocol_ = std::make_unique<MqttProtocol>();
     }
 
@@ -383,12 +625,25 @@ void Application::Start() {
         xEventGroupSetBits(event_group_, MAIN_EVENT_ERROR);
     });
     protocol_->OnIncomingAudio([this](std::unique_ptr<AudioStreamPacket> packet) {
-        if (device_state_ == kDeviceStateSpeaking) {
+        if (device_state_ == kDeviceStateSpeaking && !aborted_) {
+#if CONFIG_USE_TTS_CACHE
+            if (tts_cache_.OnIncomingAudio(packet)) {
+                return;
+            }
+#endif
             audio_service_.PushPacketToDecodeQueue(std::move(packet));
         }
     });
     protocol_->OnAudioChannelOpened([this, codec, &board]() {
         board.SetPowerSaveMode(false);
+        xEventGroupSetBits(event_group_, MAIN_EVENT_DECODE_CREDIT);
+#if CONFIG_USE_LOCAL_COMMANDS && CONFIG_LOCAL_COMMANDS_NOTIFY_SERVER
+        Schedule([this]() {
+            for (auto& notification : LocalCommands::GetInstance().TakeNotifications()) {
+                protocol_->SendMcpMessage(notification);
+            }
+        });
+#endif
         if (protocol_->server_sample_rate() != codec->output_sample_rate()) {
             ESP_LOGW(TAG, "Server sample rate %d does not match device output sample rate %d, resampling may cause distortion",
                 protocol_->server_sample_rate(), codec->output_sample_rate());
@@ -397,17 +652,17 @@ void Application::Start() {
     protocol_->OnAudioChannelClosed([this, &board]() {
         board.SetPowerSaveMode(true);
         Schedule([this]() {
-            auto display = Board::GetInstance().GetDisplay();
-            display->SetChatMessage("system", "");
+            display_queue_->SetChatMessage("system", "");
             SetDeviceState(kDeviceStateIdle);
         });
     });
-    protocol_->OnIncomingJson([this, display](const cJSON* root) {
+    protocol_->OnIncomingJson([this](const cJSON* root) {
         // Parse JSON data
         auto type = cJSON_GetObjectItem(root, "type");
         if (strcmp(type->valuestring, "tts") == 0) {
             auto state = cJSON_GetObjectItem(root, "state");
             if (strcmp(state->valuestring, "start") == 0) {
+                speaking_turn_++;
                 Schedule([this]() {
                     aborted_ = false;
                     if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
@@ -415,37 +670,59 @@ void Application::Start() {
                     }
                 });
             } else if (strcmp(state->valuestring, "stop") == 0) {
-                Schedule([this]() {
-                    if (device_state_ == kDeviceStateSpeaking) {
-                        if (listening_mode_ == kListeningModeManualStop) {
-                            SetDeviceState(kDeviceStateIdle);
-                        } else {
-                            SetDeviceState(kDeviceStateListening);
+#if CONFIG_USE_TTS_CACHE
+                tts_cache_.EndSentence();
+#endif
+                // 等已收到的音频真正从扬声器播放完再切换状态，避免回声进入麦克风
+                AddPlaybackMarker([this, turn = speaking_turn_.load()]() {
+                    Schedule([this, turn]() {
+                        if (device_state_ == kDeviceStateSpeaking && turn == speaking_turn_) {
+                            if (listening_mode_ == kListeningModeManualStop) {
+                                SetDeviceState(kDeviceStateIdle);
+                            } else {
+                                SetDeviceState(kDeviceStateListening);
+                            }
                         }
-                    }
+                    });
                 });
             } else if (strcmp(state->valuestring, "sentence_start") == 0) {
+                // 字幕在这一句的音频开始播放时显示
                 auto text = cJSON_GetObjectItem(root, "text");
                 if (cJSON_IsString(text)) {
                     ESP_LOGI(TAG, "<< %s", text->valuestring);
-                    Schedule([this, display, message = std::string(text->valuestring)]() {
-                        display->SetChatMessage("assistant", message.c_str());
+                    AddPlaybackMarker([this, message = std::string(text->valuestring)]() {
+                        Schedule([this, message]() {
+                            display_queue_->SetChatMessage("assistant", message.c_str());
+                        });
+                    });
+                }
+#if CONFIG_USE_TTS_CACHE
+                // 命中时本地播放，并让服务器停止下发这一句的音频
+                auto hash = cJSON_GetObjectItem(root, "hash");
+                // 被打断的一轮迟到的句子不再命中或录制，由 speaking_turn_ 区分
+                uint32_t turn = speaking_turn_;
+                if (tts_cache_.BeginSentence(cJSON_IsString(hash) ? hash->valuestring : "", turn)) {
+                    Schedule([this, turn, hash_str = std::string(hash->valuestring)]() {
+                        if (!aborted_ && turn == speaking_turn_) {
+                            protocol_->SendTtsCacheHit(hash_str);
+                        }
                     });
                 }
+#endif
             }
         } else if (strcmp(type->valuestring, "stt") == 0) {
             auto text = cJSON_GetObjectItem(root, "text");
             if (cJSON_IsString(text)) {
                 ESP_LOGI(TAG, ">> %s", text->valuestring);
-                Schedule([this, display, message = std::string(text->valuestring)]() {
-                    display->SetChatMessage("user", message.c_str());
+                Schedule([this, message = std::string(text->valuestring)]() {
+                    display_queue_->SetChatMessage("user", message.c_str());
                 });
             }
         } else if (strcmp(type->valuestring, "llm") == 0) {
             auto emotion = cJSON_GetObjectItem(root, "emotion");
             if (cJSON_IsString(emotion)) {
-                Schedule([this, display, emotion_str = std::string(emotion->valuestring)]() {
-                    display->SetEmotion(emotion_str.c_str());
+                Schedule([this, emotion_str = std::string(emotion->valuestring)]() {
+                    display_queue_->SetEmotion(emotion_str.c_str());
                 });
             }
         } else if (strcmp(type->valuestring, "mcp") == 0) {
@@ -480,8 +757,8 @@ void Application::Start() {
             auto payload = cJSON_GetObjectItem(root, "payload");
             ESP_LOGI(TAG, "Received custom message: %s", cJSON_PrintUnformatted(root));
             if (cJSON_IsObject(payload)) {
-                Schedule([this, display, payload_str = std::string(cJSON_PrintUnformatted(payload))]() {
-                    display->SetChatMessage("system", payload_str.c_str());
+                Schedule([this, payload_str = std::string(cJSON_PrintUnformatted(payload))]() {
+                    display_queue_->SetChatMessage("system", payload_str.c_str());
                 });
             } else {
                 ESP_LOGW(TAG, "Invalid custom message format: missing payload");
@@ -491,34 +768,39 @@ void Application::Start() {
             ESP_LOGW(TAG, "Unknown message type: %s", type->valuestring);
         }
     });
-    bool protocol_started = protocol_->Start();
-
-    SetDeviceState(kDeviceStateIdle);
-
-    has_server_time_ = ota.HasServerTime();
-    if (protocol_started) {
-        std::string message = std::string(Lang::Strings::VERSION) + ota.GetCurrentVersion();
-        display->ShowNotification(message.c_str());
-        display->SetChatMessage("system", "");
-        // Play the success sound to indicate the device is ready
-        audio_service_.PlaySound(Lang::Sounds::P3_SUCCESS);
-    }
-
-    // Print heap stats
-    SystemInfo::PrintHeapStats();
 }
 
 void Application::OnClockTimer() {
     clock_ticks_++;
 
-    auto display = Board::GetInstance().GetDisplay();
-    display->UpdateStatusBar();
-
     // Print the debug info every 10 seconds
     if (clock_ticks_ % 10 == 0) {
         // SystemInfo::PrintTaskCpuUsage(pdMS_TO_TICKS(1000));
         // SystemInfo::PrintTaskList();
         SystemInfo::PrintHeapStats();
+
+        auto& stats = audio_service_.debug_statistics();
+        if (stats.decode_dropped > 0 || stats.decode_stalls > 0) {
+            ESP_LOGI(TAG, "Decode queue: %lu packets dropped, %lu stalls", stats.decode_dropped, stats.decode_stalls);
+        }
+        // 淡出帧在打断后几毫秒内写出，上次统计之前排队的淡出帧现在还没写出说明被丢掉了
+        uint32_t missing_fades = last_abort_fades_queued_ - std::min(last_abort_fades_queued_, stats.abort_fades_played);
+        if (missing_fades > last_missing_fades_) {
+            ESP_LOGW(TAG, "Abort fades: %lu queued, %lu played", stats.abort_fades_queued, stats.abort_fades_played);
+        }
+        last_abort_fades_queued_ = stats.abort_fades_queued;
+        last_missing_fades_ = missing_fades;
+
+        // 总线速率按本次统计间隔计算，没有刷新时为 0
+        auto flush = display_queue_->display()->GetFlushStatistics();
+        uint32_t flush_bytes = flush.total_bytes - last_flush_total_bytes_;
+        last_flush_total_bytes_ = flush.total_bytes;
+        if (flush_bytes > 0) {
+            ESP_LOGI(TAG, "Display flushes: %lu, bus: %lu bytes/s", flush.flush_count, flush_bytes / 10);
+        }
+        auto queue_stats = display_queue_->GetStatistics();
+        ESP_LOGI(TAG, "Display queue: %lu posted, %lu coalesced, %lu batches, %lu bytes stack free",
+            queue_stats.posted_count, queue_stats.coalesced_count, queue_stats.batch_count, queue_stats.stack_free_bytes);
     }
 }
 
@@ -543,6 +825,7 @@ void Application::MainEventLoop() {
             MAIN_EVENT_SEND_AUDIO |
             MAIN_EVENT_WAKE_WORD_DETECTED |
             MAIN_EVENT_VAD_CHANGE |
+            MAIN_EVENT_DECODE_CREDIT |
             MAIN_EVENT_ERROR, pdTRUE, pdFALSE, portMAX_DELAY);
         if (bits & MAIN_EVENT_ERROR) {
             SetDeviceState(kDeviceStateIdle);
@@ -557,6 +840,20 @@ void Application::MainEventLoop() {
             }
         }
 
+        if (bits & MAIN_EVENT_DECODE_CREDIT) {
+            // 先读序号再读余量，两者之间收到的包只会让额度偏小
+            if (protocol_ && protocol_->IsAudioChannelOpened()) {
+                uint32_t sequence = protocol_->incoming_audio_sequence();
+                size_t headroom = audio_service_.GetDecodeQueueHeadroom();
+#if CONFIG_USE_TTS_CACHE
+                // 本地播放缓存时服务器音频排在 TtsCache 中，之后会阻塞送入解码队列，同样占用额度
+                size_t pending = tts_cache_.GetPendingPackets();
+                headroom = headroom > pending ? headroom - pending : 0;
+#endif
+                protocol_->SendFlowCredit(sequence + headroom);
+            }
+        }
+
         if (bits & MAIN_EVENT_WAKE_WORD_DETECTED) {
             OnWakeWordDetected();
         }
@@ -617,10 +914,53 @@ void Application::OnWakeWordDetected() {
     }
 }
 
-void Application::AbortSpeaking(AbortReason reason) {
+#if CONFIG_USE_LOCAL_COMMANDS
+// 命令词在本地直接调用 MCP 工具，不打开音频通道；已连接时立即通知服务器
+void Application::OnLocalCommand(int command, int64_t detect_time) {
+    if (device_state_ != kDeviceStateIdle) {
+        return;
+    }
+    auto& commands = LocalCommands::GetInstance();
+    commands.Execute(command);
+    ESP_LOGI(TAG, "Local command %d done %lld ms after detection", command, (esp_timer_get_time() - detect_time) / 1000);
+
+#if CONFIG_LOCAL_COMMANDS_NOTIFY_SERVER
+    if (protocol_ && protocol_->IsAudioChannelOpened()) {
+        for (auto& notification : commands.TakeNotifications()) {
+            protocol_->SendMcpMessage(notification);
+        }
+    }
+#endif
+}
+#endif
+
+// 本地立即停止播放并切换状态，不等待服务器回复 tts stop；
+// 被打断的一轮在下一个 tts start 之前到达的音频都会被丢弃
+void Application::AbortSpeaking(AbortReason reason, DeviceState next_state) {
     ESP_LOGI(TAG, "Abort speaking");
     aborted_ = true;
+#if CONFIG_USE_TTS_CACHE
+    tts_cache_.Discard(speaking_turn_);
+#endif
+    audio_service_.AbortPlayback();
     protocol_->SendAbortSpeaking(reason);
+
+    if (device_state_ == kDeviceStateSpeaking) {
+        if (next_state == kDeviceStateUnknown) {
+            next_state = listening_mode_ == kListeningModeManualStop ? kDeviceStateIdle : kDeviceStateListening;
+        }
+        SetDeviceState(next_state);
+    }
+}
+
+// 目前收到的音频播放完后调用 callback（不在主任务中）；TTS 缓存本地播放的音频也计算在内
+void Application::AddPlaybackMarker(std::function<void()> callback) {
+#if CONFIG_USE_TTS_CACHE
+    if (tts_cache_.RunAfterQueued([this, callback]() { audio_service_.AddPlaybackMarker(callback); })) {
+        return;
+    }
+#endif
+    audio_service_.AddPlaybackMarker(std::move(callback));
 }
 
 void Application::SetListeningMode(ListeningMode mode) {
@@ -641,26 +981,31 @@ void Application::SetDeviceState(DeviceState state) {
     // Send the state change event
     DeviceStateEventManager::GetInstance().PostStateChangeEvent(previous_state, state);
 
+#if CONFIG_USE_TTS_CACHE
+    if (state != kDeviceStateSpeaking) {
+        tts_cache_.SetPlaybackEnabled(false, speaking_turn_);
+    }
+#endif
+
     auto& board = Board::GetInstance();
-    auto display = board.GetDisplay();
     auto led = board.GetLed();
     led->OnStateChanged();
     switch (state) {
         case kDeviceStateUnknown:
         case kDeviceStateIdle:
-            display->SetStatus(Lang::Strings::STANDBY);
-            display->SetEmotion("neutral");
+            display_queue_->SetStatus(Lang::Strings::STANDBY);
+            display_queue_->SetEmotion("neutral");
             audio_service_.EnableVoiceProcessing(false);
             audio_service_.EnableWakeWordDetection(true);
             break;
         case kDeviceStateConnecting:
-            display->SetStatus(Lang::Strings::CONNECTING);
-            display->SetEmotion("neutral");
-            display->SetChatMessage("system", "");
+            display_queue_->SetStatus(Lang::Strings::CONNECTING);
+            display_queue_->SetEmotion("neutral");
+            display_queue_->SetChatMessage("system", "");
             break;
         case kDeviceStateListening:
-            display->SetStatus(Lang::Strings::LISTENING);
-            display->SetEmotion("neutral");
+            display_queue_->SetStatus(Lang::Strings::LISTENING);
+            display_queue_->SetEmotion("neutral");
 
             // Make sure the audio processor is running
             if (!audio_service_.IsAudioProcessorRunning()) {
@@ -671,7 +1016,7 @@ void Application::SetDeviceState(DeviceState state) {
             }
             break;
         case kDeviceStateSpeaking:
-            display->SetStatus(Lang::Strings::SPEAKING);
+            display_queue_->SetStatus(Lang::Strings::SPEAKING);
 
             if (listening_mode_ != kListeningModeRealtime) {
                 audio_service_.EnableVoiceProcessing(false);
@@ -683,6 +1028,9 @@ void Application::SetDeviceState(DeviceState state) {
 #endif
             }
             audio_service_.ResetDecoder();
+#if CONFIG_USE_TTS_CACHE
+            tts_cache_.SetPlaybackEnabled(true, speaking_turn_);
+#endif
             break;
         default:
             // Do nothing
@@ -744,20 +1092,18 @@ void Application::SendMcpMessage(const std::string& payload) {
 void Application::SetAecMode(AecMode mode) {
     aec_mode_ = mode;
     Schedule([this]() {
-        auto& board = Board::GetInstance();
-        auto display = board.GetDisplay();
         switch (aec_mode_) {
         case kAecOff:
             audio_service_.EnableDeviceAec(false);
-            display->ShowNotification(Lang::Strings::RTC_MODE_OFF);
+            display_queue_->ShowNotification(Lang::Strings::RTC_MODE_OFF);
             break;
         case kAecOnServerSide:
             audio_service_.EnableDeviceAec(false);
-            display->ShowNotification(Lang::Strings::RTC_MODE_ON);
+            display_queue_->ShowNotification(Lang::Strings::RTC_MODE_ON);
             break;
         case kAecOnDeviceSide:
             audio_service_.EnableDeviceAec(true);
-            display->ShowNotification(Lang::Strings::RTC_MODE_ON);
+            display_queue_->ShowNotification(Lang::Strings::RTC_MODE_ON);
             break;
         }
 
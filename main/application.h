@@ -11,11 +11,17 @@
 #include <deque>
 #include <vector>
 #include <memory>
+#include <atomic>
 
 #include "protocol.h"
 #include "ota.h"
 #include "audio_service.h"
+#if CONFIG_USE_TTS_CACHE
+#include "tts_cache.h"
+#endif
 #include "device_state_event.h"
+#include "display_queue.h"
+#include "status_service.h"
 
 #define MAIN_EVENT_SCHEDULE (1 << 0)
 #define MAIN_EVENT_SEND_AUDIO (1 << 1)
@@ -23,6 +29,8 @@
 #define MAIN_EVENT_VAD_CHANGE (1 << 3)
 #define MAIN_EVENT_ERROR (1 << 4)
 #define MAIN_EVENT_CHECK_NEW_VERSION_DONE (1 << 5)
+#define MAIN_EVENT_AUDIO_READY (1 << 6)
+#define MAIN_EVENT_DECODE_CREDIT (1 << 7)
 
 enum AecMode {
     kAecOff,
@@ -48,7 +56,8 @@ public:
     void SetDeviceState(DeviceState state);
     void Alert(const char* status, const char* message, const char* emotion = "", const std::string_view& sound = "");
     void DismissAlert();
-    void AbortSpeaking(AbortReason reason);
+    // next_state 为 kDeviceStateUnknown 时按聆听模式回到空闲或聆听
+    void AbortSpeaking(AbortReason reason, DeviceState next_state = kDeviceStateUnknown);
     void ToggleChatState();
     void StartListening();
     void StopListening();
@@ -60,6 +69,8 @@ public:
     AecMode GetAecMode() const { return aec_mode_; }
     void PlaySound(const std::string_view& sound);
     AudioService& GetAudioService() { return audio_service_; }
+    DisplayQueue* GetDisplayQueue() { return display_queue_.get(); }
+    StatusService* GetStatusService() { return status_service_.get(); }
 
 private:
     Application();
@@ -75,17 +86,38 @@ private:
     AecMode aec_mode_ = kAecOff;
     std::string last_error_message_;
     AudioService audio_service_;
+#if CONFIG_USE_TTS_CACHE
+    TtsCache tts_cache_;
+#endif
+    std::unique_ptr<DisplayQueue> display_queue_;
+    std::unique_ptr<StatusService> status_service_;
 
-    bool has_server_time_ = false;
-    bool aborted_ = false;
+    // 后台版本检查任务也会写入
+    std::atomic<bool> has_server_time_ = false;
+    // 网络任务也会读取，用于丢弃被打断的一轮中迟到的音频
+    std::atomic<bool> aborted_ = false;
+    // 每个 tts start 加一，播放完成的回调据此忽略已经过去的一轮
+    std::atomic<uint32_t> speaking_turn_ = 0;
     int clock_ticks_ = 0;
+    uint32_t last_flush_total_bytes_ = 0;
+    uint32_t last_abort_fades_queued_ = 0;
+    uint32_t last_missing_fades_ = 0;
     TaskHandle_t check_new_version_task_handle_ = nullptr;
 
     void OnWakeWordDetected();
+#if CONFIG_USE_LOCAL_COMMANDS
+    void OnLocalCommand(int command, int64_t detect_time);
+#endif
     void CheckNewVersion(Ota& ota);
+    bool HandleVersionResult(Ota& ota, bool on_main_loop);
+    void RunOnMainLoop(std::function<void()> callback);
+    void CheckNewVersionInBackground();
+    void SaveBootCache(Ota& ota);
+    void InitializeProtocol(const std::string& type);
     void ShowActivationCode(const std::string& code, const std::string& message);
     void OnClockTimer();
     void SetListeningMode(ListeningMode mode);
+    void AddPlaybackMarker(std::function<void()> callback);
 };
 
 #endif // _APPLICATION_H_
@@ -0,0 +1,137 @@
+#include "audio_clock.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <vector>
+
+#define TAG "AudioClock"
+
+// 约 1 秒的 60ms 帧，足够覆盖 AFE 与 DMA 的延迟
+#define MAX_RENDERED_FRAMES 16
+
+AudioClock::AudioClock() {
+    esp_timer_create_args_t marker_timer_args = {
+        .callback = [](void* arg) {
+            auto clock = (AudioClock*)arg;
+            clock->OnMarkerTimer();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "audio_clock",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_create(&marker_timer_args, &marker_timer_);
+}
+
+AudioClock::~AudioClock() {
+    if (marker_timer_ != nullptr) {
+        esp_timer_stop(marker_timer_);
+        esp_timer_delete(marker_timer_);
+    }
+}
+
+void AudioClock::Configure(int sample_rate, int dma_buffered_samples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sample_rate_ = sample_rate;
+    dma_latency_us_ = SamplesToUs(dma_buffered_samples);
+    ESP_LOGI(TAG, "Output %d Hz, DMA latency %lld ms", sample_rate_, dma_latency_us_ / 1000);
+}
+
+void AudioClock::OnWrite(int samples, int64_t write_start_us, int64_t write_end_us, uint32_t timestamp) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 上一帧还没播放完时紧接其后，否则（欠载）从写入时开始播放
+    int64_t start_us = std::max(play_end_us_, write_start_us);
+    int64_t end_us = start_us + SamplesToUs(samples);
+    // 写入返回时 DMA 中最多还有 dma_latency_us_ 的数据，以此修正累积误差
+    end_us = std::min(end_us, write_end_us + dma_latency_us_);
+    play_end_us_ = end_us;
+    written_samples_ += samples;
+
+    if (timestamp > 0) {
+        frames_.push_back({end_us - SamplesToUs(samples), end_us, timestamp});
+        while (frames_.size() > MAX_RENDERED_FRAMES) {
+            frames_.pop_front();
+        }
+    }
+}
+
+void AudioClock::Reset() {
+    std::vector<std::function<void()>> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        play_end_us_ = 0;
+        frames_.clear();
+        for (auto& marker : markers_) {
+            callbacks.push_back(std::move(marker.callback));
+        }
+        markers_.clear();
+        esp_timer_stop(marker_timer_);
+    }
+    for (auto& callback : callbacks) {
+        callback();
+    }
+}
+
+int64_t AudioClock::GetWrittenSamples() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return written_samples_;
+}
+
+int64_t AudioClock::GetRenderedSamples() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t pending_us = std::max<int64_t>(0, play_end_us_ - esp_timer_get_time());
+    return written_samples_ - pending_us * sample_rate_ / 1000000;
+}
+
+int64_t AudioClock::GetPendingUs() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::max<int64_t>(0, play_end_us_ - esp_timer_get_time());
+}
+
+uint32_t AudioClock::GetTimestampAt(int64_t time_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = frames_.rbegin(); it != frames_.rend(); ++it) {
+        if (it->start_us <= time_us) {
+            return time_us < it->end_us ? it->timestamp : 0;
+        }
+    }
+    return 0;
+}
+
+void AudioClock::AddMarker(std::function<void()> callback) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    int64_t now = esp_timer_get_time();
+    if (play_end_us_ <= now) {
+        lock.unlock();
+        callback();
+        return;
+    }
+    markers_.push_back({play_end_us_, std::move(callback)});
+    if (markers_.size() == 1) {
+        ArmMarkerTimer(now);
+    }
+}
+
+// 调用时需持有 mutex_
+void AudioClock::ArmMarkerTimer(int64_t now) {
+    esp_timer_stop(marker_timer_);
+    if (!markers_.empty()) {
+        esp_timer_start_once(marker_timer_, std::max<int64_t>(1000, markers_.front().time_us - now));
+    }
+}
+
+void AudioClock::OnMarkerTimer() {
+    std::vector<std::function<void()>> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int64_t now = esp_timer_get_time();
+        while (!markers_.empty() && markers_.front().time_us <= now) {
+            callbacks.push_back(std::move(markers_.front().callback));
+            markers_.pop_front();
+        }
+        ArmMarkerTimer(now);
+    }
+    for (auto& callback : callbacks) {
+        callback();
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef AUDIO_CLOCK_H
+#define AUDIO_CLOCK_H
+
+#include <esp_timer.h>
+
+#include <deque>
+#include <functional>
+#include <mutex>
+
+/*
+ * Playback position of the speaker output
+ *
+ * AudioOutputTask reports every frame handed to the I2S driver. i2s_channel_write only
+ * returns once the frame fits into the DMA ring, so at that moment at most
+ * dma_buffered_samples are still waiting to be rendered; the clock keeps the time at
+ * which the last written sample leaves the DMA and derives the rendered position from it.
+ *
+ * Markers fire (on the esp_timer task) once every sample written before them has been
+ * rendered, and the recent render intervals of server timestamps are kept for server AEC.
+ */
+
+class AudioClock {
+public:
+    AudioClock();
+    ~AudioClock();
+
+    // dma_buffered_samples 为 I2S DMA 能缓存的每声道样本数
+    void Configure(int sample_rate, int dma_buffered_samples);
+    // 在 OutputData 前后分别取时间，timestamp 为服务器音频包的时间戳（没有时为 0）
+    void OnWrite(int samples, int64_t write_start_us, int64_t write_end_us, uint32_t timestamp);
+    // 输出关闭后 DMA 中的数据不再播放
+    void Reset();
+
+    int64_t GetWrittenSamples();
+    int64_t GetRenderedSamples();
+    // 已写入但尚未播放完的时长
+    int64_t GetPendingUs();
+    // time_us 时刻正在播放的音频包时间戳，没有时返回 0
+    uint32_t GetTimestampAt(int64_t time_us);
+    // 当前已写入的样本全部播放完后调用 callback，回调中不要做耗时操作
+    void AddMarker(std::function<void()> callback);
+
+private:
+    struct RenderedFrame {
+        int64_t start_us;
+        int64_t end_us;
+        uint32_t timestamp;
+    };
+    struct Marker {
+        int64_t time_us;
+        std::function<void()> callback;
+    };
+
+    std::mutex mutex_;
+    esp_timer_handle_t marker_timer_ = nullptr;
+    int sample_rate_ = 16000;
+    int64_t dma_latency_us_ = 0;
+    int64_t written_samples_ = 0;
+    int64_t play_end_us_ = 0;
+    std::deque<RenderedFrame> frames_;
+    std::deque<Marker> markers_;
+
+    int64_t SamplesToUs(int64_t samples) const { return samples * 1000000 / sample_rate_; }
+    void ArmMarkerTimer(int64_t now);
+    void OnMarkerTimer();
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include "audio_service.h"
 #include <esp_log.h>
+#include <cmath>
+#include <algorithm>
 
 #if CONFIG_USE_AUDIO_PROCESSOR
 #include "processors/afe_audio_processor.h"
@@ -18,6 +20,25 @@
 #define TAG "AudioService"
 
 
+// 计算 RMS 电平，-60dBFS 到 0dBFS 映射到 0-255
+static uint8_t CalculateLevel(const std::vector<int16_t>& pcm, int stride) {
+    if (pcm.empty()) {
+        return 0;
+    }
+    int64_t sum = 0;
+    size_t count = 0;
+    for (size_t i = 0; i < pcm.size(); i += stride) {
+        sum += (int32_t)pcm[i] * pcm[i];
+        count++;
+    }
+    float rms = std::sqrt((float)sum / count) / 32768.0f;
+    if (rms <= 0.001f) {
+        return 0;
+    }
+    float db = 20.0f * std::log10(rms);
+    return (uint8_t)std::lround(std::min(1.0f, (db + 60.0f) / 60.0f) * 255);
+}
+
 AudioService::AudioService() {
     event_group_ = xEventGroupCreate();
 }
@@ -35,6 +56,15 @@ void AudioService::Initialize(AudioCodec* codec) {
 
     /* Setup the audio codec */
     opus_decoder_ = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
+    clock_.Configure(codec->output_sample_rate(), AUDIO_CODEC_DMA_DESC_NUM * AUDIO_CODEC_DMA_FRAME_NUM);
+#if CONFIG_AUDIO_DECODE_SPILL_MS > 0
+    decode_spill_queue_ = std::make_unique<PsramPacketQueue>(CONFIG_AUDIO_DECODE_SPILL_MS / OPUS_FRAME_DURATION_MS);
+    if (decode_spill_queue_->capacity() == 0) {
+        // 额度按内存队列计算，服务器不会发出超过内存队列能容纳的包
+        ESP_LOGW(TAG, "PSRAM decode queue unavailable, using %d packets in RAM", MAX_DECODE_PACKETS_IN_QUEUE);
+        decode_spill_queue_.reset();
+    }
+#endif
     opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
     opus_encoder_->SetComplexity(0);
 
@@ -72,10 +102,17 @@ void AudioService::Initialize(AudioCodec* codec) {
 
     if (wake_word_) {
         wake_word_->OnWakeWordDetected([this](const std::string& wake_word) {
+            // 唤醒词本身另外编码发送，不进入预录回放
+            preroll_cutoff_time_ = esp_timer_get_time();
             if (callbacks_.on_wake_word_detected) {
                 callbacks_.on_wake_word_detected(wake_word);
             }
         });
+        wake_word_->OnCommandDetected([this](int command) {
+            if (callbacks_.on_local_command) {
+                callbacks_.on_local_command(command);
+            }
+        });
     }
 
     esp_timer_create_args_t audio_power_timer_args = {
@@ -145,12 +182,16 @@ void AudioService::Stop() {
     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
     audio_encode_queue_.clear();
     audio_decode_queue_.clear();
+    if (decode_spill_queue_) {
+        decode_spill_queue_->Clear();
+    }
+    playback_markers_.clear();
     audio_playback_queue_.clear();
     audio_testing_queue_.clear();
     audio_queue_cv_.notify_all();
 }
 
-bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples) {
+bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples, bool keep_alive) {
     if (!codec_->input_enabled()) {
         esp_timer_stop(audio_power_timer_);
         esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
@@ -191,7 +232,11 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
     }
 
     /* Update the last input time */
-    last_input_time_ = std::chrono::steady_clock::now();
+    if (keep_alive) {
+        last_input_time_ = std::chrono::steady_clock::now();
+    }
+    input_level_ = CalculateLevel(data, codec_->input_channels());
+    input_level_time_ = esp_timer_get_time();
     debug_statistics_.input_count++;
 
 #if CONFIG_USE_AUDIO_DEBUGGER
@@ -207,9 +252,11 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
 
 void AudioService::AudioInputTask() {
     while (true) {
+        // 输入仍然打开时不阻塞，没有其他使用者也继续读入预录缓冲
+        bool preroll = CONFIG_AUDIO_PREROLL_MS > 0 && codec_->input_enabled();
         EventBits_t bits = xEventGroupWaitBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING |
             AS_EVENT_WAKE_WORD_RUNNING | AS_EVENT_AUDIO_PROCESSOR_RUNNING,
-            pdFALSE, pdFALSE, portMAX_DELAY);
+            pdFALSE, pdFALSE, preroll ? 0 : portMAX_DELAY);
 
         if (service_stopped_) {
             break;
@@ -220,6 +267,14 @@ void AudioService::AudioInputTask() {
             continue;
         }
 
+        if (bits == 0) {
+            std::vector<int16_t> data;
+            if (preroll && ReadAudioData(data, 16000, AUDIO_PREROLL_FRAME_MS * 16, false)) {
+                PushPreroll(data);
+            }
+            continue;
+        }
+
         /* Used for audio testing in NetworkConfiguring mode by clicking the BOOT button */
         if (bits & AS_EVENT_AUDIO_TESTING_RUNNING) {
             if (audio_testing_queue_.size() >= AUDIO_TESTING_MAX_DURATION_MS / OPUS_FRAME_DURATION_MS) {
@@ -250,6 +305,7 @@ void AudioService::AudioInputTask() {
             if (samples > 0) {
                 if (ReadAudioData(data, 16000, samples)) {
                     wake_word_->Feed(data);
+                    PushPreroll(data);
                     continue;
                 }
             }
@@ -259,8 +315,14 @@ void AudioService::AudioInputTask() {
         if (bits & AS_EVENT_AUDIO_PROCESSOR_RUNNING) {
             std::vector<int16_t> data;
             int samples = audio_processor_->GetFeedSize();
+            if (samples > 0 && preroll_replay_pending_) {
+                preroll_replay_pending_ = false;
+                ReplayPreroll();
+            }
             if (samples > 0) {
                 if (ReadAudioData(data, 16000, samples)) {
+                    // 读取返回时这一块的最后一个样本刚刚采集完
+                    MarkCaptureTime(esp_timer_get_time() - (int64_t)samples * 1000 / 16, samples);
                     audio_processor_->Feed(std::move(data));
                     continue;
                 }
@@ -274,6 +336,93 @@ void AudioService::AudioInputTask() {
     ESP_LOGW(TAG, "Audio input task stopped");
 }
 
+void AudioService::PushPreroll(const std::vector<int16_t>& pcm) {
+#if CONFIG_AUDIO_PREROLL_MS > 0
+    size_t max_samples = CONFIG_AUDIO_PREROLL_MS * 16 * codec_->input_channels();
+    preroll_samples_ += pcm.size();
+    preroll_.push_back({esp_timer_get_time(), pcm});
+    while (preroll_samples_ - preroll_.front().pcm.size() >= max_samples) {
+        preroll_samples_ -= preroll_.front().pcm.size();
+        preroll_.pop_front();
+    }
+#endif
+}
+
+// 把预录的数据按处理器的输入大小补送进去，跳过播放期间和截止时间之前的部分
+void AudioService::ReplayPreroll() {
+    int64_t cutoff = std::max<int64_t>(preroll_cutoff_time_, output_level_time_);
+    int channels = codec_->input_channels();
+    std::vector<int16_t> pcm;
+    // 每帧的采集时间和每声道样本数
+    std::vector<std::pair<int64_t, size_t>> frames;
+    for (auto& frame : preroll_) {
+        if (frame.time_us > cutoff) {
+            // time_us 是读取返回的时间，即这一帧最后一个样本的采集时间
+            size_t samples = frame.pcm.size() / channels;
+            frames.push_back({frame.time_us - (int64_t)samples * 1000 / 16, samples});
+            pcm.insert(pcm.end(), frame.pcm.begin(), frame.pcm.end());
+        }
+    }
+    preroll_.clear();
+    preroll_samples_ = 0;
+
+    size_t chunk = audio_processor_->GetFeedSize() * channels;
+    size_t chunks = pcm.size() / chunk;
+    if (chunks == 0) {
+        return;
+    }
+    // 丢掉最旧的不足一块的部分，其余每帧带上自己的采集时间，而不是回放时的时间
+    size_t skip = (pcm.size() - chunks * chunk) / channels;
+    for (auto& [time_us, samples] : frames) {
+        if (skip >= samples) {
+            skip -= samples;
+            continue;
+        }
+        MarkCaptureTime(time_us + (int64_t)skip * 1000 / 16, samples - skip);
+        skip = 0;
+    }
+    auto begin = pcm.begin() + (pcm.size() - chunks * chunk);
+    for (size_t i = 0; i < chunks; i++, begin += chunk) {
+        audio_processor_->Feed(std::vector<int16_t>(begin, begin + chunk));
+    }
+    ESP_LOGI(TAG, "Replayed %d ms of pre-roll", (int)(chunks * chunk / channels / 16));
+}
+
+void AudioService::ResetCaptureMarks() {
+    std::lock_guard<std::mutex> lock(capture_mutex_);
+    capture_marks_.clear();
+    processor_input_samples_ = 0;
+    processor_output_samples_ = 0;
+}
+
+// 记录接下来送入处理器的 samples 个（每声道）样本中第一个的采集时间
+void AudioService::MarkCaptureTime(int64_t time_us, size_t samples) {
+#if CONFIG_USE_SERVER_AEC
+    std::lock_guard<std::mutex> lock(capture_mutex_);
+    capture_marks_.push_back({processor_input_samples_, time_us});
+    processor_input_samples_ += samples;
+    // 要容纳预录回放一次送入的所有帧，加上处理器内部的缓冲
+    while (capture_marks_.size() > 256) {
+        capture_marks_.pop_front();
+    }
+#endif
+}
+
+// 返回接下来 samples 个输出样本中第一个的采集时间，没有记录时返回 0
+int64_t AudioService::TakeCaptureTime(size_t samples) {
+    std::lock_guard<std::mutex> lock(capture_mutex_);
+    uint64_t index = processor_output_samples_;
+    processor_output_samples_ += samples;
+    while (capture_marks_.size() > 1 && capture_marks_[1].start_sample <= index) {
+        capture_marks_.pop_front();
+    }
+    if (capture_marks_.empty() || capture_marks_.front().start_sample > index) {
+        return 0;
+    }
+    auto& mark = capture_marks_.front();
+    return mark.time_us + (int64_t)(index - mark.start_sample) * 1000 / 16;
+}
+
 void AudioService::AudioOutputTask() {
     while (true) {
         std::unique_lock<std::mutex> lock(audio_queue_mutex_);
@@ -285,6 +434,7 @@ void AudioService::AudioOutputTask() {
         auto task = std::move(audio_playback_queue_.front());
         audio_playback_queue_.pop_front();
         audio_queue_cv_.notify_all();
+        output_busy_ = true;
         lock.unlock();
 
         if (!codec_->output_enabled()) {
@@ -292,19 +442,38 @@ void AudioService::AudioOutputTask() {
             esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
             codec_->EnableOutput(true);
         }
-        codec_->OutputData(task->pcm);
+        if (!task->pcm.empty()) {
+            output_level_ = CalculateLevel(task->pcm, 1);
+            output_level_time_ = esp_timer_get_time();
+            int64_t write_start = output_level_time_;
+            codec_->OutputData(task->pcm);
+            clock_.OnWrite(task->pcm.size(), write_start, esp_timer_get_time(), task->timestamp);
+            if (task->fade) {
+                debug_statistics_.abort_fades_played++;
+            }
 
-        /* Update the last output time */
-        last_output_time_ = std::chrono::steady_clock::now();
-        debug_statistics_.playback_count++;
+            /* Update the last output time */
+            last_output_time_ = std::chrono::steady_clock::now();
+            debug_statistics_.playback_count++;
+        }
 
-#if CONFIG_USE_SERVER_AEC
-        /* Record the timestamp for server AEC */
-        if (task->timestamp > 0) {
-            lock.lock();
-            timestamp_queue_.push_back(task->timestamp);
+        lock.lock();
+        output_busy_ = false;
+        if ((int32_t)(task->sequence + 1 - playback_done_) > 0) {
+            playback_done_ = task->sequence + 1;
+        }
+        auto markers = TakeDoneMarkers();
+        // 打断后最后一帧（淡出帧）已写入，等它离开 DMA 才真正静音
+        if (abort_time_us_ > 0 && audio_playback_queue_.empty()) {
+            markers.push_back(AbortSilenceMarker(abort_time_us_));
+            abort_time_us_ = 0;
+        }
+        lock.unlock();
+
+        /* Hand the markers to the clock, they fire when the written samples leave the DMA */
+        for (auto& callback : markers) {
+            clock_.AddMarker(std::move(callback));
         }
-#endif
     }
 
     ESP_LOGW(TAG, "Audio output task stopped");
@@ -326,12 +495,28 @@ void AudioService::OpusCodecTask() {
         if (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE) {
             auto packet = std::move(audio_decode_queue_.front());
             audio_decode_queue_.pop_front();
+            auto generation = playback_generation_;
+            auto sequence = decode_popped_++;
+            if (decode_spill_queue_ && !decode_spill_queue_->empty()) {
+                audio_decode_queue_.push_back(decode_spill_queue_->Pop());
+            }
+            decode_queue_full_ = false;
+            // 每消耗四分之一容量更新一次额度，避免每个包都发送流控消息
+            bool credit_available = ++decode_consumed_ >= std::max<size_t>(1, GetDecodeQueueCapacity() / 4);
+            if (credit_available) {
+                decode_consumed_ = 0;
+            }
             audio_queue_cv_.notify_all();
             lock.unlock();
 
+            if (credit_available && callbacks_.on_decode_queue_available) {
+                callbacks_.on_decode_queue_available();
+            }
+
             auto task = std::make_unique<AudioTask>();
             task->type = kAudioTaskTypeDecodeToPlaybackQueue;
             task->timestamp = packet->timestamp;
+            task->sequence = sequence;
 
             SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
             if (opus_decoder_->Decode(std::move(packet->payload), task->pcm)) {
@@ -342,13 +527,15 @@ void AudioService::OpusCodecTask() {
                     output_resampler_.Process(task->pcm.data(), task->pcm.size(), resampled.data());
                     task->pcm = std::move(resampled);
                 }
-
-                lock.lock();
-                audio_playback_queue_.push_back(std::move(task));
-                audio_queue_cv_.notify_all();
             } else {
                 ESP_LOGE(TAG, "Failed to decode audio");
-                lock.lock();
+                // 空任务不会播放，只用于推进播放标记
+                task->pcm.clear();
+            }
+            lock.lock();
+            if (generation == playback_generation_) {
+                audio_playback_queue_.push_back(std::move(task));
+                audio_queue_cv_.notify_all();
             }
             debug_statistics_.decode_count++;
         }
@@ -409,18 +596,20 @@ void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t
     task->type = type;
     task->pcm = std::move(pcm);
     
-    /* Push the task to the encode queue */
-    std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-
-    /* If the task is to send queue, we need to set the timestamp */
-    if (type == kAudioTaskTypeEncodeToSendQueue && !timestamp_queue_.empty()) {
-        if (timestamp_queue_.size() <= MAX_TIMESTAMPS_IN_QUEUE) {
-            task->timestamp = timestamp_queue_.front();
-        } else {
-            ESP_LOGW(TAG, "Timestamp queue (%u) is full, dropping timestamp", timestamp_queue_.size());
+#if CONFIG_USE_SERVER_AEC
+    /* Tag the frame with the server packet that was playing when it was captured */
+    if (type == kAudioTaskTypeEncodeToSendQueue) {
+        // 采集时间包含 AFE 缓冲的延迟；没有记录时退回到按输出时间估算
+        int64_t capture_time = TakeCaptureTime(task->pcm.size());
+        if (capture_time == 0) {
+            capture_time = esp_timer_get_time() - (int64_t)task->pcm.size() * 1000 / 16;
         }
-        timestamp_queue_.pop_front();
+        task->timestamp = clock_.GetTimestampAt(capture_time);
     }
+#endif
+
+    /* Push the task to the encode queue */
+    std::unique_lock<std::mutex> lock(audio_queue_mutex_);
 
     audio_queue_cv_.wait(lock, [this]() { return audio_encode_queue_.size() < MAX_ENCODE_TASKS_IN_QUEUE; });
     audio_encode_queue_.push_back(std::move(task));
@@ -429,18 +618,56 @@ void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t
 
 bool AudioService::PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait) {
     std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-    if (audio_decode_queue_.size() >= MAX_DECODE_PACKETS_IN_QUEUE) {
+    if (IsDecodeQueueFull()) {
+        if (!decode_queue_full_) {
+            decode_queue_full_ = true;
+            debug_statistics_.decode_stalls++;
+        }
         if (wait) {
-            audio_queue_cv_.wait(lock, [this]() { return audio_decode_queue_.size() < MAX_DECODE_PACKETS_IN_QUEUE; });
+            audio_queue_cv_.wait(lock, [this]() { return !IsDecodeQueueFull(); });
         } else {
+            // 服务器遵守流控额度时不会走到这里
+            auto dropped = ++debug_statistics_.decode_dropped;
+            if ((dropped & (dropped - 1)) == 0) {
+                ESP_LOGW(TAG, "Decode queue full, %lu packets dropped", (unsigned long)dropped);
+            }
             return false;
         }
     }
-    audio_decode_queue_.push_back(std::move(packet));
+
+    // 队列前部留在内存中，PSRAM 中有数据时后来的包也必须排在后面
+    if (audio_decode_queue_.size() < MAX_DECODE_PACKETS_IN_QUEUE &&
+        (!decode_spill_queue_ || decode_spill_queue_->empty())) {
+        audio_decode_queue_.push_back(std::move(packet));
+    } else if (!decode_spill_queue_->Push(packet)) {
+        debug_statistics_.decode_dropped++;
+        ESP_LOGW(TAG, "Packet of %u bytes is too large for the PSRAM queue", packet->payload.size());
+        return false;
+    }
+    decode_pushed_++;
     audio_queue_cv_.notify_all();
     return true;
 }
 
+size_t AudioService::GetDecodeQueueCapacity() const {
+    return MAX_DECODE_PACKETS_IN_QUEUE + (decode_spill_queue_ ? decode_spill_queue_->capacity() : 0);
+}
+
+// 调用时需持有 audio_queue_mutex_
+bool AudioService::IsDecodeQueueFull() const {
+    if (audio_decode_queue_.size() < MAX_DECODE_PACKETS_IN_QUEUE) {
+        return false;
+    }
+    return !decode_spill_queue_ || decode_spill_queue_->size() >= decode_spill_queue_->capacity();
+}
+
+size_t AudioService::GetDecodeQueueHeadroom() {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    size_t used = audio_decode_queue_.size() + (decode_spill_queue_ ? decode_spill_queue_->size() : 0);
+    size_t capacity = GetDecodeQueueCapacity();
+    return used < capacity ? capacity - used : 0;
+}
+
 std::unique_ptr<AudioStreamPacket> AudioService::PopPacketFromSendQueue() {
     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
     if (audio_send_queue_.empty()) {
@@ -502,7 +729,13 @@ void AudioService::EnableVoiceProcessing(bool enable) {
 
         /* We should make sure no audio is playing */
         ResetDecoder();
-        audio_input_need_warmup_ = true;
+        // 输入已经在运行时不需要预热，并补上预录的数据
+        if (codec_->input_enabled() && CONFIG_AUDIO_PREROLL_MS > 0) {
+            preroll_replay_pending_ = true;
+        } else {
+            audio_input_need_warmup_ = true;
+        }
+        ResetCaptureMarks();
         audio_processor_->Start();
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
     } else {
@@ -559,17 +792,137 @@ void AudioService::PlaySound(const std::string_view& sound) {
 
 bool AudioService::IsIdle() {
     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    return audio_encode_queue_.empty() && audio_decode_queue_.empty() && audio_playback_queue_.empty() && audio_testing_queue_.empty();
+    return audio_encode_queue_.empty() && audio_decode_queue_.empty() && audio_playback_queue_.empty() && audio_testing_queue_.empty() &&
+        (!decode_spill_queue_ || decode_spill_queue_->empty());
+}
+
+uint8_t AudioService::GetInputLevel() const {
+    if (esp_timer_get_time() - input_level_time_ > AUDIO_LEVEL_TIMEOUT_MS * 1000) {
+        return 0;
+    }
+    return input_level_;
+}
+
+uint8_t AudioService::GetOutputLevel() const {
+    if (esp_timer_get_time() - output_level_time_ > AUDIO_LEVEL_TIMEOUT_MS * 1000) {
+        return 0;
+    }
+    return output_level_;
 }
 
 void AudioService::ResetDecoder() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    opus_decoder_->ResetState();
-    timestamp_queue_.clear();
-    audio_decode_queue_.clear();
-    audio_playback_queue_.clear();
-    audio_testing_queue_.clear();
-    audio_queue_cv_.notify_all();
+    std::vector<std::function<void()>> markers;
+    {
+        std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+        opus_decoder_->ResetState();
+        audio_decode_queue_.clear();
+        if (decode_spill_queue_) {
+            decode_spill_queue_->Clear();
+        }
+        decode_consumed_ = 0;
+        // 打断后立即切到聆听时也会走到这里，AbortPlayback 留下的淡出帧要播完，否则会有爆音
+        std::unique_ptr<AudioTask> fade;
+        if (abort_generation_ == playback_generation_ && !audio_playback_queue_.empty() &&
+            audio_playback_queue_.front()->fade) {
+            fade = std::move(audio_playback_queue_.front());
+        }
+        playback_generation_++;
+        audio_playback_queue_.clear();
+        audio_testing_queue_.clear();
+        decode_popped_ = playback_done_ = decode_pushed_;
+        markers = TakeDoneMarkers();
+        if (fade) {
+            audio_playback_queue_.push_back(std::move(fade));
+            abort_generation_ = playback_generation_;
+        } else if (abort_time_us_ > 0 && !output_busy_) {
+            // 没有淡出帧等待写出，静音时间从现在开始计
+            markers.push_back(AbortSilenceMarker(abort_time_us_));
+            abort_time_us_ = 0;
+        }
+        audio_queue_cv_.notify_all();
+    }
+    for (auto& callback : markers) {
+        clock_.AddMarker(std::move(callback));
+    }
+    // 队列已清空，额度恢复到最大
+    if (callbacks_.on_decode_queue_available) {
+        callbacks_.on_decode_queue_available();
+    }
+}
+
+void AudioService::AbortPlayback() {
+    std::vector<std::function<void()>> markers;
+    {
+        std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+        audio_decode_queue_.clear();
+        if (decode_spill_queue_) {
+            decode_spill_queue_->Clear();
+        }
+        decode_consumed_ = 0;
+        playback_generation_++;
+        decode_popped_ = playback_done_ = decode_pushed_;
+        markers = TakeDoneMarkers();
+
+        // 正在播放的一帧已交给 codec，保留下一帧的开头做淡出
+        std::unique_ptr<AudioTask> fade;
+        if (!audio_playback_queue_.empty()) {
+            fade = std::move(audio_playback_queue_.front());
+            audio_playback_queue_.clear();
+        }
+        if (fade) {
+            size_t samples = std::min(fade->pcm.size(), (size_t)(codec_->output_sample_rate() / 1000 * AUDIO_ABORT_FADE_MS));
+            fade->pcm.resize(samples);
+            for (size_t i = 0; i < samples; i++) {
+                fade->pcm[i] = (int32_t)fade->pcm[i] * (int32_t)(samples - i) / (int32_t)samples;
+            }
+            if (!fade->fade) {
+                fade->fade = true;
+                debug_statistics_.abort_fades_queued++;
+            }
+            audio_playback_queue_.push_back(std::move(fade));
+        }
+        abort_generation_ = playback_generation_;
+        if (output_busy_ || !audio_playback_queue_.empty()) {
+            abort_time_us_ = esp_timer_get_time();
+        } else {
+            // 没有待写入的帧，DMA 中剩下的样本播完即静音
+            markers.push_back(AbortSilenceMarker(esp_timer_get_time()));
+        }
+        audio_queue_cv_.notify_all();
+    }
+    for (auto& callback : markers) {
+        clock_.AddMarker(std::move(callback));
+    }
+    // 队列已清空，额度恢复到最大
+    if (callbacks_.on_decode_queue_available) {
+        callbacks_.on_decode_queue_available();
+    }
+}
+
+// 由 AudioClock 在打断前写入的样本全部播放完时触发，统计的是扬声器真正静音的延迟
+std::function<void()> AudioService::AbortSilenceMarker(int64_t abort_time_us) {
+    return [abort_time_us]() {
+        ESP_LOGI(TAG, "Abort to silence: %lld ms", (esp_timer_get_time() - abort_time_us) / 1000);
+    };
+}
+
+void AudioService::AddPlaybackMarker(std::function<void()> callback) {
+    std::unique_lock<std::mutex> lock(audio_queue_mutex_);
+    if (playback_done_ != decode_pushed_) {
+        playback_markers_.push_back({decode_pushed_, std::move(callback)});
+        return;
+    }
+    lock.unlock();
+    clock_.AddMarker(std::move(callback));
+}
+
+std::vector<std::function<void()>> AudioService::TakeDoneMarkers() {
+    std::vector<std::function<void()>> callbacks;
+    while (!playback_markers_.empty() && (int32_t)(playback_markers_.front().sequence - playback_done_) <= 0) {
+        callbacks.push_back(std::move(playback_markers_.front().callback));
+        playback_markers_.pop_front();
+    }
+    return callbacks;
 }
 
 void AudioService::CheckAndUpdateAudioPowerState() {
@@ -581,6 +934,7 @@ void AudioService::CheckAndUpdateAudioPowerState() {
     }
     if (output_elapsed > AUDIO_POWER_TIMEOUT_MS && codec_->output_enabled()) {
         codec_->EnableOutput(false);
+        clock_.Reset();
     }
     if (!codec_->input_enabled() && !codec_->output_enabled()) {
         esp_timer_stop(audio_power_timer_);
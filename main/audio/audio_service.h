@@ -6,6 +6,7 @@
 #include <condition_variable>
 #include <chrono>
 #include <mutex>
+#include <atomic>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -21,6 +22,8 @@
 #include "processors/audio_debugger.h"
 #include "wake_word.h"
 #include "protocol.h"
+#include "psram_packet_queue.h"
+#include "audio_clock.h"
 
 
 /*
@@ -32,6 +35,13 @@
  * 
  * Decode Queue and Send Queue are the main queues, because Opus packets are quite smaller than PCM packets.
  * 
+ * While the codec input is enabled, the input task keeps the last CONFIG_AUDIO_PREROLL_MS of
+ * 16kHz input in a pre-roll ring, which is replayed into the processor when voice processing
+ * starts, so speech right after a button press or the end of TTS is not lost.
+ *
+ * Every decoded packet carries its sequence in the decode queue, so a playback marker can be
+ * placed after the packets pushed so far and handed to the AudioClock once they are written,
+ * firing when they have actually left the speaker.
  */
 
 #define OPUS_FRAME_DURATION_MS 60
@@ -40,10 +50,14 @@
 #define MAX_DECODE_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
 #define MAX_SEND_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
-#define MAX_TIMESTAMPS_IN_QUEUE 3
 
 #define AUDIO_POWER_TIMEOUT_MS 15000
 #define AUDIO_POWER_CHECK_INTERVAL_MS 1000
+#define AUDIO_LEVEL_TIMEOUT_MS 200
+// 没有其他使用者时，每次为预录读取的时长
+#define AUDIO_PREROLL_FRAME_MS 20
+// 打断播放时淡出的时长，避免直接截断产生爆音
+#define AUDIO_ABORT_FADE_MS 10
 
 
 #define AS_EVENT_AUDIO_TESTING_RUNNING      (1 << 0)
@@ -53,7 +67,10 @@
 
 struct AudioServiceCallbacks {
     std::function<void(void)> on_send_queue_available;
+    // 解码队列又空出一批位置，可以向服务器更新流控额度
+    std::function<void(void)> on_decode_queue_available;
     std::function<void(const std::string&)> on_wake_word_detected;
+    std::function<void(int)> on_local_command;
     std::function<void(bool)> on_vad_change;
     std::function<void(void)> on_audio_testing_queue_full;
 };
@@ -69,6 +86,26 @@ struct AudioTask {
     AudioTaskType type;
     std::vector<int16_t> pcm;
     uint32_t timestamp;
+    // 解码任务对应的数据包序号
+    uint32_t sequence;
+    // 本地打断时留下的淡出帧
+    bool fade = false;
+};
+
+struct PlaybackMarker {
+    uint32_t sequence;
+    std::function<void()> callback;
+};
+
+struct PrerollFrame {
+    int64_t time_us;
+    std::vector<int16_t> pcm;
+};
+
+// 从 start_sample 开始送入处理器的数据中，第一个样本的采集时间
+struct CaptureMark {
+    uint64_t start_sample;
+    int64_t time_us;
 };
 
 struct DebugStatistics {
@@ -76,6 +113,12 @@ struct DebugStatistics {
     uint32_t decode_count = 0;
     uint32_t encode_count = 0;
     uint32_t playback_count = 0;
+    // 解码队列满时丢弃的数据包，以及队列被填满（发送方必须暂停）的次数
+    uint32_t decode_dropped = 0;
+    uint32_t decode_stalls = 0;
+    // 本地打断排队的淡出帧，以及实际写入 codec 的数量，两者应当相等
+    uint32_t abort_fades_queued = 0;
+    uint32_t abort_fades_played = 0;
 };
 
 class AudioService {
@@ -93,6 +136,9 @@ public:
     bool IsIdle();
     bool IsWakeWordRunning() const { return xEventGroupGetBits(event_group_) & AS_EVENT_WAKE_WORD_RUNNING; }
     bool IsAudioProcessorRunning() const { return xEventGroupGetBits(event_group_) & AS_EVENT_AUDIO_PROCESSOR_RUNNING; }
+    // 最近一帧麦克风 / 播放音频的电平 (0-255 对应 -60dBFS 到 0dBFS)，超过 AUDIO_LEVEL_TIMEOUT_MS 没有数据时为 0
+    uint8_t GetInputLevel() const;
+    uint8_t GetOutputLevel() const;
 
     void EnableWakeWordDetection(bool enable);
     void EnableVoiceProcessing(bool enable);
@@ -102,10 +148,20 @@ public:
     void SetCallbacks(AudioServiceCallbacks& callbacks);
 
     bool PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait = false);
+    // 解码队列（含 PSRAM 溢出部分）还能接收的数据包数量
+    size_t GetDecodeQueueHeadroom();
+    const DebugStatistics& debug_statistics() const { return debug_statistics_; }
     std::unique_ptr<AudioStreamPacket> PopPacketFromSendQueue();
     void PlaySound(const std::string_view& sound);
-    bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples);
+    // keep_alive 为 false 时不推迟输入的自动关闭，用于预录
+    bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples, bool keep_alive = true);
     void ResetDecoder();
+    // 本地打断：清空解码与播放队列，下一帧淡出后静音，不等待服务器
+    void AbortPlayback();
+    // 目前已加入解码队列的音频全部从扬声器播放完后调用 callback（在 esp_timer 任务中），
+    // 被清空的音频视为已播放完
+    void AddPlaybackMarker(std::function<void()> callback);
+    AudioClock& GetClock() { return clock_; }
 
 private:
     AudioCodec* codec_ = nullptr;
@@ -129,12 +185,36 @@ private:
     std::mutex audio_queue_mutex_;
     std::condition_variable audio_queue_cv_;
     std::deque<std::unique_ptr<AudioStreamPacket>> audio_decode_queue_;
+    // audio_decode_queue_ 满后继续存入 PSRAM，没有 PSRAM 时为空
+    std::unique_ptr<PsramPacketQueue> decode_spill_queue_;
+    size_t decode_consumed_ = 0;
+    bool decode_queue_full_ = false;
+    // 每次清空播放时加一，解码中的旧数据在入队时丢弃
+    uint32_t playback_generation_ = 0;
+    // 已加入解码队列 / 已从解码队列取出 / 已写入 codec 或被清空的数据包数量
+    uint32_t decode_pushed_ = 0;
+    uint32_t decode_popped_ = 0;
+    uint32_t playback_done_ = 0;
+    std::deque<PlaybackMarker> playback_markers_;
+    AudioClock clock_;
+    std::atomic<bool> output_busy_ = false;
+    int64_t abort_time_us_ = 0;
+    // AbortPlayback 之后的播放代数，ResetDecoder 据此保留尚未写出的淡出帧
+    uint32_t abort_generation_ = 0;
     std::deque<std::unique_ptr<AudioStreamPacket>> audio_send_queue_;
     std::deque<std::unique_ptr<AudioStreamPacket>> audio_testing_queue_;
     std::deque<std::unique_ptr<AudioTask>> audio_encode_queue_;
     std::deque<std::unique_ptr<AudioTask>> audio_playback_queue_;
-    // For server AEC
-    std::deque<uint32_t> timestamp_queue_;
+    // Pre-roll ring, only accessed by the audio input task
+    std::deque<PrerollFrame> preroll_;
+    size_t preroll_samples_ = 0;
+    std::atomic<bool> preroll_replay_pending_ = false;
+    std::atomic<int64_t> preroll_cutoff_time_ = 0;
+    // 处理器的输出与输入按样本一一对应（只是延后），按样本序号找回输出帧的采集时间
+    std::mutex capture_mutex_;
+    std::deque<CaptureMark> capture_marks_;
+    uint64_t processor_input_samples_ = 0;
+    uint64_t processor_output_samples_ = 0;
 
     bool wake_word_initialized_ = false;
     bool audio_processor_initialized_ = false;
@@ -145,6 +225,10 @@ private:
     esp_timer_handle_t audio_power_timer_ = nullptr;
     std::chrono::steady_clock::time_point last_input_time_;
     std::chrono::steady_clock::time_point last_output_time_;
+    std::atomic<uint8_t> input_level_ = 0;
+    std::atomic<uint8_t> output_level_ = 0;
+    std::atomic<int64_t> input_level_time_ = 0;
+    std::atomic<int64_t> output_level_time_ = 0;
 
     void AudioInputTask();
     void AudioOutputTask();
@@ -152,6 +236,16 @@ private:
     void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm);
     void SetDecodeSampleRate(int sample_rate, int frame_duration);
     void CheckAndUpdateAudioPowerState();
+    // 调用时需持有 audio_queue_mutex_，返回已到期的标记
+    std::vector<std::function<void()>> TakeDoneMarkers();
+    static std::function<void()> AbortSilenceMarker(int64_t abort_time_us);
+    size_t GetDecodeQueueCapacity() const;
+    bool IsDecodeQueueFull() const;
+    void PushPreroll(const std::vector<int16_t>& pcm);
+    void ReplayPreroll();
+    void ResetCaptureMarks();
+    void MarkCaptureTime(int64_t time_us, size_t samples);
+    int64_t TakeCaptureTime(size_t samples);
 };
 
 #endif
\ No newline at end of file
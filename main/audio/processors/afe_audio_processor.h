@@ -29,9 +29,6 @@ public:
     void EnableDeviceAec(bool enable) override;
 
 private:
-    EventGroupHandle_t event_group_ = nullptr;
-    esp_afe_sr_iface_t* afe_iface_ = nullptr;
-    esp_afe_sr_data_t* afe_data_ = nullptr;
     std::function<void(std::vector<int16_t>&& data)> output_callback_;
     std::function<void(bool speaking)> vad_state_change_callback_;
     AudioCodec* codec_ = nullptr;
@@ -39,7 +36,7 @@ private:
     bool is_speaking_ = false;
     std::vector<int16_t> output_buffer_;
 
-    void AudioProcessorTask();
+    void OnFrame(afe_fetch_result_t* result);
 };
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,247 @@
+#include "afe_front_end.h"
+#include "ota.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <string>
+
+#define TAG "AfeFrontEnd"
+
+AfeFrontEnd::AfeFrontEnd() {
+    event_group_ = xEventGroupCreate();
+#if CONFIG_USE_DEVICE_AEC
+    device_aec_ = true;
+#endif
+}
+
+AfeFrontEnd::~AfeFrontEnd() {
+    if (afe_data_ != nullptr) {
+        afe_iface_->destroy(afe_data_);
+    }
+    vEventGroupDelete(event_group_);
+}
+
+bool AfeFrontEnd::Initialize(AudioCodec* codec) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (afe_data_ != nullptr) {
+        return true;
+    }
+
+    input_reference_ = codec->input_reference();
+    int ref_num = input_reference_ ? 1 : 0;
+    std::string input_format;
+    for (int i = 0; i < codec->input_channels() - ref_num; i++) {
+        input_format.push_back('M');
+    }
+    for (int i = 0; i < ref_num; i++) {
+        input_format.push_back('R');
+    }
+
+    // 模型列表只加载一次，模型不可用时退回到不使用模型的处理
+    models_ = Ota::LoadModels();
+    char* ns_model_name = nullptr;
+    char* vad_model_name = nullptr;
+    if (models_ != nullptr) {
+#if CONFIG_USE_AFE_WAKE_WORD
+        wakenet_model_ = esp_srmodel_filter(models_, ESP_WN_PREFIX, NULL);
+#endif
+#if CONFIG_USE_AUDIO_PROCESSOR
+        ns_model_name = esp_srmodel_filter(models_, ESP_NSNET_PREFIX, NULL);
+        vad_model_name = esp_srmodel_filter(models_, ESP_VADN_PREFIX, NULL);
+#endif
+    }
+
+    // AEC 模式在创建后不能切换。通话路径使用设备端 AEC 时保持原来的 VOIP 配置，
+    // 唤醒词在同一实例上运行；否则通话不会打开 AEC，按识别场景创建对唤醒词更好
+    bool has_wakenet = wakenet_model_ != nullptr;
+#if CONFIG_USE_DEVICE_AEC
+    bool voip_aec = true;
+#else
+    bool voip_aec = !has_wakenet;
+#endif
+    afe_config_t* afe_config = afe_config_init(input_format.c_str(), has_wakenet ? models_ : NULL,
+        voip_aec ? AFE_TYPE_VC : AFE_TYPE_SR, AFE_MODE_HIGH_PERF);
+    afe_config->wakenet_init = has_wakenet;
+    if (has_wakenet) {
+        afe_config->wakenet_model_name = wakenet_model_;
+    }
+    afe_config->aec_mode = voip_aec ? AEC_MODE_VOIP_HIGH_PERF : AEC_MODE_SR_HIGH_PERF;
+#if CONFIG_USE_DEVICE_AEC
+    aec_init_ = true;
+#else
+    aec_init_ = has_wakenet && input_reference_;
+#endif
+    afe_config->aec_init = aec_init_;
+
+#if CONFIG_USE_AUDIO_PROCESSOR && !CONFIG_USE_DEVICE_AEC
+    vad_init_ = true;
+#endif
+    afe_config->vad_init = vad_init_;
+    afe_config->vad_mode = VAD_MODE_0;
+    afe_config->vad_min_noise_ms = 100;
+    if (vad_model_name != nullptr) {
+        afe_config->vad_model_name = vad_model_name;
+    }
+
+    ns_init_ = ns_model_name != nullptr;
+    afe_config->ns_init = ns_init_;
+    if (ns_init_) {
+        afe_config->ns_model_name = ns_model_name;
+        afe_config->afe_ns_mode = AFE_NS_MODE_NET;
+    }
+
+    afe_config->afe_perferred_core = 1;
+    afe_config->afe_perferred_priority = 1;
+    afe_config->agc_init = false;
+    afe_config->memory_alloc_mode = AFE_MEMORY_ALLOC_MORE_PSRAM;
+
+    size_t internal_before = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t psram_before = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    afe_iface_ = esp_afe_handle_from_config(afe_config);
+    afe_data_ = afe_iface_->create_from_config(afe_config);
+    afe_config_free(afe_config);
+    if (afe_data_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create AFE");
+        return false;
+    }
+    // 以前唤醒词和通话各创建一个 AFE，这里的占用即为共享后省下的大致内存
+    ESP_LOGI(TAG, "AFE created (%s%s%s%s), internal: %u bytes, PSRAM: %u bytes",
+        has_wakenet ? "wakenet " : "", aec_init_ ? (voip_aec ? "aec(voip) " : "aec(sr) ") : "",
+        ns_init_ ? "ns " : "", vad_init_ ? "vad" : "",
+        internal_before - heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+        psram_before - heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+
+    ApplyStages();
+
+    xTaskCreate([](void* arg) {
+        auto this_ = (AfeFrontEnd*)arg;
+        this_->FetchTask();
+        vTaskDelete(NULL);
+    }, "afe_fetch", 4096, this, 3, nullptr);
+    return true;
+}
+
+size_t AfeFrontEnd::GetFeedSize() {
+    if (afe_data_ == nullptr) {
+        return 0;
+    }
+    return afe_iface_->get_feed_chunksize(afe_data_);
+}
+
+void AfeFrontEnd::Feed(const int16_t* data) {
+    if (afe_data_ == nullptr) {
+        return;
+    }
+    afe_iface_->feed(afe_data_, data);
+}
+
+void AfeFrontEnd::EnableWakeWord(bool enable) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (enable) {
+        xEventGroupSetBits(event_group_, AFE_FRONT_END_WAKE_WORD);
+    } else {
+        xEventGroupClearBits(event_group_, AFE_FRONT_END_WAKE_WORD);
+    }
+    ApplyStages();
+}
+
+void AfeFrontEnd::EnableVoice(bool enable) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (enable) {
+        // 丢弃等待唤醒期间的数据，与原来新建的通话 AFE 一样从空缓冲开始
+        if (afe_data_ != nullptr) {
+            afe_iface_->reset_buffer(afe_data_);
+        }
+        voice_enable_time_ = esp_timer_get_time();
+        xEventGroupSetBits(event_group_, AFE_FRONT_END_VOICE);
+    } else {
+        xEventGroupClearBits(event_group_, AFE_FRONT_END_VOICE);
+    }
+    ApplyStages();
+}
+
+void AfeFrontEnd::EnableDeviceAec(bool enable) {
+#if !CONFIG_USE_DEVICE_AEC
+    if (enable) {
+        ESP_LOGE(TAG, "Device AEC is not supported");
+        return;
+    }
+#endif
+    std::lock_guard<std::mutex> lock(mutex_);
+    device_aec_ = enable;
+    ApplyStages();
+}
+
+// 只改变各阶段的开关，不重建 AFE；调用时需持有 mutex_
+void AfeFrontEnd::ApplyStages() {
+    if (afe_data_ == nullptr) {
+        return;
+    }
+    auto bits = xEventGroupGetBits(event_group_);
+    bool wake_word = bits & AFE_FRONT_END_WAKE_WORD;
+    bool voice = bits & AFE_FRONT_END_VOICE;
+
+    if (wakenet_model_ != nullptr) {
+        if (wake_word) {
+            afe_iface_->enable_wakenet(afe_data_);
+        } else {
+            afe_iface_->disable_wakenet(afe_data_);
+        }
+    }
+    if (ns_init_) {
+        if (voice) {
+            afe_iface_->enable_ns(afe_data_);
+        } else {
+            afe_iface_->disable_ns(afe_data_);
+        }
+    }
+    if (vad_init_) {
+        if (voice && !device_aec_) {
+            afe_iface_->enable_vad(afe_data_);
+        } else {
+            afe_iface_->disable_vad(afe_data_);
+        }
+    }
+    if (aec_init_) {
+        // 唤醒词一直使用参考信号消除回声，通话时由 AEC 模式决定
+        if ((wake_word && input_reference_) || (voice && device_aec_)) {
+            afe_iface_->enable_aec(afe_data_);
+        } else {
+            afe_iface_->disable_aec(afe_data_);
+        }
+    }
+    if (!wake_word && !voice) {
+        afe_iface_->reset_buffer(afe_data_);
+    }
+}
+
+void AfeFrontEnd::FetchTask() {
+    ESP_LOGI(TAG, "AFE fetch task started, feed size: %d fetch size: %d",
+        afe_iface_->get_feed_chunksize(afe_data_), afe_iface_->get_fetch_chunksize(afe_data_));
+
+    while (true) {
+        xEventGroupWaitBits(event_group_, AFE_FRONT_END_WAKE_WORD | AFE_FRONT_END_VOICE,
+            pdFALSE, pdFALSE, portMAX_DELAY);
+
+        auto res = afe_iface_->fetch_with_delay(afe_data_, portMAX_DELAY);
+        auto bits = xEventGroupGetBits(event_group_);
+        if (res == nullptr || res->ret_value == ESP_FAIL) {
+            if (res != nullptr) {
+                ESP_LOGI(TAG, "Error code: %d", res->ret_value);
+            }
+            continue;
+        }
+
+        if ((bits & AFE_FRONT_END_VOICE) && voice_callback_) {
+            if (voice_enable_time_ != 0) {
+                ESP_LOGI(TAG, "Listen start latency: %lld ms", (esp_timer_get_time() - voice_enable_time_) / 1000);
+                voice_enable_time_ = 0;
+            }
+            voice_callback_(res);
+        }
+        if ((bits & AFE_FRONT_END_WAKE_WORD) && wake_word_callback_) {
+            wake_word_callback_(res);
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef AFE_FRONT_END_H
+#define AFE_FRONT_END_H
+
+#include <esp_afe_sr_models.h>
+#include <model_path.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/event_groups.h>
+
+#include <functional>
+#include <mutex>
+
+#include "audio_codec.h"
+
+/*
+ * One AFE instance shared by the AFE wake word and the AFE audio processor
+ *
+ * Both used to create their own AFE (AEC, ring buffers, fetch task). Now they register a
+ * callback here and only switch the stages they need: wakenet while waiting for the wake
+ * word, NS / VAD while listening. Switching never destroys the AFE, so AEC keeps its
+ * adaptation and listening does not pay for creating a second instance.
+ */
+
+class AfeFrontEnd {
+public:
+    using FrameCallback = std::function<void(afe_fetch_result_t* result)>;
+
+    static AfeFrontEnd& GetInstance() {
+        static AfeFrontEnd instance;
+        return instance;
+    }
+    AfeFrontEnd(const AfeFrontEnd&) = delete;
+    AfeFrontEnd& operator=(const AfeFrontEnd&) = delete;
+
+    // 第一个使用者调用时创建 AFE，之后的调用直接返回
+    bool Initialize(AudioCodec* codec);
+    void Feed(const int16_t* data);
+    size_t GetFeedSize();
+
+    void OnWakeWordFrame(FrameCallback callback) { wake_word_callback_ = callback; }
+    void OnVoiceFrame(FrameCallback callback) { voice_callback_ = callback; }
+    void EnableWakeWord(bool enable);
+    void EnableVoice(bool enable);
+    void EnableDeviceAec(bool enable);
+    bool IsVoiceEnabled() const { return xEventGroupGetBits(event_group_) & AFE_FRONT_END_VOICE; }
+
+    srmodel_list_t* models() const { return models_; }
+    // AFE 中的唤醒词模型，没有启用 AFE 唤醒词时为 nullptr
+    char* wakenet_model() const { return wakenet_model_; }
+
+private:
+    static constexpr EventBits_t AFE_FRONT_END_WAKE_WORD = 1 << 0;
+    static constexpr EventBits_t AFE_FRONT_END_VOICE = 1 << 1;
+
+    AfeFrontEnd();
+    ~AfeFrontEnd();
+
+    std::mutex mutex_;
+    EventGroupHandle_t event_group_ = nullptr;
+    esp_afe_sr_iface_t* afe_iface_ = nullptr;
+    esp_afe_sr_data_t* afe_data_ = nullptr;
+    srmodel_list_t* models_ = nullptr;
+    char* wakenet_model_ = nullptr;
+    bool aec_init_ = false;
+    bool ns_init_ = false;
+    bool vad_init_ = false;
+    bool input_reference_ = false;
+    bool device_aec_ = false;
+    int64_t voice_enable_time_ = 0;
+    FrameCallback wake_word_callback_;
+    FrameCallback voice_callback_;
+
+    void ApplyStages();
+    void FetchTask();
+};
+
+#endif
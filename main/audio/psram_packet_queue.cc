@@ -0,0 +1,68 @@
+#include "psram_packet_queue.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <cstring>
+
+#define TAG "PsramPacketQueue"
+
+// 60ms 帧 500 字节约合 66kbps，服务器下发的 Opus 远小于此
+#define PSRAM_PACKET_SLOT_SIZE 512
+#define PSRAM_PACKET_MAX_PAYLOAD (PSRAM_PACKET_SLOT_SIZE - sizeof(SlotHeader))
+
+PsramPacketQueue::PsramPacketQueue(size_t capacity) {
+    buffer_ = (uint8_t*)heap_caps_malloc(capacity * PSRAM_PACKET_SLOT_SIZE, MALLOC_CAP_SPIRAM);
+    if (buffer_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u packets", capacity);
+        return;
+    }
+    capacity_ = capacity;
+}
+
+PsramPacketQueue::~PsramPacketQueue() {
+    if (buffer_ != nullptr) {
+        heap_caps_free(buffer_);
+    }
+}
+
+bool PsramPacketQueue::Push(std::unique_ptr<AudioStreamPacket>& packet) {
+    if (size_ >= capacity_ || packet->payload.size() > PSRAM_PACKET_MAX_PAYLOAD) {
+        return false;
+    }
+
+    auto slot = buffer_ + ((head_ + size_) % capacity_) * PSRAM_PACKET_SLOT_SIZE;
+    SlotHeader header = {
+        .sample_rate = packet->sample_rate,
+        .frame_duration = (uint16_t)packet->frame_duration,
+        .size = (uint16_t)packet->payload.size(),
+        .timestamp = packet->timestamp,
+    };
+    memcpy(slot, &header, sizeof(header));
+    memcpy(slot + sizeof(header), packet->payload.data(), header.size);
+    size_++;
+    packet.reset();
+    return true;
+}
+
+std::unique_ptr<AudioStreamPacket> PsramPacketQueue::Pop() {
+    if (size_ == 0) {
+        return nullptr;
+    }
+
+    auto slot = buffer_ + head_ * PSRAM_PACKET_SLOT_SIZE;
+    SlotHeader header;
+    memcpy(&header, slot, sizeof(header));
+    auto packet = std::make_unique<AudioStreamPacket>();
+    packet->sample_rate = header.sample_rate;
+    packet->frame_duration = header.frame_duration;
+    packet->timestamp = header.timestamp;
+    packet->payload.assign(slot + sizeof(header), slot + sizeof(header) + header.size);
+    head_ = (head_ + 1) % capacity_;
+    size_--;
+    return packet;
+}
+
+void PsramPacketQueue::Clear() {
+    head_ = 0;
+    size_ = 0;
+}
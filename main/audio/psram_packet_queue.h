@@ -0,0 +1,45 @@
+#ifndef PSRAM_PACKET_QUEUE_H
+#define PSRAM_PACKET_QUEUE_H
+
+#include <memory>
+
+#include "protocol.h"
+
+/*
+ * FIFO of Opus packets in fixed PSRAM slots
+ *
+ * Used as the overflow of the decode queue: packets in the deque live in internal RAM
+ * (small vectors are never placed in PSRAM), this keeps a longer burst in PSRAM and
+ * refills the deque as it drains. Fixed slots keep the free space countable in packets,
+ * which is what flow-control credits are expressed in. Not thread safe.
+ */
+
+class PsramPacketQueue {
+public:
+    PsramPacketQueue(size_t capacity);
+    ~PsramPacketQueue();
+
+    size_t capacity() const { return capacity_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // 队列已满或数据包超过槽位大小时返回 false，packet 不会被移走
+    bool Push(std::unique_ptr<AudioStreamPacket>& packet);
+    std::unique_ptr<AudioStreamPacket> Pop();
+    void Clear();
+
+private:
+    struct SlotHeader {
+        int32_t sample_rate;
+        uint16_t frame_duration;
+        uint16_t size;
+        uint32_t timestamp;
+    };
+
+    uint8_t* buffer_ = nullptr;
+    size_t capacity_ = 0;
+    size_t head_ = 0;
+    size_t size_ = 0;
+};
+
+#endif
@@ -0,0 +1,374 @@
+#include "tts_cache.h"
+
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <cstring>
+
+#define TAG "TtsCache"
+
+#define TTS_CACHE_PARTITION "tts_cache"
+#define TTS_CACHE_SLOT_MAGIC 0x31435454  // "TTC1"
+// 每个槽位保存一句，64KB 可以放下约 20 秒 24kbps 的 Opus
+#define TTS_CACHE_SLOT_SIZE (64 * 1024)
+#define TTS_CACHE_MAX_ENTRY_SIZE (TTS_CACHE_SLOT_SIZE - sizeof(FlashSlotHeader))
+// 本地播放期间排在后面的服务器音频，约 12 秒
+#define TTS_CACHE_MAX_PENDING_PACKETS 200
+
+TtsCache::TtsCache() {
+}
+
+TtsCache::~TtsCache() {
+    if (task_ != nullptr) {
+        vTaskDelete(task_);
+    }
+}
+
+void TtsCache::Initialize(PushFunction push) {
+    push_ = push;
+
+    partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, TTS_CACHE_PARTITION);
+    if (partition_ != nullptr) {
+        slot_count_ = partition_->size / TTS_CACHE_SLOT_SIZE;
+        ScanFlash();
+    }
+    ESP_LOGI(TAG, "TTS cache: %d KB PSRAM, %d flash slots", CONFIG_TTS_CACHE_SIZE_KB, slot_count_);
+
+    xTaskCreate([](void* arg) {
+        auto this_ = (TtsCache*)arg;
+        this_->CacheTask();
+        vTaskDelete(NULL);
+    }, "tts_cache", 4096, this, 3, &task_);
+}
+
+bool TtsCache::BeginSentence(const std::string& hash, uint32_t turn) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    FinishRecording();
+    current_hit_ = false;
+    // 被打断的一轮迟到的 sentence_start，不再命中也不再录制
+    if (IsDiscarded(turn) || hash.empty() || hash.size() >= sizeof(FlashSlotHeader::hash)) {
+        return false;
+    }
+
+    auto entry = Lookup(hash);
+    if (!entry) {
+        entry = LoadFlash(lock, hash, turn);
+        if (IsDiscarded(turn)) {
+            return false;
+        }
+    }
+    if (entry) {
+        hits_++;
+        ESP_LOGI(TAG, "Hit %s, %u bytes (hits: %lu, misses: %lu)", hash.c_str(), entry->data.size(),
+            (unsigned long)hits_, (unsigned long)misses_);
+        current_hit_ = true;
+        pending_.push_back({entry, nullptr});
+        cv_.notify_all();
+        return true;
+    }
+
+    misses_++;
+    recording_ = std::make_shared<Entry>();
+    recording_->hash = hash;
+    return false;
+}
+
+void TtsCache::EndSentence() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FinishRecording();
+    current_hit_ = false;
+}
+
+bool TtsCache::OnIncomingAudio(std::unique_ptr<AudioStreamPacket>& packet) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 服务器收到 cache_hit 之前已经发出的帧
+    if (current_hit_) {
+        return true;
+    }
+
+    if (recording_) {
+        auto& data = recording_->data;
+        if (data.size() + 2 + packet->payload.size() > TTS_CACHE_MAX_ENTRY_SIZE) {
+            ESP_LOGW(TAG, "Sentence %s is too long to cache", recording_->hash.c_str());
+            recording_.reset();
+        } else {
+            if (data.empty()) {
+                data.reserve(8 * 1024);
+                recording_->sample_rate = packet->sample_rate;
+                recording_->frame_duration = packet->frame_duration;
+            }
+            uint16_t size = packet->payload.size();
+            data.push_back(size & 0xFF);
+            data.push_back(size >> 8);
+            data.insert(data.end(), packet->payload.begin(), packet->payload.end());
+        }
+    }
+
+    if (pending_.empty() && !feeding_) {
+        return false;
+    }
+    if (pending_.size() < TTS_CACHE_MAX_PENDING_PACKETS) {
+        pending_.push_back({nullptr, std::move(packet)});
+        pending_packets_++;
+        cv_.notify_all();
+    } else {
+        // 本地播放太长，后面的服务器音频放不下，这部分语音会缺失
+        dropped_++;
+        if ((dropped_ & (dropped_ - 1)) == 0) {
+            ESP_LOGW(TAG, "Pending queue full, %lu packets dropped (hits: %lu, misses: %lu)",
+                (unsigned long)dropped_, (unsigned long)hits_, (unsigned long)misses_);
+        }
+    }
+    return true;
+}
+
+void TtsCache::Discard(uint32_t turn) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!IsDiscarded(turn)) {
+        discarded_turn_ = turn;
+    }
+    recording_.reset();
+    current_hit_ = false;
+    pending_.clear();
+    pending_packets_ = 0;
+    generation_++;
+    cv_.notify_all();
+}
+
+void TtsCache::SetPlaybackEnabled(bool enabled, uint32_t turn) {
+    if (!enabled) {
+        Discard(turn);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    playback_enabled_ = enabled;
+    cv_.notify_all();
+}
+
+bool TtsCache::RunAfterQueued(std::function<void()> action) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_.empty() && !feeding_) {
+        return false;
+    }
+    pending_.push_back({nullptr, nullptr, std::move(action)});
+    cv_.notify_all();
+    return true;
+}
+
+size_t TtsCache::GetPendingPackets() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_packets_;
+}
+
+void TtsCache::CacheTask() {
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() {
+            return (playback_enabled_ && !pending_.empty()) || !spill_queue_.empty();
+        });
+
+        if (playback_enabled_ && !pending_.empty()) {
+            auto item = std::move(pending_.front());
+            pending_.pop_front();
+            if (item.packet) {
+                pending_packets_--;
+            }
+            auto generation = generation_;
+            feeding_ = true;
+            lock.unlock();
+            Feed(item, generation);
+            lock.lock();
+            feeding_ = false;
+            continue;
+        }
+
+        // 没有播放任务时再写 flash，擦除比较慢
+        auto entry = spill_queue_.front();
+        spill_queue_.pop_front();
+        lock.unlock();
+        WriteFlash(*entry);
+    }
+}
+
+void TtsCache::Feed(PendingItem& item, uint32_t generation) {
+    if (item.action) {
+        item.action();
+        return;
+    }
+    if (item.packet) {
+        push_(std::move(item.packet));
+        return;
+    }
+
+    auto& entry = *item.entry;
+    size_t offset = 0;
+    while (offset + 2 <= entry.data.size() && generation == generation_) {
+        size_t size = entry.data[offset] | (entry.data[offset + 1] << 8);
+        offset += 2;
+        auto packet = std::make_unique<AudioStreamPacket>();
+        packet->sample_rate = entry.sample_rate;
+        packet->frame_duration = entry.frame_duration;
+        packet->payload.assign(entry.data.begin() + offset, entry.data.begin() + offset + size);
+        offset += size;
+        push_(std::move(packet));
+    }
+}
+
+// 调用时需持有 mutex_
+void TtsCache::FinishRecording() {
+    if (!recording_) {
+        return;
+    }
+    if (!recording_->data.empty()) {
+        recording_->data.shrink_to_fit();
+        Insert(recording_);
+    }
+    recording_.reset();
+}
+
+// 调用时需持有 mutex_
+void TtsCache::Insert(std::shared_ptr<const Entry> entry) {
+    auto it = index_.find(entry->hash);
+    if (it != index_.end()) {
+        total_bytes_ -= (*it->second)->data.size();
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+
+    lru_.push_front(entry);
+    index_[entry->hash] = lru_.begin();
+    total_bytes_ += entry->data.size();
+
+    while (total_bytes_ > CONFIG_TTS_CACHE_SIZE_KB * 1024 && lru_.size() > 1) {
+        auto evicted = lru_.back();
+        lru_.pop_back();
+        index_.erase(evicted->hash);
+        total_bytes_ -= evicted->data.size();
+        if (partition_ != nullptr && slot_count_ > 0 && flash_index_.find(evicted->hash) == flash_index_.end()) {
+            spill_queue_.push_back(evicted);
+            cv_.notify_all();
+        }
+    }
+}
+
+// 只查 PSRAM，调用时需持有 mutex_
+std::shared_ptr<const TtsCache::Entry> TtsCache::Lookup(const std::string& hash) {
+    auto it = index_.find(hash);
+    if (it == index_.end()) {
+        return nullptr;
+    }
+    // 移到最近使用
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return *lru_.begin();
+}
+
+// 读 flash 时释放 mutex_，不让网络任务在持锁期间阻塞解码和主循环；
+// 期间槽位可能被 WriteFlash 覆盖，重新加锁后确认索引未变，CRC 也会拒绝写到一半的数据
+std::shared_ptr<const TtsCache::Entry> TtsCache::LoadFlash(std::unique_lock<std::mutex>& lock,
+    const std::string& hash, uint32_t turn) {
+    auto it = flash_index_.find(hash);
+    if (it == flash_index_.end()) {
+        return nullptr;
+    }
+    int slot = it->second;
+    lock.unlock();
+    auto entry = ReadFlash(slot);
+    lock.lock();
+
+    it = flash_index_.find(hash);
+    if (it == flash_index_.end() || it->second != slot) {
+        return nullptr;
+    }
+    if (!entry || entry->hash != hash) {
+        flash_index_.erase(it);
+        return nullptr;
+    }
+    if (IsDiscarded(turn)) {
+        return nullptr;
+    }
+    Insert(entry);
+    return entry;
+}
+
+// 同一句可能因为被逐出后再次命中而写入多个槽位，保留序号最大的一个
+void TtsCache::ScanFlash() {
+    FlashSlotHeader header;
+    uint32_t max_sequence = 0;
+    std::unordered_map<std::string, uint32_t> sequences;
+    for (int slot = 0; slot < slot_count_; slot++) {
+        if (esp_partition_read(partition_, slot * TTS_CACHE_SLOT_SIZE, &header, sizeof(header)) != ESP_OK) {
+            continue;
+        }
+        if (header.magic != TTS_CACHE_SLOT_MAGIC || header.size > TTS_CACHE_MAX_ENTRY_SIZE) {
+            continue;
+        }
+        header.hash[sizeof(header.hash) - 1] = '\0';
+        auto it = sequences.find(header.hash);
+        if (it == sequences.end() || header.sequence > it->second) {
+            sequences[header.hash] = header.sequence;
+            flash_index_[header.hash] = slot;
+        }
+        if (header.sequence >= max_sequence) {
+            max_sequence = header.sequence;
+            next_slot_ = (slot + 1) % slot_count_;
+        }
+    }
+    sequence_ = max_sequence + 1;
+}
+
+std::shared_ptr<const TtsCache::Entry> TtsCache::ReadFlash(int slot) {
+    FlashSlotHeader header;
+    size_t offset = slot * TTS_CACHE_SLOT_SIZE;
+    if (esp_partition_read(partition_, offset, &header, sizeof(header)) != ESP_OK ||
+        header.magic != TTS_CACHE_SLOT_MAGIC || header.size > TTS_CACHE_MAX_ENTRY_SIZE) {
+        return nullptr;
+    }
+
+    auto entry = std::make_shared<Entry>();
+    header.hash[sizeof(header.hash) - 1] = '\0';
+    entry->hash = header.hash;
+    entry->sample_rate = header.sample_rate;
+    entry->frame_duration = header.frame_duration;
+    entry->data.resize(header.size);
+    if (esp_partition_read(partition_, offset + sizeof(header), entry->data.data(), header.size) != ESP_OK ||
+        esp_rom_crc32_le(0, entry->data.data(), header.size) != header.crc) {
+        ESP_LOGW(TAG, "Invalid flash slot %d", slot);
+        return nullptr;
+    }
+    return entry;
+}
+
+// 按槽位循环覆盖，先写数据再写头部，写到一半断电的槽位不会被识别
+void TtsCache::WriteFlash(const Entry& entry) {
+    int slot;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slot = next_slot_;
+        next_slot_ = (next_slot_ + 1) % slot_count_;
+        for (auto it = flash_index_.begin(); it != flash_index_.end(); ++it) {
+            if (it->second == slot) {
+                flash_index_.erase(it);
+                break;
+            }
+        }
+    }
+
+    FlashSlotHeader header = {};
+    header.magic = TTS_CACHE_SLOT_MAGIC;
+    header.sequence = sequence_++;
+    strncpy(header.hash, entry.hash.c_str(), sizeof(header.hash) - 1);
+    header.sample_rate = entry.sample_rate;
+    header.frame_duration = entry.frame_duration;
+    header.size = entry.data.size();
+    header.crc = esp_rom_crc32_le(0, entry.data.data(), entry.data.size());
+
+    size_t offset = slot * TTS_CACHE_SLOT_SIZE;
+    if (esp_partition_erase_range(partition_, offset, TTS_CACHE_SLOT_SIZE) != ESP_OK ||
+        esp_partition_write(partition_, offset + sizeof(header), entry.data.data(), entry.data.size()) != ESP_OK ||
+        esp_partition_write(partition_, offset, &header, sizeof(header)) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write flash slot %d", slot);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    flash_index_[entry.hash] = slot;
+    ESP_LOGI(TAG, "Spilled %s to flash slot %d, %u bytes", entry.hash.c_str(), slot, entry.data.size());
+}
@@ -0,0 +1,122 @@
+#ifndef TTS_CACHE_H
+#define TTS_CACHE_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_partition.h>
+
+#include <string>
+#include <list>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "protocol.h"
+
+/*
+ * Device-side cache of TTS sentences, keyed by the hash the server sends in `sentence_start`
+ *
+ * A miss records the Opus frames of the sentence while they are played. A hit sends
+ * `cache_hit` so the server stops streaming the sentence, drops whatever frames of it are
+ * still in flight, and plays the cached frames instead. Frames of later sentences that
+ * arrive during local playback are queued behind it so the order is kept.
+ *
+ * Entries live in PSRAM (LRU, CONFIG_TTS_CACHE_SIZE_KB). When a `tts_cache` data
+ * partition exists, evicted entries are written to it in fixed slots and read back on
+ * a later hit.
+ */
+
+class TtsCache {
+public:
+    using PushFunction = std::function<bool(std::unique_ptr<AudioStreamPacket> packet)>;
+
+    TtsCache();
+    ~TtsCache();
+
+    // push 以阻塞方式把数据包送入解码队列
+    void Initialize(PushFunction push);
+    // 收到 sentence_start，返回 true 表示命中，由本地播放；已被丢弃的一轮 turn 直接返回 false
+    bool BeginSentence(const std::string& hash, uint32_t turn);
+    // 收到 tts stop，保存正在录制的句子
+    void EndSentence();
+    // 返回 true 表示数据包已被接管（丢弃或排队），调用者不要再送入解码队列
+    bool OnIncomingAudio(std::unique_ptr<AudioStreamPacket>& packet);
+    // 中断播放时调用，丢弃未播放的数据和录制到一半的句子，turn 及之前各轮迟到的句子也不再处理
+    void Discard(uint32_t turn);
+    // 进入说话状态后开启，离开时关闭（同时丢弃 turn）
+    void SetPlaybackEnabled(bool enabled, uint32_t turn);
+    // 还有排队的音频时，在它们送入解码队列后执行 action 并返回 true；否则返回 false，由调用者立即执行
+    bool RunAfterQueued(std::function<void()> action);
+    // 排在本地播放之后、尚未送入解码队列的服务器音频包数，发放流控额度时需要扣除
+    size_t GetPendingPackets();
+
+private:
+    struct Entry {
+        std::string hash;
+        int sample_rate = 0;
+        int frame_duration = 0;
+        // 每帧为 2 字节小端长度加 Opus 数据
+        std::vector<uint8_t> data;
+    };
+
+    struct PendingItem {
+        std::shared_ptr<const Entry> entry;
+        std::unique_ptr<AudioStreamPacket> packet;
+        std::function<void()> action;
+    };
+
+    struct FlashSlotHeader {
+        uint32_t magic;
+        uint32_t sequence;
+        char hash[64];
+        uint16_t sample_rate;
+        uint16_t frame_duration;
+        uint32_t size;
+        uint32_t crc;
+    };
+
+    PushFunction push_;
+    TaskHandle_t task_ = nullptr;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+
+    std::list<std::shared_ptr<const Entry>> lru_;
+    std::unordered_map<std::string, std::list<std::shared_ptr<const Entry>>::iterator> index_;
+    size_t total_bytes_ = 0;
+
+    std::shared_ptr<Entry> recording_;
+    bool current_hit_ = false;
+    bool playback_enabled_ = false;
+    bool feeding_ = false;
+    std::atomic<uint32_t> generation_ = 0;
+    uint32_t discarded_turn_ = 0;
+    std::deque<PendingItem> pending_;
+    size_t pending_packets_ = 0;
+    uint32_t hits_ = 0;
+    uint32_t misses_ = 0;
+    uint32_t dropped_ = 0;
+
+    const esp_partition_t* partition_ = nullptr;
+    int slot_count_ = 0;
+    int next_slot_ = 0;
+    uint32_t sequence_ = 0;
+    std::unordered_map<std::string, int> flash_index_;
+    std::deque<std::shared_ptr<const Entry>> spill_queue_;
+
+    void CacheTask();
+    void Feed(PendingItem& item, uint32_t generation);
+    void FinishRecording();
+    void Insert(std::shared_ptr<const Entry> entry);
+    bool IsDiscarded(uint32_t turn) const { return (int32_t)(turn - discarded_turn_) <= 0; }
+    std::shared_ptr<const Entry> Lookup(const std::string& hash);
+    std::shared_ptr<const Entry> LoadFlash(std::unique_lock<std::mutex>& lock, const std::string& hash, uint32_t turn);
+    void ScanFlash();
+    std::shared_ptr<const Entry> ReadFlash(int slot);
+    void WriteFlash(const Entry& entry);
+};
+
+#endif
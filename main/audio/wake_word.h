@@ -14,6 +14,8 @@ public:
     virtual bool Initialize(AudioCodec* codec) = 0;
     virtual void Feed(const std::vector<int16_t>& data) = 0;
     virtual void OnWakeWordDetected(std::function<void(const std::string& wake_word)> callback) = 0;
+    // 本地命令词，参数为 LocalCommands 中的序号；只有支持命令词的实现才会回调
+    virtual void OnCommandDetected(std::function<void(int command)> callback) {}
     virtual void Start() = 0;
     virtual void Stop() = 0;
     virtual size_t GetFeedSize() = 0;
@@ -1,6 +1,10 @@
 #include "custom_wake_word.h"
 #include "audio_service.h"
+#include "ota.h"
 #include "system_info.h"
+#if CONFIG_USE_LOCAL_COMMANDS
+#include "local_commands.h"
+#endif
 
 #include <esp_log.h>
 #include "esp_mn_iface.h"
@@ -10,6 +14,10 @@
 
 #define TAG "CustomWakeWord"
 
+// 命令词 ID 1 为唤醒词，本地命令词从 2 开始
+#define WAKE_WORD_COMMAND_ID 1
+#define LOCAL_COMMAND_ID_BASE 2
+
 
 CustomWakeWord::CustomWakeWord()
     : wake_word_pcm_(), wake_word_opus_() {
@@ -28,16 +36,12 @@ CustomWakeWord::~CustomWakeWord() {
     if (wake_word_encode_task_buffer_ != nullptr) {
         heap_caps_free(wake_word_encode_task_buffer_);
     }
-
-    if (models_ != nullptr) {
-        esp_srmodel_deinit(models_);
-    }
 }
 
 bool CustomWakeWord::Initialize(AudioCodec* codec) {
     codec_ = codec;
 
-    models_ = esp_srmodel_init("model");
+    models_ = Ota::LoadModels();
     if (models_ == nullptr || models_->num == -1) {
         ESP_LOGE(TAG, "Failed to initialize wakenet model");
         return false;
@@ -56,17 +60,31 @@ bool CustomWakeWord::Initialize(AudioCodec* codec) {
     multinet_model_data_ = multinet_->create(mn_name_, 3000);  // 3 秒超时
     multinet_->set_det_threshold(multinet_model_data_, CONFIG_CUSTOM_WAKE_WORD_THRESHOLD / 100.0f);
     esp_mn_commands_clear();
-    esp_mn_commands_add(1, CONFIG_CUSTOM_WAKE_WORD);
+    esp_mn_commands_add(WAKE_WORD_COMMAND_ID, CONFIG_CUSTOM_WAKE_WORD);
+#if CONFIG_USE_LOCAL_COMMANDS
+    auto& commands = LocalCommands::GetInstance().commands();
+    for (size_t i = 0; i < commands.size(); i++) {
+        esp_mn_commands_add(LOCAL_COMMAND_ID_BASE + i, commands[i].phrase.c_str());
+    }
+#endif
     esp_mn_commands_update();
     
     multinet_->print_active_speech_commands(multinet_model_data_);
-    return true;
+
+    // multinet 推理在单独的任务中进行，不占用 audio_input 任务的时间和栈
+    return worker_.Start("custom_wake_word", GetFeedSize(), 4096 * 2, [this](const std::vector<int16_t>& data) {
+        Detect(data);
+    });
 }
 
 void CustomWakeWord::OnWakeWordDetected(std::function<void(const std::string& wake_word)> callback) {
     wake_word_detected_callback_ = callback;
 }
 
+void CustomWakeWord::OnCommandDetected(std::function<void(int command)> callback) {
+    command_detected_callback_ = callback;
+}
+
 void CustomWakeWord::Start() {
     running_ = true;
 }
@@ -79,30 +97,36 @@ void CustomWakeWord::Feed(const std::vector<int16_t>& data) {
     if (multinet_model_data_ == nullptr || !running_) {
         return;
     }
+    worker_.Push(data, codec_->input_channels());
+}
 
-    esp_mn_state_t mn_state;
-    // If input channels is 2, we need to fetch the left channel data
-    if (codec_->input_channels() == 2) {
-        auto mono_data = std::vector<int16_t>(data.size() / 2);
-        for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-            mono_data[i] = data[j];
-        }
-
-        StoreWakeWordData(mono_data);
-        mn_state = multinet_->detect(multinet_model_data_, const_cast<int16_t*>(mono_data.data()));
-    } else {
-        StoreWakeWordData(data);
-        mn_state = multinet_->detect(multinet_model_data_, const_cast<int16_t*>(data.data()));
+// 在识别任务中调用，data 已经是单声道
+void CustomWakeWord::Detect(const std::vector<int16_t>& data) {
+    if (!running_) {
+        return;
     }
-    
+
+    StoreWakeWordData(data);
+    esp_mn_state_t mn_state = multinet_->detect(multinet_model_data_, const_cast<int16_t*>(data.data()));
     if (mn_state == ESP_MN_STATE_DETECTING) {
         return;
     } else if (mn_state == ESP_MN_STATE_DETECTED) {
         esp_mn_results_t *mn_result = multinet_->get_results(multinet_model_data_);
         ESP_LOGI(TAG, "Custom wake word detected: command_id=%d, string=%s, prob=%f", 
                 mn_result->command_id[0], mn_result->string, mn_result->prob[0]);
+        worker_.RecordDetection();
+
+        // 本地命令词不打断检测，继续等待唤醒词或下一条命令
+        int command_id = mn_result->command_id[0];
+        if (command_id >= LOCAL_COMMAND_ID_BASE) {
+            multinet_->clean(multinet_model_data_);
+            if (command_detected_callback_) {
+                command_detected_callback_(command_id - LOCAL_COMMAND_ID_BASE);
+            }
+            return;
+        }
         
-        if (mn_result->command_id[0] == 1) {
+        if (command_id == WAKE_WORD_COMMAND_ID) {
             last_detected_wake_word_ = CONFIG_CUSTOM_WAKE_WORD_DISPLAY;
         }
         running_ = false;
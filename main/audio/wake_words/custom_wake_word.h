@@ -16,6 +16,7 @@
 
 #include "audio_codec.h"
 #include "wake_word.h"
+#include "wake_word_worker.h"
 
 class CustomWakeWord : public WakeWord {
 public:
@@ -25,6 +26,7 @@ public:
     bool Initialize(AudioCodec* codec);
     void Feed(const std::vector<int16_t>& data);
     void OnWakeWordDetected(std::function<void(const std::string& wake_word)> callback);
+    void OnCommandDetected(std::function<void(int command)> callback);
     void Start();
     void Stop();
     size_t GetFeedSize();
@@ -40,6 +42,7 @@ private:
     char* mn_name_ = nullptr;
  
     std::function<void(const std::string& wake_word)> wake_word_detected_callback_;
+    std::function<void(int command)> command_detected_callback_;
     AudioCodec* codec_ = nullptr;
     std::string last_detected_wake_word_;
     std::atomic<bool> running_ = false;
@@ -51,8 +54,10 @@ private:
     std::deque<std::vector<uint8_t>> wake_word_opus_;
     std::mutex wake_word_mutex_;
     std::condition_variable wake_word_cv_;
+    WakeWordWorker worker_;
 
     void StoreWakeWordData(const std::vector<int16_t>& data);
+    void Detect(const std::vector<int16_t>& data);
 };
 
 #endif
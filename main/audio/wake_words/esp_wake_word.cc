@@ -1,4 +1,5 @@
 #include "esp_wake_word.h"
+#include "ota.h"
 #include <esp_log.h>
 
 
@@ -10,14 +11,13 @@ EspWakeWord::EspWakeWord() {
 EspWakeWord::~EspWakeWord() {
     if (wakenet_data_ != nullptr) {
         wakenet_iface_->destroy(wakenet_data_);
-        esp_srmodel_deinit(wakenet_model_);
     }
 }
 
 bool EspWakeWord::Initialize(AudioCodec* codec) {
     codec_ = codec;
 
-    wakenet_model_ = esp_srmodel_init("model");
+    wakenet_model_ = Ota::LoadModels();
     if (wakenet_model_ == nullptr || wakenet_model_->num == -1) {
         ESP_LOGE(TAG, "Failed to initialize wakenet model");
         return false;
@@ -36,7 +36,9 @@ bool EspWakeWord::Initialize(AudioCodec* codec) {
     int audio_chunksize = wakenet_iface_->get_samp_chunksize(wakenet_data_);
     ESP_LOGI(TAG, "Wake word(%s),freq: %d, chunksize: %d", model_name, frequency, audio_chunksize);
 
-    return true;
+    return worker_.Start("esp_wake_word", audio_chunksize, 4096, [this](const std::vector<int16_t>& data) {
+        Detect(data);
+    });
 }
 
 void EspWakeWord::OnWakeWordDetected(std::function<void(const std::string& wake_word)> callback) {
@@ -55,10 +57,19 @@ void EspWakeWord::Feed(const std::vector<int16_t>& data) {
     if (wakenet_data_ == nullptr || !running_) {
         return;
     }
+    worker_.Push(data, codec_->input_channels());
+}
+
+// 在识别任务中调用，data 已经是单声道
+void EspWakeWord::Detect(const std::vector<int16_t>& data) {
+    if (!running_) {
+        return;
+    }
 
     int res = wakenet_iface_->detect(wakenet_data_, (int16_t *)data.data());
     if (res > 0) {
         last_detected_wake_word_ = wakenet_iface_->get_word_name(wakenet_data_, res);
+        worker_.RecordDetection();
         running_ = false;
 
         if (wake_word_detected_callback_) {
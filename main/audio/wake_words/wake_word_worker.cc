@@ -0,0 +1,96 @@
+#include "wake_word_worker.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+
+#define TAG "WakeWordWorker"
+
+#if CONFIG_WAKE_WORD_TASK_CORE < 0
+#define WAKE_WORD_TASK_CORE tskNO_AFFINITY
+#else
+#define WAKE_WORD_TASK_CORE CONFIG_WAKE_WORD_TASK_CORE
+#endif
+
+WakeWordWorker::WakeWordWorker() {
+}
+
+WakeWordWorker::~WakeWordWorker() {
+    if (task_ != nullptr) {
+        vTaskDelete(task_);
+    }
+}
+
+bool WakeWordWorker::Start(const char* name, size_t chunk_samples, uint32_t stack_size, DetectFunction detect) {
+    if (task_ != nullptr) {
+        return true;
+    }
+    chunk_samples_ = chunk_samples;
+    detect_ = detect;
+    // 预先分配好所有槽位，Push 时不再分配内存
+    for (auto& slot : slots_) {
+        slot.pcm.resize(chunk_samples);
+    }
+
+    // 优先级低于 audio_input，推理不会抢占 I2S 读取
+    auto ret = xTaskCreatePinnedToCore([](void* arg) {
+        auto this_ = (WakeWordWorker*)arg;
+        this_->WorkerTask();
+        vTaskDelete(NULL);
+    }, name, stack_size, this, 7, &task_, WAKE_WORD_TASK_CORE);
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create %s task", name);
+        task_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void WakeWordWorker::Push(const std::vector<int16_t>& data, int channels) {
+    if (task_ == nullptr || data.size() != chunk_samples_ * channels) {
+        return;
+    }
+
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= RING_CHUNKS) {
+        auto dropped = ++dropped_chunks_;
+        // 持续丢帧时不要刷屏
+        if ((dropped & (dropped - 1)) == 0) {
+            ESP_LOGW(TAG, "Wake word ring full, %lu chunks dropped", (unsigned long)dropped);
+        }
+        return;
+    }
+
+    auto& slot = slots_[head % RING_CHUNKS];
+    slot.time_us = esp_timer_get_time();
+    if (channels == 1) {
+        std::copy(data.begin(), data.end(), slot.pcm.begin());
+    } else {
+        // 只取左声道
+        for (size_t i = 0, j = 0; i < chunk_samples_; ++i, j += channels) {
+            slot.pcm[i] = data[j];
+        }
+    }
+    head_.store(head + 1, std::memory_order_release);
+    xTaskNotifyGive(task_);
+}
+
+void WakeWordWorker::RecordDetection() {
+    last_latency_ms_ = (esp_timer_get_time() - current_time_us_) / 1000;
+    ESP_LOGI(TAG, "Detection latency: %d ms, dropped chunks: %lu",
+        last_latency_ms_.load(), (unsigned long)dropped_chunks_.load());
+}
+
+void WakeWordWorker::WorkerTask() {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        while (tail != head_.load(std::memory_order_acquire)) {
+            auto& slot = slots_[tail % RING_CHUNKS];
+            current_time_us_ = slot.time_us;
+            detect_(slot.pcm);
+            tail_.store(++tail, std::memory_order_release);
+        }
+    }
+}
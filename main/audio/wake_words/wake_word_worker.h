@@ -0,0 +1,58 @@
+#ifndef WAKE_WORD_WORKER_H
+#define WAKE_WORD_WORKER_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+/*
+ * Runs wake word inference on its own task
+ *
+ * The audio input task only copies each chunk (left channel) into a single-producer /
+ * single-consumer ring and returns to ReadAudioData, so a slow detect() no longer delays
+ * the next I2S read. When the ring is full the new chunk is dropped and counted instead
+ * of blocking the input task.
+ */
+
+class WakeWordWorker {
+public:
+    using DetectFunction = std::function<void(const std::vector<int16_t>& chunk)>;
+
+    WakeWordWorker();
+    ~WakeWordWorker();
+
+    // chunk_samples 为单声道样本数，detect 在识别任务中调用
+    bool Start(const char* name, size_t chunk_samples, uint32_t stack_size, DetectFunction detect);
+    // 只能在 audio_input 任务中调用
+    void Push(const std::vector<int16_t>& data, int channels);
+    // 在 detect 中检测到唤醒词时调用，记录从采集到检测的延迟
+    void RecordDetection();
+
+    uint32_t dropped_chunks() const { return dropped_chunks_; }
+    int last_latency_ms() const { return last_latency_ms_; }
+
+private:
+    static constexpr size_t RING_CHUNKS = 8;
+
+    struct Slot {
+        int64_t time_us;
+        std::vector<int16_t> pcm;
+    };
+
+    TaskHandle_t task_ = nullptr;
+    Slot slots_[RING_CHUNKS];
+    std::atomic<uint32_t> head_ = 0;
+    std::atomic<uint32_t> tail_ = 0;
+    std::atomic<uint32_t> dropped_chunks_ = 0;
+    std::atomic<int> last_latency_ms_ = 0;
+    int64_t current_time_us_ = 0;
+    size_t chunk_samples_ = 0;
+    DetectFunction detect_;
+
+    void WorkerTask();
+};
+
+#endif
@@ -101,6 +101,10 @@ std::string Board::GetJson() {
             "ota": {
                 "label": "ota_0"
             },
+            "models": {
+                "version": "",
+                "partition": "model"
+            },
             "board": {
                 ...
             }
@@ -154,6 +158,13 @@ std::string Board::GetJson() {
     json += R"("label":")" + std::string(ota_partition->label) + R"(")";
     json += R"(},)";
 
+    // 已安装的模型包版本，服务器据此决定是否下发 models
+    Settings models_settings("models", false);
+    json += R"("models":{)";
+    json += R"("version":")" + models_settings.GetString("version") + R"(",)";
+    json += R"("partition":")" + models_settings.GetString("partition", "model") + R"(")";
+    json += R"(},)";
+
     json += R"("board":)" + GetBoardJson();
 
     // Close the JSON object
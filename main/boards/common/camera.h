@@ -9,7 +9,10 @@ public:
     virtual bool Capture() = 0;
     virtual bool SetHMirror(bool enabled) = 0;
     virtual bool SetVFlip(bool enabled) = 0;
-    virtual std::string Explain(const std::string& question) = 0;
+    // tier 为本次上传的分辨率档位 (auto / low / medium / high / full)，为空时使用默认档位
+    virtual std::string Explain(const std::string& question, const std::string& tier) = 0;
+    // 默认的上传分辨率档位
+    virtual void SetUploadTier(const std::string& tier) {}
 };
 
 #endif // CAMERA_H
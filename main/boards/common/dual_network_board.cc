@@ -43,13 +43,20 @@ void DualNetworkBoard::InitializeCurrentBoard() {
 }
 
 void DualNetworkBoard::SwitchNetworkType() {
-    auto display = GetDisplay();
+    const char* notification;
     if (network_type_ == NetworkType::WIFI) {    
         SaveNetworkTypeToSettings(NetworkType::ML307);
-        display->ShowNotification(Lang::Strings::SWITCH_TO_4G_NETWORK);
+        notification = Lang::Strings::SWITCH_TO_4G_NETWORK;
     } else {
         SaveNetworkTypeToSettings(NetworkType::WIFI);
-        display->ShowNotification(Lang::Strings::SWITCH_TO_WIFI_NETWORK);
+        notification = Lang::Strings::SWITCH_TO_WIFI_NETWORK;
+    }
+    // May be triggered by a button before Application::Start has created the display queue
+    auto display_queue = Application::GetInstance().GetDisplayQueue();
+    if (display_queue != nullptr) {
+        display_queue->ShowNotification(notification);
+    } else {
+        GetDisplay()->ShowNotification(notification);
     }
     vTaskDelay(pdMS_TO_TICKS(1000));
     auto& app = Application::GetInstance();
@@ -62,12 +69,12 @@ std::string DualNetworkBoard::GetBoardType() {
 }
 
 void DualNetworkBoard::StartNetwork() {
-    auto display = Board::GetInstance().GetDisplay();
+    auto display_queue = Application::GetInstance().GetDisplayQueue();
     
     if (network_type_ == NetworkType::WIFI) {
-        display->SetStatus(Lang::Strings::CONNECTING);
+        display_queue->SetStatus(Lang::Strings::CONNECTING);
     } else {
-        display->SetStatus(Lang::Strings::DETECTING_MODULE);
+        display_queue->SetStatus(Lang::Strings::DETECTING_MODULE);
     }
     current_board_->StartNetwork();
 }
@@ -1,16 +1,61 @@
 #include "esp32_camera.h"
 #include "mcp_server.h"
 #include "display.h"
+#include "application.h"
 #include "board.h"
 #include "system_info.h"
 
 #include <esp_log.h>
 #include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <esp_pthread.h>
 #include <img_converters.h>
 #include <cstring>
+#include <algorithm>
 
 #define TAG "Esp32Camera"
 
+// 最后写入的数据可能还在 TCP 发送缓冲区中，计算上行速率时不计入
+#ifdef CONFIG_LWIP_TCP_SND_BUF_DEFAULT
+#define CAMERA_TCP_SEND_BUFFER_SIZE CONFIG_LWIP_TCP_SND_BUF_DEFAULT
+#else
+#define CAMERA_TCP_SEND_BUFFER_SIZE 5760
+#endif
+
+// 上传分辨率档位，max_width 为 0 表示保持原始分辨率
+struct UploadTier {
+    const char* name;
+    int max_width;
+};
+
+static const UploadTier kUploadTiers[] = {
+    {"auto", CONFIG_CAMERA_UPLOAD_MAX_WIDTH},
+    {"low", 320},
+    {"medium", 480},
+    {"high", 640},
+    {"full", 0},
+};
+
+// JPEG 大小相对于质量 80 的经验比例，用于根据字节预算预测质量
+struct QualitySize {
+    int quality;
+    float relative_size;
+};
+
+static const QualitySize kQualitySizeTable[] = {
+    {90, 1.50f}, {80, 1.00f}, {70, 0.80f}, {60, 0.68f}, {50, 0.60f},
+    {40, 0.52f}, {30, 0.44f}, {20, 0.35f}, {12, 0.27f},
+};
+
+static float GetRelativeJpegSize(int quality) {
+    for (const auto& entry : kQualitySizeTable) {
+        if (quality >= entry.quality) {
+            return entry.relative_size;
+        }
+    }
+    return kQualitySizeTable[std::size(kQualitySizeTable) - 1].relative_size;
+}
+
 Esp32Camera::Esp32Camera(const camera_config_t& config) {
     // camera init
     esp_err_t err = esp_camera_init(&config); // 配置上面定义的参数
@@ -30,41 +75,7 @@ Esp32Camera::Esp32Camera(const camera_config_t& config) {
     preview_image_.header.cf = LV_COLOR_FORMAT_RGB565;
     preview_image_.header.flags = LV_IMAGE_FLAGS_ALLOCATED | LV_IMAGE_FLAGS_MODIFIABLE;
 
-    switch (config.frame_size) {
-        case FRAMESIZE_SVGA:
-            preview_image_.header.w = 800;
-            preview_image_.header.h = 600;
-            break;
-        case FRAMESIZE_VGA:
-            preview_image_.header.w = 640;
-            preview_image_.header.h = 480;
-            break;
-        case FRAMESIZE_QVGA:
-            preview_image_.header.w = 320;
-            preview_image_.header.h = 240;
-            break;
-        case FRAMESIZE_128X128:
-            preview_image_.header.w = 128;
-            preview_image_.header.h = 128;
-            break;
-        case FRAMESIZE_240X240:
-            preview_image_.header.w = 240;
-            preview_image_.header.h = 240;
-            break;
-        default:
-            ESP_LOGE(TAG, "Unsupported frame size: %d, image preview will not be shown", config.frame_size);
-            preview_image_.data_size = 0;
-            preview_image_.data = nullptr;
-            return;
-    }
-
-    preview_image_.header.stride = preview_image_.header.w * 2;
-    preview_image_.data_size = preview_image_.header.w * preview_image_.header.h * 2;
-    preview_image_.data = (uint8_t*)heap_caps_malloc(preview_image_.data_size, MALLOC_CAP_SPIRAM);
-    if (preview_image_.data == nullptr) {
-        ESP_LOGE(TAG, "Failed to allocate memory for preview image");
-        return;
-    }
+    // 预览缓冲区按显示区域尺寸在第一次拍照时分配，见 PreparePreview()
 }
 
 Esp32Camera::~Esp32Camera() {
@@ -76,6 +87,20 @@ Esp32Camera::~Esp32Camera() {
         heap_caps_free((void*)preview_image_.data);
         preview_image_.data = nullptr;
     }
+    if (scaled_frame_) {
+        heap_caps_free(scaled_frame_);
+        scaled_frame_ = nullptr;
+    }
+    for (auto buffer : chunk_pool_) {
+        heap_caps_free(buffer);
+    }
+    chunk_pool_.clear();
+    if (free_chunk_queue_ != nullptr) {
+        vQueueDelete(free_chunk_queue_);
+    }
+    if (filled_chunk_queue_ != nullptr) {
+        vQueueDelete(filled_chunk_queue_);
+    }
     esp_camera_deinit();
 }
 
@@ -84,11 +109,23 @@ void Esp32Camera::SetExplainUrl(const std::string& url, const std::string& token
     explain_token_ = token;
 }
 
+void Esp32Camera::SetUploadTier(const std::string& tier) {
+    for (const auto& entry : kUploadTiers) {
+        if (tier == entry.name) {
+            ESP_LOGI(TAG, "Upload tier set to: %s", entry.name);
+            upload_tier_ = tier;
+            return;
+        }
+    }
+    ESP_LOGW(TAG, "Unknown upload tier: %s", tier.c_str());
+}
+
 bool Esp32Camera::Capture() {
     if (encoder_thread_.joinable()) {
         encoder_thread_.join();
     }
 
+    int64_t start_time = esp_timer_get_time();
     int frames_to_get = 2;
     // Try to get a stable frame
     for (int i = 0; i < frames_to_get; i++) {
@@ -101,31 +138,129 @@ bool Esp32Camera::Capture() {
             return false;
         }
     }
+    capture_duration_us_ = esp_timer_get_time() - start_time;
 
-    // 如果预览图片 buffer 为空，则跳过预览
+    // 显示预览图片
+    auto display = Board::GetInstance().GetDisplay();
+    if (display == nullptr || display->width() == 0 || display->height() == 0) {
+        return true;
+    }
+    // 如果预览图片 buffer 准备失败，则跳过预览
     // 但仍返回 true，因为此时图像可以上传至服务器
-    if (preview_image_.data_size == 0) {
-        ESP_LOGW(TAG, "Skip preview because of unsupported frame size");
+    if (fb_->format != PIXFORMAT_RGB565) {
+        ESP_LOGW(TAG, "Skip preview because of unsupported pixel format: %d", fb_->format);
         return true;
     }
-    if (preview_image_.data == nullptr) {
+    // 直接生成预览区域大小的图片，LVGL 重绘时不需要再缩放
+    int preview_width, preview_height;
+    display->GetPreviewImageSize(preview_width, preview_height);
+    if (!PreparePreview(preview_width, preview_height)) {
         ESP_LOGE(TAG, "Preview image data is not initialized");
         return true;
     }
-    // 显示预览图片
-    auto display = Board::GetInstance().GetDisplay();
-    if (display != nullptr) {
-        auto src = (uint16_t*)fb_->buf;
-        auto dst = (uint16_t*)preview_image_.data;
-        size_t pixel_count = fb_->len / 2;
-        for (size_t i = 0; i < pixel_count; i++) {
-            // 交换每个16位字内的字节
-            dst[i] = __builtin_bswap16(src[i]);
+
+    int64_t convert_start = esp_timer_get_time();
+    ConvertPreview();
+    ESP_LOGI(TAG, "Preview %dx%d -> %dx%d in %lldus", fb_->width, fb_->height,
+        (int)preview_image_.header.w, (int)preview_image_.header.h, esp_timer_get_time() - convert_start);
+    Application::GetInstance().GetDisplayQueue()->SetPreviewImage(&preview_image_);
+    return true;
+}
+
+/**
+ * 计算预览图缩放映射并分配与显示区域尺寸匹配的预览缓冲区。
+ * 源图和屏幕尺寸不变时直接复用上一次的结果，不放大图像。
+ * 开启 CONFIG_CAMERA_PREVIEW_CROP 时按比例填满显示区域并居中裁剪，否则按比例完整显示。
+ */
+bool Esp32Camera::PreparePreview(int display_width, int display_height) {
+    int src_width = fb_->width;
+    int src_height = fb_->height;
+    if (preview_image_.data != nullptr && preview_src_width_ == src_width && preview_src_height_ == src_height &&
+        preview_display_width_ == display_width && preview_display_height_ == display_height) {
+        return true;
+    }
+
+    float scale_x = (float)display_width / src_width;
+    float scale_y = (float)display_height / src_height;
+#if CONFIG_CAMERA_PREVIEW_CROP
+    float scale = std::min(std::max(scale_x, scale_y), 1.0f);
+#else
+    float scale = std::min(std::min(scale_x, scale_y), 1.0f);
+#endif
+    int width = std::max(1, std::min(display_width, (int)(src_width * scale)));
+    int height = std::max(1, std::min(display_height, (int)(src_height * scale)));
+    // 居中裁剪时源图的起始偏移
+    float offset_x = (src_width - width / scale) / 2;
+    float offset_y = (src_height - height / scale) / 2;
+
+    preview_x_map_.resize(width);
+    for (int x = 0; x < width; x++) {
+        preview_x_map_[x] = std::min(src_width - 1, (int)(offset_x + (x + 0.5f) / scale));
+    }
+    preview_y_map_.resize(height);
+    for (int y = 0; y < height; y++) {
+        preview_y_map_[y] = std::min(src_height - 1, (int)(offset_y + (y + 0.5f) / scale));
+    }
+
+    size_t data_size = width * height * 2;
+    if (preview_image_.data == nullptr || preview_image_.data_size < data_size) {
+        if (preview_image_.data != nullptr) {
+            heap_caps_free((void*)preview_image_.data);
+        }
+        preview_image_.data = (uint8_t*)heap_caps_malloc(data_size, MALLOC_CAP_SPIRAM);
+        if (preview_image_.data == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate memory for preview image");
+            preview_image_.data_size = 0;
+            return false;
         }
-        display->SetPreviewImage(&preview_image_);
     }
+    preview_image_.header.w = width;
+    preview_image_.header.h = height;
+    preview_image_.header.stride = width * 2;
+    preview_image_.data_size = data_size;
+
+    preview_src_width_ = src_width;
+    preview_src_height_ = src_height;
+    preview_display_width_ = display_width;
+    preview_display_height_ = display_height;
+    ESP_LOGI(TAG, "Preview image %dx%d for frame %dx%d, box %dx%d", width, height,
+        src_width, src_height, display_width, display_height);
     return true;
 }
+
+// 一次遍历完成字节交换与缩放，直接写入显示区域尺寸的预览缓冲区
+void Esp32Camera::ConvertPreview() {
+    auto src = (const uint16_t*)fb_->buf;
+    int src_width = fb_->width;
+    int width = preview_image_.header.w;
+    int height = preview_image_.header.h;
+
+    if (width == src_width && height == (int)fb_->height) {
+        // 尺寸相同：每次处理两个像素，交换 32 位字中两个 16 位半字各自的字节
+        auto src32 = (const uint32_t*)fb_->buf;
+        auto dst32 = (uint32_t*)preview_image_.data;
+        size_t count = (size_t)width * height / 2;
+        for (size_t i = 0; i < count; i++) {
+            uint32_t v = src32[i];
+            dst32[i] = ((v & 0x00FF00FF) << 8) | ((v >> 8) & 0x00FF00FF);
+        }
+        if ((width * height) & 1) {
+            auto dst = (uint16_t*)preview_image_.data;
+            dst[width * height - 1] = __builtin_bswap16(src[width * height - 1]);
+        }
+        return;
+    }
+
+    auto dst = (uint16_t*)preview_image_.data;
+    const uint16_t* x_map = preview_x_map_.data();
+    for (int y = 0; y < height; y++) {
+        auto row = src + preview_y_map_[y] * src_width;
+        for (int x = 0; x < width; x++) {
+            *dst++ = __builtin_bswap16(row[x_map[x]]);
+        }
+    }
+}
+
 bool Esp32Camera::SetHMirror(bool enabled) {
     sensor_t *s = esp_camera_sensor_get();
     if (s == nullptr) {
@@ -160,6 +295,213 @@ bool Esp32Camera::SetVFlip(bool enabled) {
     return true;
 }
 
+bool Esp32Camera::InitializeChunkPool() {
+    if (!chunk_pool_.empty()) {
+        return true;
+    }
+
+    if (free_chunk_queue_ == nullptr) {
+        free_chunk_queue_ = xQueueCreate(CONFIG_CAMERA_UPLOAD_CHUNK_COUNT, sizeof(uint8_t*));
+    }
+    if (filled_chunk_queue_ == nullptr) {
+        // 多留一个位置给结束标记，保证编码线程发送结束标记时不会阻塞
+        filled_chunk_queue_ = xQueueCreate(CONFIG_CAMERA_UPLOAD_CHUNK_COUNT + 1, sizeof(JpegChunk));
+    }
+    if (free_chunk_queue_ == nullptr || filled_chunk_queue_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create JPEG chunk queues");
+        return false;
+    }
+
+    for (int i = 0; i < CONFIG_CAMERA_UPLOAD_CHUNK_COUNT; i++) {
+        auto buffer = (uint8_t*)heap_caps_aligned_alloc(16, CONFIG_CAMERA_UPLOAD_CHUNK_SIZE, MALLOC_CAP_SPIRAM);
+        if (buffer == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate JPEG chunk buffer %d", i);
+            // 释放已分配的部分，下次调用时重新尝试
+            for (auto allocated : chunk_pool_) {
+                heap_caps_free(allocated);
+            }
+            chunk_pool_.clear();
+            vQueueDelete(free_chunk_queue_);
+            vQueueDelete(filled_chunk_queue_);
+            free_chunk_queue_ = nullptr;
+            filled_chunk_queue_ = nullptr;
+            return false;
+        }
+        chunk_pool_.push_back(buffer);
+        xQueueSend(free_chunk_queue_, &buffer, 0);
+    }
+    ESP_LOGI(TAG, "JPEG chunk pool: %d x %d bytes", CONFIG_CAMERA_UPLOAD_CHUNK_COUNT, CONFIG_CAMERA_UPLOAD_CHUNK_SIZE);
+    return true;
+}
+
+// Box-filter downscale by an integer factor, keeping the sensor's big-endian RGB565 byte order
+bool Esp32Camera::DownscaleFrame(int factor) {
+    int src_width = fb_->width;
+    int dst_width = fb_->width / factor;
+    int dst_height = fb_->height / factor;
+    size_t size = dst_width * dst_height * 2;
+    if (size > scaled_frame_size_) {
+        if (scaled_frame_) {
+            heap_caps_free(scaled_frame_);
+        }
+        scaled_frame_ = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+        scaled_frame_size_ = scaled_frame_ ? size : 0;
+        if (scaled_frame_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate scaled frame buffer");
+            return false;
+        }
+    }
+
+    auto src = (const uint16_t*)fb_->buf;
+    auto dst = (uint16_t*)scaled_frame_;
+    int area = factor * factor;
+    for (int y = 0; y < dst_height; y++) {
+        for (int x = 0; x < dst_width; x++) {
+            uint32_t r = 0, g = 0, b = 0;
+            for (int dy = 0; dy < factor; dy++) {
+                auto row = src + (y * factor + dy) * src_width + x * factor;
+                for (int dx = 0; dx < factor; dx++) {
+                    uint16_t pixel = __builtin_bswap16(row[dx]);
+                    r += pixel >> 11;
+                    g += (pixel >> 5) & 0x3F;
+                    b += pixel & 0x1F;
+                }
+            }
+            uint16_t pixel = ((r / area) << 11) | ((g / area) << 5) | (b / area);
+            *dst++ = __builtin_bswap16(pixel);
+        }
+    }
+    return true;
+}
+
+/**
+ * 根据上传档位确定编码分辨率，并根据测得的上行速率计算字节预算来预测 JPEG 质量。
+ * 编码与上传是流水线并行的，无法反复编码试探，所以用上一次的实际压缩率来预测。
+ * auto 档位下如果最低质量仍超出预算，会继续缩小分辨率（最多 1/4）。
+ */
+void Esp32Camera::PrepareEncodeParameters(const std::string& tier) {
+    int max_width = CONFIG_CAMERA_UPLOAD_MAX_WIDTH;
+    bool adaptive = true;
+    auto it = std::find_if(std::begin(kUploadTiers), std::end(kUploadTiers), [&tier](const UploadTier& entry) {
+        return tier == entry.name;
+    });
+    if (it != std::end(kUploadTiers)) {
+        max_width = it->max_width;
+        adaptive = tier == "auto";
+    } else {
+        ESP_LOGW(TAG, "Unknown upload tier: %s, using auto", tier.c_str());
+    }
+
+    int width = fb_->width;
+    int height = fb_->height;
+    int factor = 1;
+    if (fb_->format == PIXFORMAT_RGB565) {
+        while (max_width > 0 && width / factor > max_width && factor < 4) {
+            factor++;
+        }
+    }
+
+    int quality = CONFIG_CAMERA_JPEG_QUALITY;
+    if (uplink_bytes_per_second_ > 0) {
+        float budget = uplink_bytes_per_second_ * CONFIG_CAMERA_UPLOAD_TARGET_MS / 1000;
+        const auto& lowest = kQualitySizeTable[std::size(kQualitySizeTable) - 1];
+        while (true) {
+            float pixels = (float)(width / factor) * (height / factor);
+            quality = lowest.quality;
+            for (const auto& entry : kQualitySizeTable) {
+                if (entry.quality <= CONFIG_CAMERA_JPEG_QUALITY &&
+                    jpeg_bytes_per_pixel_ * pixels * entry.relative_size <= budget) {
+                    quality = entry.quality;
+                    break;
+                }
+            }
+            bool over_budget = jpeg_bytes_per_pixel_ * pixels * lowest.relative_size > budget;
+            if (!over_budget || !adaptive || fb_->format != PIXFORMAT_RGB565 || factor >= 4) {
+                break;
+            }
+            factor++;
+        }
+    }
+
+    encode_width_ = width / factor;
+    encode_height_ = height / factor;
+    encode_quality_ = quality;
+    if (factor > 1 && !DownscaleFrame(factor)) {
+        encode_width_ = width;
+        encode_height_ = height;
+    }
+    ESP_LOGI(TAG, "Encode %dx%d -> %dx%d, quality=%d, tier=%s, uplink=%.1fKB/s",
+        width, height, encode_width_, encode_height_, encode_quality_,
+        tier.c_str(), uplink_bytes_per_second_ / 1024);
+}
+
+// Runs in the encoder thread, fills pooled chunks and hands them to the uploader
+void Esp32Camera::EncodeToChunks() {
+    struct ChunkWriter {
+        Esp32Camera* camera;
+        JpegChunk chunk;
+    } writer = { this, { nullptr, 0 } };
+
+    auto write_chunk = [](void* arg, size_t index, const void* data, size_t len) -> unsigned int {
+        auto writer = (ChunkWriter*)arg;
+        auto camera = writer->camera;
+        auto src = (const uint8_t*)data;
+        size_t remaining = len;
+        while (remaining > 0) {
+            if (camera->encode_aborted_) {
+                return 0; // Stop the encoder
+            }
+            if (writer->chunk.data == nullptr) {
+                // 缓冲区全部被占用时在此等待上传线程归还（背压）
+                xQueueReceive(camera->free_chunk_queue_, &writer->chunk.data, portMAX_DELAY);
+                writer->chunk.len = 0;
+            }
+            size_t n = std::min(remaining, (size_t)CONFIG_CAMERA_UPLOAD_CHUNK_SIZE - writer->chunk.len);
+            memcpy(writer->chunk.data + writer->chunk.len, src, n);
+            writer->chunk.len += n;
+            src += n;
+            remaining -= n;
+            if (writer->chunk.len == CONFIG_CAMERA_UPLOAD_CHUNK_SIZE) {
+                xQueueSend(camera->filled_chunk_queue_, &writer->chunk, portMAX_DELAY);
+                writer->chunk.data = nullptr;
+            }
+        }
+        return len;
+    };
+
+    if (encode_width_ != (int)fb_->width) {
+        fmt2jpg_cb(scaled_frame_, encode_width_ * encode_height_ * 2, encode_width_, encode_height_,
+            PIXFORMAT_RGB565, encode_quality_, write_chunk, &writer);
+    } else {
+        frame2jpg_cb(fb_, encode_quality_, write_chunk, &writer);
+    }
+
+    // Flush the last partial chunk
+    if (writer.chunk.data != nullptr) {
+        if (writer.chunk.len > 0 && !encode_aborted_) {
+            xQueueSend(filled_chunk_queue_, &writer.chunk, portMAX_DELAY);
+        } else {
+            xQueueSend(free_chunk_queue_, &writer.chunk.data, portMAX_DELAY);
+        }
+    }
+    encode_done_time_us_ = esp_timer_get_time();
+
+    // The last chunk
+    JpegChunk end = { nullptr, 0 };
+    xQueueSend(filled_chunk_queue_, &end, portMAX_DELAY);
+}
+
+// Return all pending chunks to the pool until the end marker is received
+void Esp32Camera::DrainChunks() {
+    JpegChunk chunk;
+    while (xQueueReceive(filled_chunk_queue_, &chunk, portMAX_DELAY) == pdPASS) {
+        if (chunk.data == nullptr) {
+            break;
+        }
+        xQueueSend(free_chunk_queue_, &chunk.data, portMAX_DELAY);
+    }
+}
+
 /**
  * @brief 将摄像头捕获的图像发送到远程服务器进行AI分析和解释
  * 
@@ -170,10 +512,15 @@ bool Esp32Camera::SetVFlip(bool enabled) {
  * 实现特点：
  * - 使用独立线程编码JPEG，与主线程分离
  * - 采用分块传输编码(chunked transfer encoding)优化内存使用
- * - 通过队列机制实现编码线程和发送线程的数据同步
+ * - 编码线程直接写入固定数量的 PSRAM 分块缓冲区，上传线程直接发送后归还，
+ *   缓冲区耗尽时编码线程等待（背压），不再为每个分块分配内存
+ * - 上传前按档位整数倍缩小 RGB565 图像，并根据测得的上行速率预测 JPEG 质量以满足字节预算
+ * - 分块大小可通过 CONFIG_CAMERA_UPLOAD_CHUNK_SIZE 与 TCP 发送窗口匹配
  * - 支持设备ID、客户端ID和认证令牌的HTTP头部配置
+ * - 输出拍照、编码、首字节发送和服务器响应各阶段耗时
  * 
  * @param question 要向AI提出的关于图像的问题，将作为表单字段发送
+ * @param tier 本次上传的分辨率档位，为空时使用 SetUploadTier() 设置的默认档位
  * @return std::string 服务器返回的JSON格式响应字符串
  *         成功时包含AI分析结果，失败时包含错误信息
  *         格式示例：{"success": true, "result": "分析结果"}
@@ -183,31 +530,37 @@ bool Esp32Camera::SetVFlip(bool enabled) {
  * @note 函数会等待之前的编码线程完成后再开始新的处理
  * @warning 如果摄像头缓冲区为空或网络连接失败，将返回错误信息
  */
-std::string Esp32Camera::Explain(const std::string& question) {
+std::string Esp32Camera::Explain(const std::string& question, const std::string& tier) {
     if (explain_url_.empty()) {
         return "{\"success\": false, \"message\": \"Image explain URL or token is not set\"}";
     }
 
-    // 创建局部的 JPEG 队列, 40 entries is about to store 512 * 40 = 20480 bytes of JPEG data
-    QueueHandle_t jpeg_queue = xQueueCreate(40, sizeof(JpegChunk));
-    if (jpeg_queue == nullptr) {
-        ESP_LOGE(TAG, "Failed to create JPEG queue");
-        return "{\"success\": false, \"message\": \"Failed to create JPEG queue\"}";
+    if (!InitializeChunkPool()) {
+        return "{\"success\": false, \"message\": \"Failed to allocate JPEG chunk pool\"}";
     }
 
+    int64_t start_time = esp_timer_get_time();
+    PrepareEncodeParameters(tier.empty() ? upload_tier_ : tier);
+    encode_aborted_ = false;
+    encode_done_time_us_ = 0;
+
     // We spawn a thread to encode the image to JPEG
-    encoder_thread_ = std::thread([this, jpeg_queue]() {
-        frame2jpg_cb(fb_, 80, [](void* arg, size_t index, const void* data, size_t len) -> unsigned int {
-            auto jpeg_queue = (QueueHandle_t)arg;
-            JpegChunk chunk = {
-                .data = (uint8_t*)heap_caps_aligned_alloc(16, len, MALLOC_CAP_SPIRAM),
-                .len = len
-            };
-            memcpy(chunk.data, data, len);
-            xQueueSend(jpeg_queue, &chunk, portMAX_DELAY);
-            return len;
-        }, jpeg_queue);
+    // esp_pthread_set_cfg 作用于调用线程之后创建的所有线程，创建完成后恢复原配置
+    esp_pthread_cfg_t previous_cfg;
+    bool has_previous_cfg = esp_pthread_get_cfg(&previous_cfg) == ESP_OK;
+    esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+    cfg.thread_name = "jpeg_encoder";
+    cfg.prio = CONFIG_CAMERA_ENCODER_TASK_PRIORITY;
+    esp_pthread_set_cfg(&cfg);
+    encoder_thread_ = std::thread([this]() {
+        EncodeToChunks();
     });
+    if (has_previous_cfg) {
+        esp_pthread_set_cfg(&previous_cfg);
+    } else {
+        esp_pthread_cfg_t default_cfg = esp_pthread_get_default_config();
+        esp_pthread_set_cfg(&default_cfg);
+    }
 
     auto network = Board::GetInstance().GetNetwork();
     auto http = network->CreateHttp(3);
@@ -224,19 +577,18 @@ std::string Esp32Camera::Explain(const std::string& question) {
     http->SetHeader("Transfer-Encoding", "chunked");
     if (!http->Open("POST", explain_url_)) {
         ESP_LOGE(TAG, "Failed to connect to explain URL");
-        // Clear the queue
+        // Stop the encoder and return the chunks to the pool
+        encode_aborted_ = true;
+        DrainChunks();
         encoder_thread_.join();
-        JpegChunk chunk;
-        while (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) == pdPASS) {
-            if (chunk.data != nullptr) {
-                heap_caps_free(chunk.data);
-            } else {
-                break;
-            }
-        }
-        vQueueDelete(jpeg_queue);
         return "{\"success\": false, \"message\": \"Failed to connect to explain URL\"}";
     }
+
+    // 上传期间提高发送线程优先级，以便及时归还缓冲区给编码线程；只升不降
+    UBaseType_t original_priority = uxTaskPriorityGet(nullptr);
+    if (CONFIG_CAMERA_UPLOAD_TASK_PRIORITY > original_priority) {
+        vTaskPrioritySet(nullptr, CONFIG_CAMERA_UPLOAD_TASK_PRIORITY);
+    }
     
     {
         // 第一块：question字段
@@ -259,23 +611,36 @@ std::string Esp32Camera::Explain(const std::string& question) {
 
     // 第三块：JPEG数据
     size_t total_sent = 0;
+    int64_t first_byte_time = 0;
+    int64_t first_write_time = 0;
     while (true) {
         JpegChunk chunk;
-        if (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) != pdPASS) {
+        if (xQueueReceive(filled_chunk_queue_, &chunk, portMAX_DELAY) != pdPASS) {
             ESP_LOGE(TAG, "Failed to receive JPEG chunk");
             break;
         }
         if (chunk.data == nullptr) {
             break; // The last chunk
         }
+        if (first_write_time == 0) {
+            first_write_time = esp_timer_get_time();
+        }
         http->Write((const char*)chunk.data, chunk.len);
+        if (first_byte_time == 0) {
+            first_byte_time = esp_timer_get_time();
+        }
         total_sent += chunk.len;
-        heap_caps_free(chunk.data);
+        // Return the buffer to the pool
+        xQueueSend(free_chunk_queue_, &chunk.data, portMAX_DELAY);
     }
     // Wait for the encoder thread to finish
     encoder_thread_.join();
-    // 清理队列
-    vQueueDelete(jpeg_queue);
+
+    // 更新压缩率估计，用于下一次预测
+    if (total_sent > 0) {
+        float bytes_per_pixel = (float)total_sent / (encode_width_ * encode_height_) / GetRelativeJpegSize(encode_quality_);
+        jpeg_bytes_per_pixel_ = (jpeg_bytes_per_pixel_ + bytes_per_pixel) / 2;
+    }
 
     {
         // 第四块：multipart尾部
@@ -285,6 +650,17 @@ std::string Esp32Camera::Explain(const std::string& question) {
     }
     // 结束块
     http->Write("", 0);
+    int64_t upload_done_time = esp_timer_get_time();
+
+    // Write() 只是拷贝进 socket 缓冲区，按第一次写入到最后一次写入返回的总时长计算上行速率，
+    // 并扣除最后可能仍留在 TCP 发送缓冲区中的数据；数据量不超过缓冲区时无法测量
+    if (first_write_time > 0 && total_sent > CAMERA_TCP_SEND_BUFFER_SIZE) {
+        float throughput = (total_sent - CAMERA_TCP_SEND_BUFFER_SIZE) * 1000000.0f / (upload_done_time - first_write_time);
+        uplink_bytes_per_second_ = uplink_bytes_per_second_ > 0 ? (uplink_bytes_per_second_ * 3 + throughput) / 4 : throughput;
+    }
+    if (uxTaskPriorityGet(nullptr) != original_priority) {
+        vTaskPrioritySet(nullptr, original_priority);
+    }
 
     if (http->GetStatusCode() != 200) {
         ESP_LOGE(TAG, "Failed to upload photo, status code: %d", http->GetStatusCode());
@@ -293,10 +669,16 @@ std::string Esp32Camera::Explain(const std::string& question) {
 
     std::string result = http->ReadAll();
     http->Close();
+    int64_t response_time = esp_timer_get_time();
+
+    ESP_LOGI(TAG, "Explain timing: capture=%lldms, encode=%lldms, first_byte=%lldms, upload=%lldms, response=%lldms",
+        capture_duration_us_ / 1000, (encode_done_time_us_ - start_time) / 1000,
+        first_byte_time > 0 ? (first_byte_time - start_time) / 1000 : -1LL,
+        (upload_done_time - start_time) / 1000, (response_time - upload_done_time) / 1000);
 
     // Get remain task stack size
     size_t remain_stack_size = uxTaskGetStackHighWaterMark(nullptr);
     ESP_LOGI(TAG, "Explain image size=%dx%d, compressed size=%d, remain stack size=%d, question=%s\n%s",
-        fb_->width, fb_->height, total_sent, remain_stack_size, question.c_str(), result.c_str());
+        encode_width_, encode_height_, total_sent, remain_stack_size, question.c_str(), result.c_str());
     return result;
 }
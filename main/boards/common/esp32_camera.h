@@ -5,6 +5,7 @@
 #include <lvgl.h>
 #include <thread>
 #include <memory>
+#include <vector>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
@@ -20,10 +21,45 @@ class Esp32Camera : public Camera {
 private:
     camera_fb_t* fb_ = nullptr;
     lv_img_dsc_t preview_image_;
+    // 预览缩放映射表，仅在源图或屏幕尺寸变化时重新计算
+    std::vector<uint16_t> preview_x_map_;
+    std::vector<uint16_t> preview_y_map_;
+    int preview_src_width_ = 0;
+    int preview_src_height_ = 0;
+    int preview_display_width_ = 0;
+    int preview_display_height_ = 0;
     std::string explain_url_;
     std::string explain_token_;
     std::thread encoder_thread_;
 
+    // JPEG 分块缓冲池：编码线程直接写入，上传线程直接发送，避免每个分块 malloc/free
+    std::vector<uint8_t*> chunk_pool_;
+    QueueHandle_t free_chunk_queue_ = nullptr;
+    QueueHandle_t filled_chunk_queue_ = nullptr;
+    volatile bool encode_aborted_ = false;
+
+    // 上传前缩放与自适应质量，upload_tier_ 为服务器下发的默认档位
+    std::string upload_tier_ = "auto";
+    uint8_t* scaled_frame_ = nullptr;
+    size_t scaled_frame_size_ = 0;
+    int encode_width_ = 0;
+    int encode_height_ = 0;
+    int encode_quality_ = CONFIG_CAMERA_JPEG_QUALITY;
+    float uplink_bytes_per_second_ = 0;
+    float jpeg_bytes_per_pixel_ = 0.2f; // 质量 80 时每像素的 JPEG 字节数估计
+
+    // 各阶段耗时统计 (us)
+    int64_t capture_duration_us_ = 0;
+    int64_t encode_done_time_us_ = 0;
+
+    bool PreparePreview(int display_width, int display_height);
+    void ConvertPreview();
+    bool InitializeChunkPool();
+    void PrepareEncodeParameters(const std::string& tier);
+    bool DownscaleFrame(int factor);
+    void EncodeToChunks();
+    void DrainChunks();
+
 public:
     Esp32Camera(const camera_config_t& config);
     ~Esp32Camera();
@@ -33,7 +69,8 @@ public:
     // 翻转控制函数
     virtual bool SetHMirror(bool enabled) override;
     virtual bool SetVFlip(bool enabled) override;
-    virtual std::string Explain(const std::string& question);
+    virtual std::string Explain(const std::string& question, const std::string& tier) override;
+    virtual void SetUploadTier(const std::string& tier) override;
 };
 
 #endif // ESP32_CAMERA_H
\ No newline at end of file
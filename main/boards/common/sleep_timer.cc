@@ -87,8 +87,8 @@ void SleepTimer::CheckTimer() {
         
             app.Schedule([this, &app]() {
                 while (in_light_sleep_mode_) {
-                    auto& board = Board::GetInstance();
-                    board.GetDisplay()->UpdateStatusBar(true);
+                    app.GetStatusService()->Update(true);
+                    app.GetDisplayQueue()->Flush();
                     lv_refr_now(nullptr);
                     lvgl_port_stop();
     
@@ -118,6 +118,8 @@ void SleepTimer::CheckTimer() {
             on_enter_deep_sleep_mode_();
         }
 
+        // 深度睡眠不会调用 shutdown handler，需要手动提交设置
+        Settings::Flush();
         esp_deep_sleep_start();
     }
 }
@@ -89,21 +89,21 @@ void WifiBoard::StartNetwork() {
 
     auto& wifi_station = WifiStation::GetInstance();
     wifi_station.OnScanBegin([this]() {
-        auto display = Board::GetInstance().GetDisplay();
-        display->ShowNotification(Lang::Strings::SCANNING_WIFI, 30000);
+        auto display_queue = Application::GetInstance().GetDisplayQueue();
+        display_queue->ShowNotification(Lang::Strings::SCANNING_WIFI, 30000);
     });
     wifi_station.OnConnect([this](const std::string& ssid) {
-        auto display = Board::GetInstance().GetDisplay();
+        auto display_queue = Application::GetInstance().GetDisplayQueue();
         std::string notification = Lang::Strings::CONNECT_TO;
         notification += ssid;
         notification += "...";
-        display->ShowNotification(notification.c_str(), 30000);
+        display_queue->ShowNotification(notification, 30000);
     });
     wifi_station.OnConnected([this](const std::string& ssid) {
-        auto display = Board::GetInstance().GetDisplay();
+        auto display_queue = Application::GetInstance().GetDisplayQueue();
         std::string notification = Lang::Strings::CONNECTED_TO;
         notification += ssid;
-        display->ShowNotification(notification.c_str(), 30000);
+        display_queue->ShowNotification(notification, 30000);
     });
     wifi_station.Start();
 
@@ -167,7 +167,13 @@ void WifiBoard::ResetWifiConfiguration() {
         Settings settings("wifi", true);
         settings.SetInt("force_ap", 1);
     }
-    GetDisplay()->ShowNotification(Lang::Strings::ENTERING_WIFI_CONFIG_MODE);
+    // May be triggered by a button before Application::Start has created the display queue
+    auto display_queue = Application::GetInstance().GetDisplayQueue();
+    if (display_queue != nullptr) {
+        display_queue->ShowNotification(Lang::Strings::ENTERING_WIFI_CONFIG_MODE);
+    } else {
+        GetDisplay()->ShowNotification(Lang::Strings::ENTERING_WIFI_CONFIG_MODE);
+    }
     vTaskDelay(pdMS_TO_TICKS(1000));
     // Reboot the device
     esp_restart();
@@ -1,6 +1,7 @@
 #include "sscma_camera.h"
 #include "mcp_server.h"
 #include "display.h"
+#include "application.h"
 #include "board.h"
 #include "system_info.h"
 #include "config.h"
@@ -243,10 +244,7 @@ bool SscmaCamera::Capture() {
     }
 
     // 显示预览图片
-    auto display = Board::GetInstance().GetDisplay();
-    if (display != nullptr) {
-        display->SetPreviewImage(&preview_image_);
-    }
+    Application::GetInstance().GetDisplayQueue()->SetPreviewImage(&preview_image_);
     return true;
 }
 bool SscmaCamera::SetHMirror(bool enabled) {
@@ -274,7 +272,7 @@ bool SscmaCamera::SetVFlip(bool enabled) {
  * @note 函数会等待之前的编码线程完成后再开始新的处理
  * @warning 如果摄像头缓冲区为空或网络连接失败，将返回错误信息
  */
-std::string SscmaCamera::Explain(const std::string& question) {
+std::string SscmaCamera::Explain(const std::string& question, const std::string& tier) {
     if (explain_url_.empty()) {
         return "{\"success\": false, \"message\": \"Image explain URL or token is not set\"}";
     }
@@ -0,0 +1,77 @@
+#include "boot_sequence.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/task.h>
+
+#include <cassert>
+#include <utility>
+
+#define TAG "BootSequence"
+
+// EventGroup 的高 8 位保留给内核
+#define MAX_BOOT_STEPS 24
+
+BootSequence::BootSequence() {
+    event_group_ = xEventGroupCreate();
+}
+
+BootSequence::~BootSequence() {
+    vEventGroupDelete(event_group_);
+}
+
+int BootSequence::AddStep(const char* name, std::function<void()> function,
+    std::initializer_list<int> dependencies, uint32_t stack_size) {
+    assert(steps_.size() < MAX_BOOT_STEPS);
+    EventBits_t bits = 0;
+    for (int dependency : dependencies) {
+        assert(dependency >= 0 && dependency < (int)steps_.size());
+        bits |= 1 << dependency;
+    }
+    steps_.push_back({name, function, bits, stack_size, 0, 0});
+    return steps_.size() - 1;
+}
+
+void BootSequence::Run() {
+    start_time_ = esp_timer_get_time();
+    EventBits_t all_bits = 0;
+    for (int i = 0; i < (int)steps_.size(); i++) {
+        all_bits |= 1 << i;
+        auto arg = new std::pair<BootSequence*, int>(this, i);
+        BaseType_t ret = xTaskCreate([](void* arg) {
+            auto pair = (std::pair<BootSequence*, int>*)arg;
+            pair->first->RunStep(pair->second);
+            delete pair;
+            vTaskDelete(NULL);
+        }, steps_[i].name, steps_[i].stack_size, arg, uxTaskPriorityGet(NULL), nullptr);
+        if (ret != pdPASS) {
+            // 依赖只能是前面的步骤，已经有任务在执行，直接在当前任务中运行不会死锁
+            ESP_LOGW(TAG, "Failed to create task for step %s, running it inline", steps_[i].name);
+            delete arg;
+            RunStep(i);
+        }
+    }
+    xEventGroupWaitBits(event_group_, all_bits, pdFALSE, pdTRUE, portMAX_DELAY);
+
+    // 时间均相对于本次 Run()，最后一行是上电到可用的总时间
+    for (auto& step : steps_) {
+        ESP_LOGI(TAG, "%-10s +%5lld ms  %5lld ms", step.name,
+            (step.start_us - start_time_) / 1000, (step.end_us - step.start_us) / 1000);
+    }
+    auto now = esp_timer_get_time();
+    ESP_LOGI(TAG, "Boot steps finished in %lld ms, ready %lld ms after power on",
+        (now - start_time_) / 1000, now / 1000);
+}
+
+void BootSequence::RunStep(int index) {
+    auto& step = steps_[index];
+    if (step.dependencies != 0) {
+        xEventGroupWaitBits(event_group_, step.dependencies, pdFALSE, pdTRUE, portMAX_DELAY);
+    }
+    step.start_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "Step %s started at +%lld ms", step.name, (step.start_us - start_time_) / 1000);
+    step.function();
+    step.end_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "Step %s done in %lld ms", step.name, (step.end_us - step.start_us) / 1000);
+    xEventGroupSetBits(event_group_, 1 << index);
+}
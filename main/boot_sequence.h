@@ -0,0 +1,47 @@
+#ifndef _BOOT_SEQUENCE_H_
+#define _BOOT_SEQUENCE_H_
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+#include <functional>
+#include <initializer_list>
+#include <vector>
+
+/*
+ * Boot steps with dependencies
+ *
+ * Every step runs in its own task as soon as all of its dependencies have finished, so
+ * independent steps (audio / model loading and network bring-up) overlap. Run() blocks
+ * until every step is done and logs when each step started and how long it took. A step
+ * whose task cannot be created runs inline in the caller of Run().
+ */
+
+class BootSequence {
+public:
+    BootSequence();
+    ~BootSequence();
+
+    // 返回步骤编号，供后续步骤声明依赖
+    int AddStep(const char* name, std::function<void()> function,
+        std::initializer_list<int> dependencies = {}, uint32_t stack_size = 4096);
+    void Run();
+
+private:
+    struct Step {
+        const char* name;
+        std::function<void()> function;
+        EventBits_t dependencies;
+        uint32_t stack_size;
+        int64_t start_us;
+        int64_t end_us;
+    };
+
+    std::vector<Step> steps_;
+    EventGroupHandle_t event_group_ = nullptr;
+    int64_t start_time_ = 0;
+
+    void RunStep(int index);
+};
+
+#endif // _BOOT_SEQUENCE_H_
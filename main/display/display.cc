@@ -3,6 +3,7 @@
 #include <string>
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
 
 #include "display.h"
 #include "board.h"
@@ -30,13 +31,21 @@ Display::Display() {
     };
     ESP_ERROR_CHECK(esp_timer_create(&notification_timer_args, &notification_timer_));
 
-    // Create a power management lock
-    auto ret = esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "display_update", &pm_lock_);
-    if (ret == ESP_ERR_NOT_SUPPORTED) {
-        ESP_LOGI(TAG, "Power management not supported");
-    } else {
-        ESP_ERROR_CHECK(ret);
-    }
+    // Clock timer, started whenever the status text changes
+    esp_timer_create_args_t clock_timer_args = {
+        .callback = [](void *arg) {
+            // 不在 esp_timer 任务中等待显示锁，交给显示队列的 UI 任务处理
+            auto display_queue = Application::GetInstance().GetDisplayQueue();
+            if (display_queue != nullptr) {
+                display_queue->ShowIdleClock();
+            }
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "status_clock_timer",
+        .skip_unhandled_events = false,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&clock_timer_args, &clock_timer_));
 }
 
 Display::~Display() {
@@ -44,6 +53,10 @@ Display::~Display() {
         esp_timer_stop(notification_timer_);
         esp_timer_delete(notification_timer_);
     }
+    if (clock_timer_ != nullptr) {
+        esp_timer_stop(clock_timer_);
+        esp_timer_delete(clock_timer_);
+    }
 
     if (network_label_ != nullptr) {
         lv_obj_del(network_label_);
@@ -56,9 +69,35 @@ Display::~Display() {
     if( low_battery_popup_ != nullptr ) {
         lv_obj_del(low_battery_popup_);
     }
-    if (pm_lock_ != nullptr) {
-        esp_pm_lock_delete(pm_lock_);
+}
+
+void Display::SetupFlushTracking(int bits_per_pixel) {
+    flush_bits_per_pixel_ = bits_per_pixel;
+
+    // 统计每次刷新写到总线上的字节数，速率由调用方按统计间隔计算
+    lv_display_add_event_cb(display_, [](lv_event_t* e) {
+        auto display = static_cast<Display*>(lv_event_get_user_data(e));
+        auto area = static_cast<const lv_area_t*>(lv_event_get_param(e));
+        display->flush_count_++;
+        display->flush_total_bytes_ += lv_area_get_size(area) * display->flush_bits_per_pixel_ / 8;
+    }, LV_EVENT_FLUSH_START, this);
+}
+
+DisplayFlushStatistics Display::GetFlushStatistics() const {
+    DisplayFlushStatistics statistics;
+    statistics.flush_count = flush_count_;
+    statistics.total_bytes = flush_total_bytes_;
+    return statistics;
+}
+
+// 文本没有变化时不重设，避免标签区域被重新标脏并刷新到屏幕
+bool Display::SetLabelText(lv_obj_t* label, const char* text) {
+    const char* current = lv_label_get_text(label);
+    if (current != nullptr && strcmp(current, text) == 0) {
+        return false;
     }
+    lv_label_set_text(label, text);
+    return true;
 }
 
 void Display::SetStatus(const char* status) {
@@ -66,11 +105,32 @@ void Display::SetStatus(const char* status) {
     if (status_label_ == nullptr) {
         return;
     }
-    lv_label_set_text(status_label_, status);
+    SetLabelText(status_label_, status);
     lv_obj_clear_flag(status_label_, LV_OBJ_FLAG_HIDDEN);
     lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
 
-    last_status_update_time_ = std::chrono::system_clock::now();
+    clock_shown_ = false;
+    esp_timer_stop(clock_timer_);
+    esp_timer_start_once(clock_timer_, 10 * 1000000);
+}
+
+void Display::ShowClock() {
+    if (status_label_ == nullptr || clock_text_.empty()) {
+        return;
+    }
+    SetLabelText(status_label_, clock_text_.c_str());
+    lv_obj_clear_flag(status_label_, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
+    clock_shown_ = true;
+}
+
+void Display::ShowIdleClock() {
+    DisplayLockGuard lock(this);
+    // 定时器触发后又有新的状态文字时，定时器已被重新启动
+    if (esp_timer_is_active(clock_timer_) || Application::GetInstance().GetDeviceState() != kDeviceStateIdle) {
+        return;
+    }
+    ShowClock();
 }
 
 void Display::ShowNotification(const std::string &notification, int duration_ms) {
@@ -90,110 +150,46 @@ void Display::ShowNotification(const char* notification, int duration_ms) {
     ESP_ERROR_CHECK(esp_timer_start_once(notification_timer_, duration_ms * 1000));
 }
 
-void Display::UpdateStatusBar(bool update_all) {
-    auto& app = Application::GetInstance();
-    auto& board = Board::GetInstance();
-    auto codec = board.GetAudioCodec();
-
-    // Update mute icon
-    {
-        DisplayLockGuard lock(this);
-        if (mute_label_ == nullptr) {
-            return;
-        }
-
-        // 如果静音状态改变，则更新图标
-        if (codec->output_volume() == 0 && !muted_) {
-            muted_ = true;
-            lv_label_set_text(mute_label_, FONT_AWESOME_VOLUME_MUTE);
-        } else if (codec->output_volume() > 0 && muted_) {
-            muted_ = false;
-            lv_label_set_text(mute_label_, "");
-        }
+void Display::SetMuted(bool muted) {
+    DisplayLockGuard lock(this);
+    if (mute_label_ == nullptr) {
+        return;
     }
+    lv_label_set_text(mute_label_, muted ? FONT_AWESOME_VOLUME_MUTE : "");
+}
 
-    // Update time
-    if (app.GetDeviceState() == kDeviceStateIdle) {
-        if (last_status_update_time_ + std::chrono::seconds(10) < std::chrono::system_clock::now()) {
-            // Set status to clock "HH:MM"
-            time_t now = time(NULL);
-            struct tm* tm = localtime(&now);
-            // Check if the we have already set the time
-            if (tm->tm_year >= 2025 - 1900) {
-                char time_str[16];
-                strftime(time_str, sizeof(time_str), "%H:%M  ", tm);
-                SetStatus(time_str);
-            } else {
-                ESP_LOGW(TAG, "System time is not set, tm_year: %d", tm->tm_year);
-            }
-        }
+void Display::SetBatteryIcon(const char* icon, bool low_battery) {
+    DisplayLockGuard lock(this);
+    if (battery_label_ != nullptr) {
+        lv_label_set_text(battery_label_, icon);
     }
 
-    esp_pm_lock_acquire(pm_lock_);
-    // 更新电池图标
-    int battery_level;
-    bool charging, discharging;
-    const char* icon = nullptr;
-    if (board.GetBatteryLevel(battery_level, charging, discharging)) {
-        if (charging) {
-            icon = FONT_AWESOME_BATTERY_CHARGING;
+    if (low_battery_popup_ != nullptr) {
+        if (low_battery) {
+            lv_obj_clear_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
         } else {
-            const char* levels[] = {
-                FONT_AWESOME_BATTERY_EMPTY, // 0-19%
-                FONT_AWESOME_BATTERY_1,    // 20-39%
-                FONT_AWESOME_BATTERY_2,    // 40-59%
-                FONT_AWESOME_BATTERY_3,    // 60-79%
-                FONT_AWESOME_BATTERY_FULL, // 80-99%
-                FONT_AWESOME_BATTERY_FULL, // 100%
-            };
-            icon = levels[battery_level / 20];
-        }
-        DisplayLockGuard lock(this);
-        if (battery_label_ != nullptr && battery_icon_ != icon) {
-            battery_icon_ = icon;
-            lv_label_set_text(battery_label_, battery_icon_);
-        }
-
-        if (low_battery_popup_ != nullptr) {
-            if (strcmp(icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && discharging) {
-                if (lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // 如果低电量提示框隐藏，则显示
-                    lv_obj_clear_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
-                    app.PlaySound(Lang::Sounds::P3_LOW_BATTERY);
-                }
-            } else {
-                // Hide the low battery popup when the battery is not empty
-                if (!lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // 如果低电量提示框显示，则隐藏
-                    lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
-                }
-            }
+            lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
         }
     }
+}
 
-    // 每 10 秒更新一次网络图标
-    static int seconds_counter = 0;
-    if (update_all || seconds_counter++ % 10 == 0) {
-        // 升级固件时，不读取 4G 网络状态，避免占用 UART 资源
-        auto device_state = Application::GetInstance().GetDeviceState();
-        static const std::vector<DeviceState> allowed_states = {
-            kDeviceStateIdle,
-            kDeviceStateStarting,
-            kDeviceStateWifiConfiguring,
-            kDeviceStateListening,
-            kDeviceStateActivating,
-        };
-        if (std::find(allowed_states.begin(), allowed_states.end(), device_state) != allowed_states.end()) {
-            icon = board.GetNetworkStateIcon();
-            if (network_label_ != nullptr && icon != nullptr && network_icon_ != icon) {
-                DisplayLockGuard lock(this);
-                network_icon_ = icon;
-                lv_label_set_text(network_label_, network_icon_);
-            }
-        }
+void Display::SetNetworkIcon(const char* icon) {
+    DisplayLockGuard lock(this);
+    if (network_label_ == nullptr) {
+        return;
     }
-
-    esp_pm_lock_release(pm_lock_);
+    lv_label_set_text(network_label_, icon);
 }
 
+void Display::SetClock(const char* clock) {
+    DisplayLockGuard lock(this);
+    clock_text_ = clock;
+    // 时钟已经显示，或者状态文字已超时但此前时间尚未同步
+    if (clock_shown_ || (!esp_timer_is_active(clock_timer_) &&
+        Application::GetInstance().GetDeviceState() == kDeviceStateIdle)) {
+        ShowClock();
+    }
+}
 
 void Display::SetEmotion(const char* emotion) {
     struct Emotion {
@@ -237,9 +233,9 @@ void Display::SetEmotion(const char* emotion) {
 
     // 如果找到匹配的表情就显示对应图标，否则显示默认的neutral表情
     if (it != emotions.end()) {
-        lv_label_set_text(emotion_label_, it->icon);
+        SetLabelText(emotion_label_, it->icon);
     } else {
-        lv_label_set_text(emotion_label_, FONT_AWESOME_EMOJI_NEUTRAL);
+        SetLabelText(emotion_label_, FONT_AWESOME_EMOJI_NEUTRAL);
     }
 }
 
@@ -248,13 +244,18 @@ void Display::SetIcon(const char* icon) {
     if (emotion_label_ == nullptr) {
         return;
     }
-    lv_label_set_text(emotion_label_, icon);
+    SetLabelText(emotion_label_, icon);
 }
 
 void Display::SetPreviewImage(const lv_img_dsc_t* image) {
     // Do nothing
 }
 
+void Display::GetPreviewImageSize(int& width, int& height) {
+    width = width_;
+    height = height_;
+}
+
 void Display::SetChatMessage(const char* role, const char* content) {
     DisplayLockGuard lock(this);
     if (chat_message_label_ == nullptr) {
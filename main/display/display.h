@@ -4,10 +4,10 @@
 #include <lvgl.h>
 #include <esp_timer.h>
 #include <esp_log.h>
-#include <esp_pm.h>
 
 #include <string>
 #include <chrono>
+#include <atomic>
 
 struct DisplayFonts {
     const lv_font_t* text_font = nullptr;
@@ -15,6 +15,11 @@ struct DisplayFonts {
     const lv_font_t* emoji_font = nullptr;
 };
 
+struct DisplayFlushStatistics {
+    uint32_t flush_count = 0;
+    uint32_t total_bytes = 0;
+};
+
 class Display {
 public:
     Display();
@@ -27,19 +32,26 @@ public:
     virtual void SetChatMessage(const char* role, const char* content);
     virtual void SetIcon(const char* icon);
     virtual void SetPreviewImage(const lv_img_dsc_t* image);
+    // 预览图实际显示区域的大小，调用者按此尺寸生成图片，显示时不再缩放
+    virtual void GetPreviewImageSize(int& width, int& height);
     virtual void SetTheme(const std::string& theme_name);
     virtual std::string GetTheme() { return current_theme_name_; }
-    virtual void UpdateStatusBar(bool update_all = false);
+    virtual void SetMuted(bool muted);
+    virtual void SetBatteryIcon(const char* icon, bool low_battery);
+    virtual void SetNetworkIcon(const char* icon);
+    virtual void SetClock(const char* clock);
+    // 状态文字超时且处于待命状态时显示时钟
+    void ShowIdleClock();
     virtual void SetPowerSaveMode(bool on);
 
     inline int width() const { return width_; }
     inline int height() const { return height_; }
+    DisplayFlushStatistics GetFlushStatistics() const;
 
 protected:
     int width_ = 0;
     int height_ = 0;
-    
-    esp_pm_lock_handle_t pm_lock_ = nullptr;
+
     lv_display_t *display_ = nullptr;
 
     lv_obj_t *emotion_label_ = nullptr;
@@ -52,14 +64,23 @@ protected:
     lv_obj_t* low_battery_popup_ = nullptr;
     lv_obj_t* low_battery_label_ = nullptr;
     
-    const char* battery_icon_ = nullptr;
-    const char* network_icon_ = nullptr;
-    bool muted_ = false;
     std::string current_theme_name_;
 
-    std::chrono::system_clock::time_point last_status_update_time_;
+    // 状态文字 10 秒未更新且处于待命状态时，状态栏显示时钟
+    std::string clock_text_;
+    bool clock_shown_ = false;
+    esp_timer_handle_t clock_timer_ = nullptr;
     esp_timer_handle_t notification_timer_ = nullptr;
 
+    // 总线流量统计
+    int flush_bits_per_pixel_ = 16;
+    std::atomic<uint32_t> flush_count_ = 0;
+    std::atomic<uint32_t> flush_total_bytes_ = 0;
+
+    void SetupFlushTracking(int bits_per_pixel);
+    bool SetLabelText(lv_obj_t* label, const char* text);
+    void ShowClock();
+
     friend class DisplayLockGuard;
     virtual bool Lock(int timeout_ms = 0) = 0;
     virtual void Unlock() = 0;
@@ -0,0 +1,129 @@
+#include "display_benchmark.h"
+#include "font_awesome_symbols.h"
+#include "assets/lang_config.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <esp_rom_crc.h>
+#include <mbedtls/base64.h>
+#include <cstdio>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#define TAG "DisplayBenchmark"
+
+// 每行输出的截图数据，base64 编码后 512 字符
+#define SCREENSHOT_CHUNK_SIZE 384
+
+struct BenchmarkStep {
+    const char* name;
+    std::function<void(Display*)> action;
+};
+
+#if CONFIG_DISPLAY_BENCHMARK_SCREENSHOTS
+// 以 "DBF <step> <width> <height> <stride> <index>/<count> <base64>" 行输出 RGB565 截图，
+// 由 scripts/display_benchmark.py 拼回 PNG
+static void DumpScreenshot(const char* step, const lv_draw_buf_t* snapshot) {
+    size_t size = snapshot->data_size;
+    int count = (size + SCREENSHOT_CHUNK_SIZE - 1) / SCREENSHOT_CHUNK_SIZE;
+    unsigned char line[SCREENSHOT_CHUNK_SIZE / 3 * 4 + 1];
+    for (int i = 0; i < count; i++) {
+        size_t offset = i * SCREENSHOT_CHUNK_SIZE;
+        size_t length = std::min<size_t>(SCREENSHOT_CHUNK_SIZE, size - offset);
+        size_t written = 0;
+        mbedtls_base64_encode(line, sizeof(line), &written, snapshot->data + offset, length);
+        printf("DBF %s %lu %lu %lu %d/%d %.*s\n", step, (unsigned long)snapshot->header.w,
+            (unsigned long)snapshot->header.h, (unsigned long)snapshot->header.stride, i, count, (int)written, line);
+    }
+}
+#endif
+
+// 屏幕内容的校验值，用于对比不同版本的渲染结果；快照失败时返回 0
+static uint32_t CaptureScreen(const char* step) {
+    lv_draw_buf_t* snapshot = lv_snapshot_take(lv_screen_active(), LV_COLOR_FORMAT_RGB565);
+    if (snapshot == nullptr) {
+        ESP_LOGE(TAG, "Failed to take a snapshot of step %s", step);
+        return 0;
+    }
+    uint32_t crc = esp_rom_crc32_le(0, snapshot->data, snapshot->data_size);
+#if CONFIG_DISPLAY_BENCHMARK_SCREENSHOTS
+    DumpScreenshot(step, snapshot);
+#endif
+    lv_draw_buf_destroy(snapshot);
+    return crc;
+}
+
+void DisplayBenchmark::Run() {
+    const std::vector<BenchmarkStep> steps = {
+        {"standby", [](Display* d) { d->SetStatus(Lang::Strings::STANDBY); d->SetEmotion("neutral"); }},
+        {"connecting", [](Display* d) { d->SetStatus(Lang::Strings::CONNECTING); }},
+        {"listening", [](Display* d) { d->SetStatus(Lang::Strings::LISTENING); d->SetEmotion("neutral"); }},
+        {"user_message", [](Display* d) { d->SetChatMessage("user", "今天天气怎么样？"); }},
+        {"speaking", [](Display* d) { d->SetStatus(Lang::Strings::SPEAKING); d->SetEmotion("happy"); }},
+        {"assistant_message", [](Display* d) {
+            d->SetChatMessage("assistant", "今天是晴天，最高气温二十六度，最低气温十八度，东南风三级，适合出门散步。");
+        }},
+        {"assistant_short", [](Display* d) { d->SetChatMessage("assistant", "OK"); }},
+        {"emotion_thinking", [](Display* d) { d->SetEmotion("thinking"); }},
+        {"emotion_same", [](Display* d) { d->SetEmotion("thinking"); }},
+        {"notification", [](Display* d) { d->ShowNotification(Lang::Strings::CONNECTED_TO, 3000); }},
+        {"system_message", [](Display* d) { d->SetChatMessage("system", Lang::Strings::SERVER_TIMEOUT); }},
+        {"system_collapsed", [](Display* d) { d->SetChatMessage("system", Lang::Strings::SERVER_ERROR); }},
+        {"icon", [](Display* d) { d->SetIcon(FONT_AWESOME_DOWNLOAD); }},
+        {"status_same", [](Display* d) { d->SetStatus(Lang::Strings::STANDBY); d->SetStatus(Lang::Strings::STANDBY); }},
+        {"theme_dark", [](Display* d) { d->SetTheme("dark"); }},
+        {"theme_light", [](Display* d) { d->SetTheme("light"); }},
+        {"idle", [](Display* d) { }},
+    };
+
+    std::string theme = display_->GetTheme();
+    size_t start_internal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t start_spiram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    int font_height = 0;
+    {
+        DisplayLockGuard lock(display_);
+        const lv_font_t* font = lv_obj_get_style_text_font(lv_screen_active(), LV_PART_MAIN);
+        if (font != nullptr) {
+            font_height = lv_font_get_line_height(font);
+        }
+    }
+    // 参考数据按这一行区分：板子、构建名、分辨率、字体行高、语言和主题
+    ESP_LOGI(TAG, "Benchmark board=%s name=%s size=%dx%d font=%d lang=%s theme=%s steps=%u", BOARD_TYPE, BOARD_NAME,
+        display_->width(), display_->height(), font_height, Lang::CODE, theme.c_str(), steps.size());
+    ESP_LOGI(TAG, "%-20s %10s %10s %8s %10s %10s %10s", "step", "apply_us", "render_us", "flushes", "bytes",
+        "internal", "spiram");
+
+    int64_t total_render_time = 0;
+    for (const auto& step : steps) {
+        DisplayLockGuard lock(display_);
+        // 先把之前的改动刷新掉，只统计这一步引起的重绘
+        lv_refr_now(nullptr);
+        auto before = display_->GetFlushStatistics();
+
+        int64_t start_time = esp_timer_get_time();
+        step.action(display_);
+        int64_t apply_time = esp_timer_get_time() - start_time;
+        lv_refr_now(nullptr);
+        int64_t render_time = esp_timer_get_time() - start_time - apply_time;
+        total_render_time += render_time;
+
+        auto after = display_->GetFlushStatistics();
+        size_t free_internal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+        size_t free_spiram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+        uint32_t crc = CaptureScreen(step.name);
+        ESP_LOGI(TAG, "%-20s %10lld %10lld %8lu %10lu %10u %10u crc=%08lx", step.name, apply_time, render_time,
+            after.flush_count - before.flush_count, after.total_bytes - before.total_bytes,
+            free_internal, free_spiram, crc);
+    }
+
+    // 恢复原来的界面状态
+    display_->SetTheme(theme);
+    display_->SetChatMessage("system", "");
+    display_->SetEmotion("neutral");
+
+    ESP_LOGI(TAG, "Total render time: %lldus, internal heap delta: %d, spiram delta: %d", total_render_time,
+        (int)(start_internal - heap_caps_get_free_size(MALLOC_CAP_INTERNAL)),
+        (int)(start_spiram - heap_caps_get_free_size(MALLOC_CAP_SPIRAM)));
+}
@@ -0,0 +1,29 @@
+#ifndef DISPLAY_BENCHMARK_H
+#define DISPLAY_BENCHMARK_H
+
+#include "display.h"
+
+/*
+ * Display benchmark
+ *
+ * Replays a fixed UI scenario (state changes, chat messages, emotions, notifications,
+ * theme switches) on the real display, forcing a refresh after every step, and logs the
+ * render time, flushed area and heap use of each step together with a CRC of the
+ * rendered screen. With CONFIG_DISPLAY_BENCHMARK_SCREENSHOTS every step is also dumped
+ * to the console.
+ *
+ * There is no host build of the display classes, so this runs on the device: one run
+ * covers the resolution, font and language of that board build, and the builds listed
+ * in each board's config.json cover the rest. scripts/display_benchmark.py turns the log
+ * into a reference (CRCs and PNG screenshots) and checks later runs against it.
+ */
+class DisplayBenchmark {
+public:
+    DisplayBenchmark(Display* display) : display_(display) {}
+    void Run();
+
+private:
+    Display* display_;
+};
+
+#endif // DISPLAY_BENCHMARK_H
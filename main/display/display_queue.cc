@@ -0,0 +1,199 @@
+#include "display_queue.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+
+#define TAG "DisplayQueue"
+
+// Apply at most one batch per LVGL refresh period, so bursts of updates are merged
+#define DISPLAY_QUEUE_FRAME_INTERVAL_MS 33
+
+// The WeChat style chat message creates a bubble and forces a flex layout plus scroll,
+// which recurses through the message container; 4 KB left too little headroom there.
+// The free stack is reported in the statistics, check it before trimming this value.
+#define DISPLAY_QUEUE_TASK_STACK_SIZE (4096 + 2048)
+
+DisplayQueue::DisplayQueue(Display* display) : display_(display) {
+    xTaskCreate([](void* arg) {
+        DisplayQueue* queue = (DisplayQueue*)arg;
+        queue->UiTask();
+        vTaskDelete(NULL);
+    }, "display_ui", DISPLAY_QUEUE_TASK_STACK_SIZE, this, 1, &ui_task_handle_);
+}
+
+DisplayQueue::~DisplayQueue() {
+    if (ui_task_handle_ != nullptr) {
+        vTaskDelete(ui_task_handle_);
+    }
+}
+
+void DisplayQueue::SetStatus(const char* status) {
+    Post(DisplayCommand{kDisplayCommandStatus, "", status});
+}
+
+void DisplayQueue::ShowNotification(const char* notification, int duration_ms) {
+    Post(DisplayCommand{kDisplayCommandNotification, "", notification, duration_ms});
+}
+
+void DisplayQueue::ShowNotification(const std::string& notification, int duration_ms) {
+    ShowNotification(notification.c_str(), duration_ms);
+}
+
+void DisplayQueue::SetEmotion(const char* emotion) {
+    Post(DisplayCommand{kDisplayCommandEmotion, "", emotion});
+}
+
+void DisplayQueue::SetIcon(const char* icon) {
+    Post(DisplayCommand{kDisplayCommandIcon, "", icon});
+}
+
+void DisplayQueue::SetChatMessage(const char* role, const char* content) {
+    Post(DisplayCommand{kDisplayCommandChatMessage, role, content});
+}
+
+void DisplayQueue::SetTheme(const std::string& theme_name) {
+    Post(DisplayCommand{kDisplayCommandTheme, "", theme_name});
+}
+
+void DisplayQueue::SetPreviewImage(const lv_img_dsc_t* image) {
+    Post(DisplayCommand{kDisplayCommandPreviewImage, "", "", 0, image});
+}
+
+void DisplayQueue::SetMuted(bool muted) {
+    Post(DisplayCommand{kDisplayCommandMuted, "", "", 0, nullptr, muted});
+}
+
+void DisplayQueue::SetBatteryIcon(const char* icon, bool low_battery) {
+    Post(DisplayCommand{kDisplayCommandBatteryIcon, "", icon, 0, nullptr, low_battery});
+}
+
+void DisplayQueue::SetNetworkIcon(const char* icon) {
+    Post(DisplayCommand{kDisplayCommandNetworkIcon, "", icon});
+}
+
+void DisplayQueue::SetClock(const char* clock) {
+    Post(DisplayCommand{kDisplayCommandClock, "", clock});
+}
+
+void DisplayQueue::ShowIdleClock() {
+    Post(DisplayCommand{kDisplayCommandIdleClock});
+}
+
+void DisplayQueue::Flush() {
+    ApplyPending();
+}
+
+DisplayQueueStatistics DisplayQueue::GetStatistics() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto statistics = statistics_;
+    if (ui_task_handle_ != nullptr) {
+        statistics.stack_free_bytes = uxTaskGetStackHighWaterMark(ui_task_handle_) * sizeof(StackType_t);
+    }
+    return statistics;
+}
+
+void DisplayQueue::Post(DisplayCommand&& command) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        statistics_.posted_count++;
+
+        // Drop the pending commands that would be overwritten by this one
+        auto replaces = [&command](const DisplayCommand& pending) {
+            switch (command.type) {
+                case kDisplayCommandEmotion:
+                case kDisplayCommandIcon:
+                    // Emotion and icon share the same label
+                    return pending.type == kDisplayCommandEmotion || pending.type == kDisplayCommandIcon;
+                case kDisplayCommandChatMessage:
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+                    // Every message is a new bubble
+                    return false;
+#else
+                    return pending.type == kDisplayCommandChatMessage;
+#endif
+                default:
+                    return pending.type == command.type;
+            }
+        };
+        auto it = std::remove_if(commands_.begin(), commands_.end(), replaces);
+        statistics_.coalesced_count += std::distance(it, commands_.end());
+        commands_.erase(it, commands_.end());
+        commands_.push_back(std::move(command));
+    }
+    xTaskNotifyGive(ui_task_handle_);
+}
+
+void DisplayQueue::Apply(const DisplayCommand& command) {
+    switch (command.type) {
+        case kDisplayCommandStatus:
+            display_->SetStatus(command.text.c_str());
+            break;
+        case kDisplayCommandNotification:
+            display_->ShowNotification(command.text.c_str(), command.duration_ms);
+            break;
+        case kDisplayCommandEmotion:
+            display_->SetEmotion(command.text.c_str());
+            break;
+        case kDisplayCommandIcon:
+            display_->SetIcon(command.text.c_str());
+            break;
+        case kDisplayCommandChatMessage:
+            display_->SetChatMessage(command.role.c_str(), command.text.c_str());
+            break;
+        case kDisplayCommandTheme:
+            display_->SetTheme(command.text);
+            break;
+        case kDisplayCommandPreviewImage:
+            display_->SetPreviewImage(command.image);
+            break;
+        case kDisplayCommandMuted:
+            display_->SetMuted(command.flag);
+            break;
+        case kDisplayCommandBatteryIcon:
+            display_->SetBatteryIcon(command.text.c_str(), command.flag);
+            break;
+        case kDisplayCommandNetworkIcon:
+            display_->SetNetworkIcon(command.text.c_str());
+            break;
+        case kDisplayCommandClock:
+            display_->SetClock(command.text.c_str());
+            break;
+        case kDisplayCommandIdleClock:
+            display_->ShowIdleClock();
+            break;
+    }
+}
+
+void DisplayQueue::UiTask() {
+    int64_t last_batch_time = 0;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Wait for the rest of the frame so that updates posted back to back are merged
+        int64_t elapsed_ms = (esp_timer_get_time() - last_batch_time) / 1000;
+        if (elapsed_ms < DISPLAY_QUEUE_FRAME_INTERVAL_MS) {
+            vTaskDelay(pdMS_TO_TICKS(DISPLAY_QUEUE_FRAME_INTERVAL_MS - elapsed_ms));
+        }
+
+        ApplyPending();
+        last_batch_time = esp_timer_get_time();
+    }
+}
+
+void DisplayQueue::ApplyPending() {
+    std::lock_guard<std::mutex> apply_lock(apply_mutex_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto commands = std::move(commands_);
+    commands_.clear();
+    statistics_.batch_count++;
+    lock.unlock();
+
+    if (!commands.empty()) {
+        // The display lock is recursive, so the nested locks taken by each call are cheap
+        DisplayLockGuard display_lock(display_);
+        for (const auto& command : commands) {
+            Apply(command);
+        }
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef DISPLAY_QUEUE_H
+#define DISPLAY_QUEUE_H
+
+#include "display.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <string>
+#include <vector>
+#include <mutex>
+
+/*
+ * Display command queue
+ *
+ * Callers (main event loop, esp_timer callbacks, MCP tool threads) post cheap commands
+ * and return immediately. A single UI task drains the queue, drops redundant updates
+ * (only the last status / notification / emotion in a batch wins) and applies the batch
+ * under one display lock.
+ *
+ * All shared code (Application, the common WiFi / ML307 / dual network boards, the MCP
+ * tools and the camera preview) posts through Application::GetDisplayQueue(). Code under
+ * main/boards/<board>/ may still call Display directly for its own widgets and for button
+ * feedback such as volume notifications: those calls are ordered by the display lock only,
+ * so they must not touch the status / emotion / chat message state driven by the queue.
+ */
+
+enum DisplayCommandType {
+    kDisplayCommandStatus,
+    kDisplayCommandNotification,
+    kDisplayCommandEmotion,
+    kDisplayCommandIcon,
+    kDisplayCommandChatMessage,
+    kDisplayCommandTheme,
+    kDisplayCommandPreviewImage,
+    kDisplayCommandMuted,
+    kDisplayCommandBatteryIcon,
+    kDisplayCommandNetworkIcon,
+    kDisplayCommandClock,
+    kDisplayCommandIdleClock,
+};
+
+struct DisplayCommand {
+    DisplayCommandType type;
+    std::string role;
+    std::string text;
+    int duration_ms = 0;
+    const lv_img_dsc_t* image = nullptr;
+    bool flag = false;
+};
+
+struct DisplayQueueStatistics {
+    uint32_t posted_count = 0;
+    uint32_t coalesced_count = 0;
+    uint32_t batch_count = 0;
+    uint32_t stack_free_bytes = 0;  // UI task stack high-water mark
+};
+
+class DisplayQueue {
+public:
+    DisplayQueue(Display* display);
+    ~DisplayQueue();
+
+    void SetStatus(const char* status);
+    void ShowNotification(const char* notification, int duration_ms = 3000);
+    void ShowNotification(const std::string& notification, int duration_ms = 3000);
+    void SetEmotion(const char* emotion);
+    void SetIcon(const char* icon);
+    void SetChatMessage(const char* role, const char* content);
+    void SetTheme(const std::string& theme_name);
+    // The image must stay valid until it is replaced, as with Display::SetPreviewImage
+    void SetPreviewImage(const lv_img_dsc_t* image);
+    void SetMuted(bool muted);
+    void SetBatteryIcon(const char* icon, bool low_battery);
+    void SetNetworkIcon(const char* icon);
+    void SetClock(const char* clock);
+    void ShowIdleClock();
+    // Apply the pending commands in the calling task, e.g. right before entering light sleep
+    void Flush();
+
+    Display* display() const { return display_; }
+    DisplayQueueStatistics GetStatistics();
+
+private:
+    Display* display_;
+    TaskHandle_t ui_task_handle_ = nullptr;
+    std::mutex mutex_;
+    // Held while a batch is taken and applied, so batches are applied in posting order
+    std::mutex apply_mutex_;
+    std::vector<DisplayCommand> commands_;
+    DisplayQueueStatistics statistics_;
+
+    void Post(DisplayCommand&& command);
+    void UiTask();
+    void ApplyPending();
+    void Apply(const DisplayCommand& command);
+};
+
+#endif // DISPLAY_QUEUE_H
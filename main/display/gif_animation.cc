@@ -0,0 +1,461 @@
+#include "gif_animation.h"
+
+#include <libs/gif/gifdec.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <cstring>
+#include <algorithm>
+
+#define TAG "GifAnimation"
+
+// GIF 中延时为 0 的帧按 10ms 计，过小的延时按 LVGL 刷新周期限制
+#define GIF_MIN_FRAME_DELAY_MS 20
+
+// 缓存未命中时每次定时器回调最多解码的时间，两次解码之间让出 LVGL 任务
+#define GIF_DECODE_BUDGET_US 4000
+#define GIF_DECODE_INTERVAL_MS 5
+
+static void* AllocateCache(size_t size) {
+    return heap_caps_malloc_prefer(size, 2, MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+}
+
+static inline bool IsEmptyArea(const lv_area_t& area) {
+    return area.x2 < area.x1 || area.y2 < area.y1;
+}
+
+// 找出两帧之间发生变化的像素范围
+static lv_area_t DiffArea(const uint32_t* previous, const uint32_t* current, int width, int height) {
+    lv_area_t area = {width, height, -1, -1};
+    for (int y = 0; y < height; y++) {
+        const uint32_t* p = previous + y * width;
+        const uint32_t* c = current + y * width;
+        if (memcmp(p, c, width * 4) == 0) {
+            continue;
+        }
+        int x1 = 0, x2 = width - 1;
+        while (p[x1] == c[x1]) x1++;
+        while (p[x2] == c[x2]) x2--;
+        area.x1 = std::min<int32_t>(area.x1, x1);
+        area.x2 = std::max<int32_t>(area.x2, x2);
+        area.y1 = std::min<int32_t>(area.y1, y);
+        area.y2 = y;
+    }
+    return area;
+}
+
+// 区域内的像素按行展开后做游程编码：1 字节长度 + 4 字节像素
+static std::vector<uint8_t> EncodeRle(const uint32_t* pixels, int width, const lv_area_t& area) {
+    std::vector<uint8_t> rle;
+    uint32_t run_pixel = 0;
+    int run_length = 0;
+    auto flush_run = [&]() {
+        rle.push_back(run_length);
+        rle.insert(rle.end(), (const uint8_t*)&run_pixel, (const uint8_t*)&run_pixel + 4);
+    };
+    for (int y = area.y1; y <= area.y2; y++) {
+        for (int x = area.x1; x <= area.x2; x++) {
+            uint32_t pixel = pixels[y * width + x];
+            if (run_length > 0 && (pixel != run_pixel || run_length == 255)) {
+                flush_run();
+                run_length = 0;
+            }
+            run_pixel = pixel;
+            run_length++;
+        }
+    }
+    if (run_length > 0) {
+        flush_run();
+    }
+    return rle;
+}
+
+GifAnimation::Clip::~Clip() {
+    for (auto& frame : frames) {
+        heap_caps_free(frame.rle);
+    }
+    heap_caps_free(loop_frame.rle);
+}
+
+GifAnimation::Decoder::~Decoder() {
+    heap_caps_free(first);
+    heap_caps_free(previous);
+    heap_caps_free(current);
+    if (gif != nullptr) {
+        gd_close_gif(gif);
+    }
+}
+
+GifAnimation::GifAnimation(lv_obj_t* parent, size_t cache_size) : cache_size_(cache_size) {
+    image_ = lv_image_create(parent);
+    timer_ = lv_timer_create([](lv_timer_t* timer) {
+        auto self = static_cast<GifAnimation*>(lv_timer_get_user_data(timer));
+        self->OnTimer();
+    }, GIF_MIN_FRAME_DELAY_MS, this);
+    lv_timer_pause(timer_);
+}
+
+GifAnimation::~GifAnimation() {
+    Stop();
+    if (timer_ != nullptr) {
+        lv_timer_delete(timer_);
+    }
+    if (image_ != nullptr) {
+        lv_obj_delete(image_);
+    }
+    if (frame_buffer_ != nullptr) {
+        heap_caps_free(frame_buffer_);
+    }
+}
+
+void GifAnimation::Stop() {
+    decoder_.reset();
+    if (live_gif_ != nullptr) {
+        gd_close_gif(live_gif_);
+        live_gif_ = nullptr;
+    }
+    current_ = nullptr;
+    if (timer_ != nullptr) {
+        lv_timer_pause(timer_);
+    }
+}
+
+// 尺寸变化时重新分配帧缓冲区，并让图片对象指向它
+bool GifAnimation::PrepareFrameBuffer(int width, int height) {
+    size_t frame_size = width * height * 4;
+    if (frame_buffer_ == nullptr || frame_buffer_size_ != frame_size) {
+        heap_caps_free(frame_buffer_);
+        frame_buffer_ = (uint8_t*)AllocateCache(frame_size);
+        frame_buffer_size_ = frame_buffer_ ? frame_size : 0;
+        if (frame_buffer_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate frame buffer");
+            lv_image_set_src(image_, nullptr);
+            return false;
+        }
+        // 新缓冲区在第一帧写入前保持透明
+        memset(frame_buffer_, 0, frame_size);
+    }
+    image_dsc_.header.magic = LV_IMAGE_HEADER_MAGIC;
+    image_dsc_.header.cf = LV_COLOR_FORMAT_ARGB8888;
+    image_dsc_.header.w = width;
+    image_dsc_.header.h = height;
+    image_dsc_.header.stride = width * 4;
+    image_dsc_.data = frame_buffer_;
+    image_dsc_.data_size = frame_size;
+    return true;
+}
+
+void GifAnimation::StartDecode(const lv_image_dsc_t* gif) {
+    auto decoder = std::make_unique<Decoder>();
+    decoder->start_time = esp_timer_get_time();
+    decoder->gif = gd_open_gif_data(gif->data);
+    if (decoder->gif == nullptr) {
+        ESP_LOGE(TAG, "Failed to open GIF %p", gif);
+        source_ = nullptr;
+        return;
+    }
+
+    int width = decoder->gif->width;
+    int height = decoder->gif->height;
+    if (!PrepareFrameBuffer(width, height)) {
+        source_ = nullptr;
+        return;
+    }
+
+    size_t frame_size = width * height * 4;
+    decoder->first = (uint32_t*)AllocateCache(frame_size);
+    decoder->previous = (uint32_t*)AllocateCache(frame_size);
+    decoder->current = (uint32_t*)AllocateCache(frame_size);
+    if (decoder->first == nullptr || decoder->previous == nullptr || decoder->current == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate GIF decode buffers, play %p without cache", gif);
+        decoder.reset();
+        StartLive(gif);
+        return;
+    }
+
+    decoder->clip = std::make_unique<Clip>();
+    decoder->clip->source = gif;
+    decoder->clip->width = width;
+    decoder->clip->height = height;
+    decoder->clip->loop_frame = {{0, 0, -1, -1}, 0, nullptr, 0};
+    decoder->clip->size = 0;
+    decoder_ = std::move(decoder);
+
+    // 第一段在这里解码，让第一帧尽快显示出来，其余的由定时器继续解码
+    DecodeStep();
+    if (decoder_ != nullptr) {
+        lv_timer_set_period(timer_, GIF_DECODE_INTERVAL_MS);
+        lv_timer_reset(timer_);
+        lv_timer_resume(timer_);
+    }
+}
+
+bool GifAnimation::AddFrame(Clip& clip, const uint32_t* pixels, const lv_area_t& area, uint32_t delay_ms, Frame& frame) {
+    frame = {area, delay_ms, nullptr, 0};
+    if (IsEmptyArea(area)) {
+        return true;
+    }
+    auto rle = EncodeRle(pixels, clip.width, area);
+    frame.rle = (uint8_t*)AllocateCache(rle.size());
+    if (frame.rle == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes for GIF frame %u, play %p without cache", rle.size(),
+            clip.frames.size(), clip.source);
+        return false;
+    }
+    memcpy(frame.rle, rle.data(), rle.size());
+    frame.rle_size = rle.size();
+    clip.size += rle.size();
+    return true;
+}
+
+void GifAnimation::DecodeStep() {
+    auto& decoder = *decoder_;
+    auto& clip = *decoder.clip;
+    int width = clip.width;
+    int height = clip.height;
+    size_t frame_size = width * height * 4;
+
+    int64_t start_time = esp_timer_get_time();
+    while (esp_timer_get_time() - start_time < GIF_DECODE_BUDGET_US) {
+        if (gd_get_frame(decoder.gif) != 1) {
+            statistics_.decode_time_us += esp_timer_get_time() - start_time;
+            FinishDecode();
+            return;
+        }
+        gd_render_frame(decoder.gif, (uint8_t*)decoder.current);
+        uint32_t delay_ms = std::max<uint32_t>(decoder.gif->gce.delay * 10, GIF_MIN_FRAME_DELAY_MS);
+
+        bool first = clip.frames.empty();
+        lv_area_t area = {0, 0, width - 1, height - 1};
+        if (!first) {
+            area = DiffArea(decoder.previous, decoder.current, width, height);
+        }
+        Frame frame;
+        if (!AddFrame(clip, decoder.current, area, delay_ms, frame)) {
+            StartLive(clip.source);
+            return;
+        }
+        clip.frames.push_back(frame);
+
+        if (first) {
+            // 解码其余帧期间先显示第一帧
+            memcpy(decoder.first, decoder.current, frame_size);
+            memcpy(frame_buffer_, decoder.current, frame_size);
+            lv_image_cache_drop(&image_dsc_);
+            lv_image_set_src(image_, &image_dsc_);
+            lv_obj_invalidate(image_);
+        }
+        std::swap(decoder.previous, decoder.current);
+    }
+    statistics_.decode_time_us += esp_timer_get_time() - start_time;
+}
+
+void GifAnimation::FinishDecode() {
+    auto& decoder = *decoder_;
+    auto& clip = *decoder.clip;
+    if (clip.frames.empty()) {
+        ESP_LOGE(TAG, "GIF %p has no frames", clip.source);
+        source_ = nullptr;
+        Stop();
+        return;
+    }
+    if (clip.frames.size() > 1) {
+        auto loop_area = DiffArea(decoder.previous, decoder.first, clip.width, clip.height);
+        if (!AddFrame(clip, decoder.first, loop_area, clip.frames[0].delay_ms, clip.loop_frame)) {
+            StartLive(clip.source);
+            return;
+        }
+    }
+
+    ESP_LOGI(TAG, "Decoded GIF %p: %dx%d, %u frames, %u bytes (raw %u), %lldms", clip.source, clip.width,
+        clip.height, clip.frames.size(), clip.size, clip.frames.size() * clip.width * clip.height * 4,
+        (esp_timer_get_time() - decoder.start_time) / 1000);
+
+    auto decoded = std::move(decoder.clip);
+    decoder_.reset();
+    Evict(decoded->size);
+    statistics_.cached_bytes += decoded->size;
+    clips_.push_front(std::move(decoded));
+    Play(clips_.front().get());
+}
+
+// 没有足够的内存缓存时退回到逐帧解码，与 lv_gif 的开销相同
+void GifAnimation::StartLive(const lv_image_dsc_t* gif) {
+    decoder_.reset();
+    live_gif_ = gd_open_gif_data(gif->data);
+    if (live_gif_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to open GIF %p", gif);
+        source_ = nullptr;
+        Stop();
+        return;
+    }
+    if (!PrepareFrameBuffer(live_gif_->width, live_gif_->height)) {
+        source_ = nullptr;
+        Stop();
+        return;
+    }
+    lv_image_set_src(image_, &image_dsc_);
+    next_frame_time_ = esp_timer_get_time();
+    LiveStep();
+    lv_timer_reset(timer_);
+    lv_timer_resume(timer_);
+}
+
+void GifAnimation::LiveStep() {
+    int64_t now = esp_timer_get_time();
+    if (now < next_frame_time_) {
+        return;
+    }
+    if (gd_get_frame(live_gif_) != 1) {
+        gd_rewind(live_gif_);
+        if (gd_get_frame(live_gif_) != 1) {
+            lv_timer_pause(timer_);
+            return;
+        }
+    }
+    gd_render_frame(live_gif_, frame_buffer_);
+    lv_image_cache_drop(&image_dsc_);
+    lv_obj_invalidate(image_);
+    statistics_.frames_rendered++;
+
+    uint32_t delay_ms = std::max<uint32_t>(live_gif_->gce.delay * 10, GIF_MIN_FRAME_DELAY_MS);
+    next_frame_time_ = now + delay_ms * 1000;
+    lv_timer_set_period(timer_, delay_ms);
+}
+
+void GifAnimation::Evict(size_t required_size) {
+    // 从最久未使用的动画开始释放，正在播放的不释放
+    auto it = clips_.end();
+    while (it != clips_.begin() && statistics_.cached_bytes + required_size > cache_size_) {
+        --it;
+        if (it->get() == current_) {
+            continue;
+        }
+        statistics_.cached_bytes -= (*it)->size;
+        it = clips_.erase(it);
+    }
+}
+
+void GifAnimation::SetSource(const lv_image_dsc_t* gif) {
+    // 正在播放、解码或逐帧播放同一个动画时不重新开始
+    if (source_ == gif) {
+        return;
+    }
+    Stop();
+    source_ = gif;
+
+    for (auto it = clips_.begin(); it != clips_.end(); ++it) {
+        if ((*it)->source == gif) {
+            clips_.splice(clips_.begin(), clips_, it);
+            statistics_.hit_count++;
+            Play(clips_.front().get());
+            return;
+        }
+    }
+    statistics_.miss_count++;
+    StartDecode(gif);
+}
+
+void GifAnimation::Play(Clip* clip) {
+    if (!PrepareFrameBuffer(clip->width, clip->height)) {
+        source_ = nullptr;
+        Stop();
+        return;
+    }
+
+    current_ = clip;
+    frame_index_ = 0;
+    ApplyFrame(clip->frames[0]);
+    lv_image_cache_drop(&image_dsc_);
+    lv_image_set_src(image_, &image_dsc_);
+    lv_obj_invalidate(image_);
+
+    if (clip->frames.size() > 1) {
+        next_frame_time_ = esp_timer_get_time() + clip->frames[0].delay_ms * 1000;
+        lv_timer_set_period(timer_, clip->frames[0].delay_ms);
+        lv_timer_reset(timer_);
+        lv_timer_resume(timer_);
+    } else {
+        lv_timer_pause(timer_);
+    }
+
+    uint32_t total = statistics_.hit_count + statistics_.miss_count;
+    ESP_LOGI(TAG, "Play GIF %p, cache hit rate %lu%%, cached %lu bytes, rendered %lu, dropped %lu frames", clip->source,
+        statistics_.hit_count * 100 / total, statistics_.cached_bytes, statistics_.frames_rendered,
+        statistics_.frames_dropped);
+}
+
+void GifAnimation::ApplyFrame(const Frame& frame) {
+    if (frame.rle == nullptr) {
+        return;
+    }
+    auto pixels = (uint32_t*)frame_buffer_;
+    int width = current_->width;
+    int x = frame.area.x1;
+    int y = frame.area.y1;
+    for (size_t i = 0; i < frame.rle_size; i += 5) {
+        int run_length = frame.rle[i];
+        uint32_t pixel;
+        memcpy(&pixel, &frame.rle[i + 1], 4);
+        while (run_length-- > 0) {
+            pixels[y * width + x] = pixel;
+            if (++x > frame.area.x2) {
+                x = frame.area.x1;
+                y++;
+            }
+        }
+    }
+}
+
+void GifAnimation::OnTimer() {
+    if (decoder_ != nullptr) {
+        DecodeStep();
+        return;
+    }
+    if (live_gif_ != nullptr) {
+        LiveStep();
+        return;
+    }
+    if (current_ == nullptr || current_->frames.size() < 2) {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (now < next_frame_time_) {
+        return;
+    }
+
+    // 渲染落后时连续应用多帧差异，只刷新一次，跳过的帧计为丢帧
+    lv_area_t dirty = {current_->width, current_->height, -1, -1};
+    int advanced = 0;
+    while (now >= next_frame_time_) {
+        frame_index_ = (frame_index_ + 1) % current_->frames.size();
+        const Frame& frame = frame_index_ == 0 ? current_->loop_frame : current_->frames[frame_index_];
+        ApplyFrame(frame);
+        if (!IsEmptyArea(frame.area)) {
+            dirty.x1 = std::min(dirty.x1, frame.area.x1);
+            dirty.y1 = std::min(dirty.y1, frame.area.y1);
+            dirty.x2 = std::max(dirty.x2, frame.area.x2);
+            dirty.y2 = std::max(dirty.y2, frame.area.y2);
+        }
+        next_frame_time_ += current_->frames[frame_index_].delay_ms * 1000;
+        if (++advanced >= (int)current_->frames.size()) {
+            next_frame_time_ = now + current_->frames[frame_index_].delay_ms * 1000;
+            break;
+        }
+    }
+    statistics_.frames_rendered++;
+    statistics_.frames_dropped += advanced - 1;
+
+    if (!IsEmptyArea(dirty)) {
+        lv_image_cache_drop(&image_dsc_);
+        // 转换为屏幕坐标，只重绘变化的区域
+        lv_area_t coords;
+        lv_obj_get_coords(image_, &coords);
+        lv_area_t area = {coords.x1 + dirty.x1, coords.y1 + dirty.y1, coords.x1 + dirty.x2, coords.y1 + dirty.y2};
+        lv_obj_invalidate_area(image_, &area);
+    }
+
+    uint32_t period = std::max<int64_t>((next_frame_time_ - now) / 1000, 1);
+    lv_timer_set_period(timer_, period);
+}
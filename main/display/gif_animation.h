@@ -0,0 +1,103 @@
+#ifndef GIF_ANIMATION_H
+#define GIF_ANIMATION_H
+
+#include <lvgl.h>
+
+#include <list>
+#include <vector>
+#include <memory>
+
+struct gd_GIF;
+
+/*
+ * GIF emotion animation with a pre-decoded frame cache
+ *
+ * Each GIF is decoded once into RLE-compressed frame deltas (only the bounding box of
+ * the pixels that changed since the previous frame) kept in PSRAM under an LRU budget.
+ * Playback applies the delta to a single ARGB8888 frame buffer and invalidates only the
+ * changed area, paced by one LVGL timer.
+ *
+ * A cache miss never decodes the whole GIF at once while the LVGL lock is held: the same
+ * timer decodes it a few milliseconds at a time, showing the first frame as soon as it is
+ * ready. If the cache cannot be allocated, the GIF is played by decoding each frame live.
+ */
+
+struct GifAnimationStatistics {
+    uint32_t hit_count = 0;
+    uint32_t miss_count = 0;
+    uint32_t frames_rendered = 0;
+    uint32_t frames_dropped = 0;
+    uint32_t cached_bytes = 0;
+    int64_t decode_time_us = 0;
+};
+
+class GifAnimation {
+public:
+    GifAnimation(lv_obj_t* parent, size_t cache_size);
+    ~GifAnimation();
+
+    lv_obj_t* obj() const { return image_; }
+    void SetSource(const lv_image_dsc_t* gif);
+    GifAnimationStatistics GetStatistics() const { return statistics_; }
+
+private:
+    struct Frame {
+        lv_area_t area;
+        uint32_t delay_ms;
+        uint8_t* rle;
+        size_t rle_size;
+    };
+
+    struct Clip {
+        const lv_image_dsc_t* source;
+        uint16_t width;
+        uint16_t height;
+        // frames[0] 是完整的关键帧，loop_frame 是最后一帧回到第一帧的差异
+        std::vector<Frame> frames;
+        Frame loop_frame;
+        size_t size;
+        ~Clip();
+    };
+
+    // 正在逐步解码的动画
+    struct Decoder {
+        gd_GIF* gif = nullptr;
+        uint32_t* first = nullptr;
+        uint32_t* previous = nullptr;
+        uint32_t* current = nullptr;
+        std::unique_ptr<Clip> clip;
+        int64_t start_time = 0;
+        ~Decoder();
+    };
+
+    lv_obj_t* image_ = nullptr;
+    lv_timer_t* timer_ = nullptr;
+    lv_image_dsc_t image_dsc_ = {};
+    uint8_t* frame_buffer_ = nullptr;
+    size_t frame_buffer_size_ = 0;
+
+    size_t cache_size_;
+    std::list<std::unique_ptr<Clip>> clips_;
+    const lv_image_dsc_t* source_ = nullptr;
+    std::unique_ptr<Decoder> decoder_;
+    gd_GIF* live_gif_ = nullptr;  // 缓存内存不足时逐帧解码播放
+    Clip* current_ = nullptr;
+    size_t frame_index_ = 0;
+    int64_t next_frame_time_ = 0;
+    GifAnimationStatistics statistics_;
+
+    void Stop();
+    bool PrepareFrameBuffer(int width, int height);
+    void StartDecode(const lv_image_dsc_t* gif);
+    void DecodeStep();
+    void FinishDecode();
+    bool AddFrame(Clip& clip, const uint32_t* pixels, const lv_area_t& area, uint32_t delay_ms, Frame& frame);
+    void StartLive(const lv_image_dsc_t* gif);
+    void LiveStep();
+    void Play(Clip* clip);
+    void Evict(size_t required_size);
+    void ApplyFrame(const Frame& frame);
+    void OnTimer();
+};
+
+#endif // GIF_ANIMATION_H
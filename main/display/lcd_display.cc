@@ -7,6 +7,7 @@
 #include <esp_err.h>
 #include <esp_lvgl_port.h>
 #include <esp_heap_caps.h>
+#include <esp_timer.h>
 #include "assets/lang_config.h"
 #include <cstring>
 #include "settings.h"
@@ -82,6 +83,18 @@ LcdDisplay::LcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_
     } else if (current_theme_name_ == "light") {
         current_theme_ = LIGHT_THEME;
     }
+
+#if CONFIG_USE_FONT_PARTITION
+    // 字体分区中的字体优先于固件内置字体，字形按需从 flash 读取
+    partition_text_font_.reset(PartitionFont::Load("text", CONFIG_FONT_GLYPH_CACHE_SIZE * 1024));
+    if (partition_text_font_ != nullptr) {
+        fonts_.text_font = partition_text_font_->font();
+    }
+    partition_icon_font_.reset(PartitionFont::Load("icon", CONFIG_FONT_GLYPH_CACHE_SIZE * 1024 / 4));
+    if (partition_icon_font_ != nullptr) {
+        fonts_.icon_font = partition_icon_font_->font();
+    }
+#endif
 }
 
 SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
@@ -114,7 +127,11 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         .panel_handle = panel_,
         .control_handle = nullptr,
         .buffer_size = static_cast<uint32_t>(width_ * 20),
+#if CONFIG_DISPLAY_DOUBLE_BUFFER
+        .double_buffer = true,
+#else
         .double_buffer = false,
+#endif
         .trans_size = 0,
         .hres = static_cast<uint32_t>(width_),
         .vres = static_cast<uint32_t>(height_),
@@ -145,6 +162,7 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         lv_display_set_offset(display_, offset_x, offset_y);
     }
 
+    SetupFlushTracking(16);
     SetupUI();
 }
 
@@ -304,6 +322,13 @@ void LcdDisplay::Unlock() {
 }
 
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
+// 保留的消息记录数量；消息行池按一屏可见的行数计算，且不超过该值
+#if CONFIG_IDF_TARGET_ESP32P4
+#define  MAX_MESSAGES 40
+#else
+#define  MAX_MESSAGES 20
+#endif
+
 void LcdDisplay::SetupUI() {
     DisplayLockGuard lock(this);
 
@@ -347,8 +372,64 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_flex_align(content_, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START);
     lv_obj_set_style_pad_row(content_, 10, 0); // Space between messages
 
-    // We'll create chat messages dynamically in SetChatMessage
+    // 预先创建固定数量的消息行，SetChatMessage 循环复用这些行，不再动态创建/删除对象
     chat_message_label_ = nullptr;
+    int row_count = LV_VER_RES / (fonts_.text_font->line_height + 26) + 2;
+    row_count = std::max(4, std::min(row_count, MAX_MESSAGES));
+    for (int i = 0; i < row_count; i++) {
+        // 全宽透明容器，用于控制气泡的对齐方式
+        lv_obj_t* row = lv_obj_create(content_);
+        lv_obj_set_width(row, LV_HOR_RES);
+        lv_obj_set_height(row, LV_SIZE_CONTENT);
+        lv_obj_set_style_bg_opa(row, LV_OPA_TRANSP, 0);
+        lv_obj_set_style_border_width(row, 0, 0);
+        lv_obj_set_style_pad_all(row, 0, 0);
+        lv_obj_set_scrollbar_mode(row, LV_SCROLLBAR_MODE_OFF);
+        // 隐藏的行不参与 flex 布局
+        lv_obj_add_flag(row, LV_OBJ_FLAG_HIDDEN);
+
+        lv_obj_t* bubble = lv_obj_create(row);
+        lv_obj_set_style_radius(bubble, 8, 0);
+        lv_obj_set_scrollbar_mode(bubble, LV_SCROLLBAR_MODE_OFF);
+        lv_obj_set_style_border_width(bubble, 1, 0);
+        lv_obj_set_style_border_color(bubble, current_theme_.border, 0);
+        lv_obj_set_style_pad_all(bubble, 8, 0);
+        lv_obj_set_size(bubble, LV_SIZE_CONTENT, LV_SIZE_CONTENT);
+        lv_obj_set_user_data(bubble, (void*)"assistant");
+
+        lv_obj_t* text = lv_label_create(bubble);
+        lv_label_set_long_mode(text, LV_LABEL_LONG_WRAP);
+        lv_obj_set_style_text_font(text, fonts_.text_font, 0);
+
+        chat_rows_.push_back(row);
+    }
+
+    // 用户滚动到行池的顶部或底部时，把行重新绑定到更早或更新的记录
+    lv_obj_add_event_cb(content_, [](lv_event_t* e) {
+        auto self = static_cast<LcdDisplay*>(lv_event_get_user_data(e));
+        self->OnChatScroll(lv_event_get_code(e));
+    }, LV_EVENT_SCROLL_BEGIN, this);
+    lv_obj_add_event_cb(content_, [](lv_event_t* e) {
+        auto self = static_cast<LcdDisplay*>(lv_event_get_user_data(e));
+        self->OnChatScroll(lv_event_get_code(e));
+    }, LV_EVENT_SCROLL_END, this);
+
+    // 统计新消息之后第一次刷新的渲染耗时
+    lv_display_add_event_cb(display_, [](lv_event_t* e) {
+        auto self = static_cast<LcdDisplay*>(lv_event_get_user_data(e));
+        if (self->chat_render_pending_) {
+            self->chat_render_start_us_ = esp_timer_get_time();
+        }
+    }, LV_EVENT_RENDER_START, this);
+    lv_display_add_event_cb(display_, [](lv_event_t* e) {
+        auto self = static_cast<LcdDisplay*>(lv_event_get_user_data(e));
+        if (self->chat_render_pending_ && self->chat_render_start_us_ != 0) {
+            self->chat_render_time_us_ += esp_timer_get_time() - self->chat_render_start_us_;
+            self->chat_render_count_++;
+            self->chat_render_pending_ = false;
+            self->chat_render_start_us_ = 0;
+        }
+    }, LV_EVENT_RENDER_READY, this);
 
     /* Status bar */
     lv_obj_set_flex_flow(status_bar_, LV_FLEX_FLOW_ROW);
@@ -413,192 +494,190 @@ void LcdDisplay::SetupUI() {
     lv_obj_center(low_battery_label_);
     lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
 }
-#if CONFIG_IDF_TARGET_ESP32P4
-#define  MAX_MESSAGES 40
-#else
-#define  MAX_MESSAGES 20
-#endif
-void LcdDisplay::SetChatMessage(const char* role, const char* content) {
-    DisplayLockGuard lock(this);
-    if (content_ == nullptr) {
-        return;
-    }
-    
-    //避免出现空的消息框
-    if(strlen(content) == 0) return;
-    
-    // 检查消息数量是否超过限制
-    uint32_t child_count = lv_obj_get_child_cnt(content_);
-    if (child_count >= MAX_MESSAGES) {
-        // 删除最早的消息（第一个子对象）
-        lv_obj_t* first_child = lv_obj_get_child(content_, 0);
-        lv_obj_t* last_child = lv_obj_get_child(content_, child_count - 1);
-        if (first_child != nullptr) {
-            lv_obj_del(first_child);
-        }
-        // Scroll to the last message immediately
-        if (last_child != nullptr) {
-            lv_obj_scroll_to_view_recursive(last_child, LV_ANIM_OFF);
-        }
-    }
-    
-    // 折叠系统消息（如果是系统消息，检查最后一个消息是否也是系统消息）
-    if (strcmp(role, "system") == 0 && child_count > 0) {
-        // 获取最后一个消息容器
-        lv_obj_t* last_container = lv_obj_get_child(content_, child_count - 1);
-        if (last_container != nullptr && lv_obj_get_child_cnt(last_container) > 0) {
-            // 获取容器内的气泡
-            lv_obj_t* last_bubble = lv_obj_get_child(last_container, 0);
-            if (last_bubble != nullptr) {
-                // 检查气泡类型是否为系统消息
-                void* bubble_type_ptr = lv_obj_get_user_data(last_bubble);
-                if (bubble_type_ptr != nullptr && strcmp((const char*)bubble_type_ptr, "system") == 0) {
-                    // 如果最后一个消息也是系统消息，则删除它
-                    lv_obj_del(last_container);
-                }
-            }
-        }
-    }
-    
-    // Create a message bubble
-    lv_obj_t* msg_bubble = lv_obj_create(content_);
-    lv_obj_set_style_radius(msg_bubble, 8, 0);
-    lv_obj_set_scrollbar_mode(msg_bubble, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_style_border_width(msg_bubble, 1, 0);
-    lv_obj_set_style_border_color(msg_bubble, current_theme_.border, 0);
-    lv_obj_set_style_pad_all(msg_bubble, 8, 0);
-
-    // Create the message text
-    lv_obj_t* msg_text = lv_label_create(msg_bubble);
-    lv_label_set_text(msg_text, content);
-    
+// 将消息记录绑定到一个复用的消息行
+void LcdDisplay::BindChatRow(lv_obj_t* row, const ChatRecord& record) {
+    lv_obj_t* bubble = lv_obj_get_child(row, 0);
+    lv_obj_t* msg_text = lv_obj_get_child(bubble, 0);
+    lv_label_set_text(msg_text, record.content.c_str());
+
     // 计算文本实际宽度
-    lv_coord_t text_width = lv_txt_get_width(content, strlen(content), fonts_.text_font, 0);
+    lv_coord_t text_width = lv_txt_get_width(record.content.c_str(), record.content.size(), fonts_.text_font, 0);
 
     // 计算气泡宽度
     lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;  // 屏幕宽度的85%
-    lv_coord_t min_width = 20;  
-    lv_coord_t bubble_width;
-    
-    // 确保文本宽度不小于最小宽度
-    if (text_width < min_width) {
-        text_width = min_width;
-    }
-
-    // 如果文本宽度小于最大宽度，使用文本宽度
-    if (text_width < max_width) {
-        bubble_width = text_width; 
-    } else {
-        bubble_width = max_width;
-    }
-    
-    // 设置消息文本的宽度
-    lv_obj_set_width(msg_text, bubble_width);  // 减去padding
-    lv_label_set_long_mode(msg_text, LV_LABEL_LONG_WRAP);
-    lv_obj_set_style_text_font(msg_text, fonts_.text_font, 0);
-
-    // 设置气泡宽度
-    lv_obj_set_width(msg_bubble, bubble_width);
-    lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
+    lv_coord_t min_width = 20;
+    lv_coord_t bubble_width = std::min(std::max(text_width, min_width), max_width);
+    lv_obj_set_width(msg_text, bubble_width);
 
     // Set alignment and style based on message role
-    if (strcmp(role, "user") == 0) {
+    lv_obj_set_user_data(bubble, (void*)record.role);
+    if (strcmp(record.role, "user") == 0) {
         // User messages are right-aligned with green background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme_.user_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme_.text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"user");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "assistant") == 0) {
-        // Assistant messages are left-aligned with white background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme_.assistant_bubble, 0);
-        // Set text color for contrast
+        lv_obj_set_style_bg_color(bubble, current_theme_.user_bubble, 0);
         lv_obj_set_style_text_color(msg_text, current_theme_.text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"assistant");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "system") == 0) {
+        lv_obj_align(bubble, LV_ALIGN_RIGHT_MID, -25, 0);
+    } else if (strcmp(record.role, "system") == 0) {
         // System messages are center-aligned with light gray background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme_.system_bubble, 0);
-        // Set text color for contrast
+        lv_obj_set_style_bg_color(bubble, current_theme_.system_bubble, 0);
         lv_obj_set_style_text_color(msg_text, current_theme_.system_text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"system");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
+        lv_obj_align(bubble, LV_ALIGN_CENTER, 0, 0);
+    } else {
+        // Assistant messages are left-aligned
+        lv_obj_set_style_bg_color(bubble, current_theme_.assistant_bubble, 0);
+        lv_obj_set_style_text_color(msg_text, current_theme_.text, 0);
+        lv_obj_align(bubble, LV_ALIGN_LEFT_MID, 0, 0);
+    }
+    lv_obj_set_style_border_color(bubble, current_theme_.border, 0);
+    lv_obj_clear_flag(row, LV_OBJ_FLAG_HIDDEN);
+}
+
+size_t LcdDisplay::GetBoundChatRowCount() const {
+    return std::min(chat_records_.size(), chat_rows_.size());
+}
+
+// 把行池重新绑定到最新的消息记录
+void LcdDisplay::ShowLatestChatRecords() {
+    size_t bound = GetBoundChatRowCount();
+    chat_window_start_ = chat_records_.size() - bound;
+    for (size_t i = 0; i < bound; i++) {
+        BindChatRow(chat_rows_[chat_rows_.size() - bound + i], chat_records_[chat_window_start_ + i]);
+    }
+}
+
+// 将行池对应的记录窗口移动 count 条（负数表示向更早的消息移动）
+void LcdDisplay::ShiftChatWindow(int count) {
+    // 记录不足一屏时所有消息都已经显示
+    if (GetBoundChatRowCount() < chat_rows_.size()) {
+        return;
+    }
+    int max_start = chat_records_.size() - chat_rows_.size();
+    int start = std::max(0, std::min((int)chat_window_start_ + count, max_start));
+    count = start - (int)chat_window_start_;
+    if (count == 0) {
+        return;
+    }
+
+    // 图片预览不在记录中，翻看历史消息时删除它
+    if (image_bubble_ != nullptr) {
+        lv_obj_del(image_bubble_);
+        image_bubble_ = nullptr;
+    }
+
+    // 以移动后仍保留的行为锚点，保持屏幕上的内容不跳动
+    lv_obj_t* anchor = count < 0 ? chat_rows_.front() : chat_rows_.back();
+    int32_t anchor_offset = lv_obj_get_y(anchor) - lv_obj_get_scroll_y(content_);
+    for (; count < 0; count++) {
+        lv_obj_t* row = chat_rows_.back();
+        chat_rows_.pop_back();
+        chat_rows_.push_front(row);
+        lv_obj_move_to_index(row, 0);
+        chat_window_start_--;
+        BindChatRow(row, chat_records_[chat_window_start_]);
+    }
+    for (; count > 0; count--) {
+        lv_obj_t* row = chat_rows_.front();
+        chat_rows_.pop_front();
+        chat_rows_.push_back(row);
+        lv_obj_move_to_index(row, -1);
+        BindChatRow(row, chat_records_[chat_window_start_ + chat_rows_.size()]);
+        chat_window_start_++;
+    }
+    lv_obj_update_layout(content_);
+    lv_obj_scroll_to_y(content_, lv_obj_get_y(anchor) - anchor_offset, LV_ANIM_OFF);
+}
+
+void LcdDisplay::OnChatScroll(lv_event_code_t code) {
+    // 只处理用户触摸产生的滚动，忽略新消息触发的自动滚动
+    if (code == LV_EVENT_SCROLL_BEGIN) {
+        chat_user_scrolling_ = lv_indev_active() != nullptr;
+        return;
+    }
+    if (!chat_user_scrolling_) {
+        return;
+    }
+    chat_user_scrolling_ = false;
+
+    // 每次移动半个行池，锚点行始终保留在屏幕上
+    int step = std::max(1, (int)chat_rows_.size() / 2);
+    int32_t threshold = fonts_.text_font->line_height;
+    if (lv_obj_get_scroll_top(content_) <= threshold) {
+        ShiftChatWindow(-step);
+    } else if (lv_obj_get_scroll_bottom(content_) <= threshold) {
+        ShiftChatWindow(step);
+    }
+}
+
+void LcdDisplay::SetChatMessage(const char* role, const char* content) {
+    DisplayLockGuard lock(this);
+    if (content_ == nullptr || chat_rows_.empty()) {
+        return;
     }
     
-    // Create a full-width container for user messages to ensure right alignment
+    //避免出现空的消息框
+    if(strlen(content) == 0) return;
+
+    int64_t start_time = esp_timer_get_time();
+
+    // 正在翻看历史消息时，新消息到达先回到最新的位置
+    if (chat_window_start_ + GetBoundChatRowCount() != chat_records_.size()) {
+        if (image_bubble_ != nullptr) {
+            lv_obj_del(image_bubble_);
+            image_bubble_ = nullptr;
+        }
+        ShowLatestChatRecords();
+    }
+
+    const char* record_role = "assistant";
     if (strcmp(role, "user") == 0) {
-        // Create a full-width container
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // Make container transparent and borderless
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // Move the message bubble into this container
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // Right align the bubble in the container
-        lv_obj_align(msg_bubble, LV_ALIGN_RIGHT_MID, -25, 0);
-        
-        // Auto-scroll to this container
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
+        record_role = "user";
     } else if (strcmp(role, "system") == 0) {
-        // 为系统消息创建全宽容器以确保居中对齐
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // 使容器透明且无边框
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // 将消息气泡移入此容器
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // 将气泡居中对齐在容器中
-        lv_obj_align(msg_bubble, LV_ALIGN_CENTER, 0, 0);
-        
-        // 自动滚动底部
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else {
-        // For assistant messages
-        // Left align assistant messages
-        lv_obj_align(msg_bubble, LV_ALIGN_LEFT_MID, 0, 0);
+        record_role = "system";
+    }
 
-        // Auto-scroll to the message bubble
-        lv_obj_scroll_to_view_recursive(msg_bubble, LV_ANIM_ON);
+    // 折叠系统消息（如果最后一条消息也是系统消息且中间没有图片，则直接替换它）
+    lv_obj_t* row = nullptr;
+    bool image_is_last = image_bubble_ != nullptr && messages_since_image_ == 0;
+    if (strcmp(record_role, "system") == 0 && !chat_records_.empty() && !image_is_last &&
+        strcmp(chat_records_.back().role, "system") == 0) {
+        chat_records_.back().content = content;
+        row = chat_rows_.back();
+    } else {
+        if (chat_records_.size() >= MAX_MESSAGES) {
+            chat_records_.pop_front();
+        }
+        chat_records_.push_back(ChatRecord{record_role, content});
+        chat_window_start_ = chat_records_.size() - GetBoundChatRowCount();
+
+        // 复用最早的一行，并移动到列表末尾
+        row = chat_rows_.front();
+        chat_rows_.pop_front();
+        chat_rows_.push_back(row);
+        lv_obj_move_to_index(row, -1);
+
+        // 图片预览已经滚出消息行池的范围，删除它
+        if (image_bubble_ != nullptr && ++messages_since_image_ >= (int)chat_rows_.size()) {
+            lv_obj_del(image_bubble_);
+            image_bubble_ = nullptr;
+        }
     }
-    
+    BindChatRow(row, chat_records_.back());
+
+    // Auto-scroll to the message, only the pooled rows are laid out
+    lv_obj_update_layout(content_);
+    lv_obj_scroll_to_view(row, LV_ANIM_ON);
+
     // Store reference to the latest message label
-    chat_message_label_ = msg_text;
+    chat_message_label_ = lv_obj_get_child(lv_obj_get_child(row, 0), 0);
+
+    // 布局耗时在这里统计，渲染耗时由 LV_EVENT_RENDER_START/READY 统计
+    chat_message_count_++;
+    chat_layout_time_us_ += esp_timer_get_time() - start_time;
+    chat_render_pending_ = true;
+    if (chat_message_count_ == 10 || chat_message_count_ == 100 || chat_message_count_ == 1000) {
+        ESP_LOGI(TAG, "Chat messages: %lu, rows: %d, average bind + layout: %lldus, render: %lldus", chat_message_count_,
+            (int)chat_rows_.size(), chat_layout_time_us_ / chat_message_count_,
+            chat_render_count_ > 0 ? chat_render_time_us_ / chat_render_count_ : 0LL);
+    }
 }
 
 void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
@@ -608,6 +687,16 @@ void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
     }
     
     if (img_dsc != nullptr) {
+        // 只保留最新的一张图片预览
+        if (image_bubble_ != nullptr) {
+            lv_obj_del(image_bubble_);
+            image_bubble_ = nullptr;
+        }
+        // 图片总是跟在最新的消息后面
+        if (chat_window_start_ + GetBoundChatRowCount() != chat_records_.size()) {
+            ShowLatestChatRecords();
+        }
+
         // Create a message bubble for image preview
         lv_obj_t* img_bubble = lv_obj_create(content_);
         lv_obj_set_style_radius(img_bubble, 8, 0);
@@ -653,24 +742,10 @@ void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
         memcpy(copied_data, img_dsc->data, img_dsc->data_size);
         copied_img_dsc->data = copied_data;
         
-        // Calculate appropriate size for the image
-        lv_coord_t max_width = LV_HOR_RES * 70 / 100;  // 70% of screen width
-        lv_coord_t max_height = LV_VER_RES * 50 / 100; // 50% of screen height
-        
-        // Calculate zoom factor to fit within maximum dimensions
+        // 图片已按 GetPreviewImageSize() 的尺寸生成，原样显示，重绘时不需要缩放
         lv_coord_t img_width = copied_img_dsc->header.w;
         lv_coord_t img_height = copied_img_dsc->header.h;
-        
-        lv_coord_t zoom_w = (max_width * 256) / img_width;
-        lv_coord_t zoom_h = (max_height * 256) / img_height;
-        lv_coord_t zoom = (zoom_w < zoom_h) ? zoom_w : zoom_h;
-        
-        // Ensure zoom doesn't exceed 256 (100%)
-        if (zoom > 256) zoom = 256;
-        
-        // Set image properties
         lv_image_set_src(preview_image, copied_img_dsc);
-        lv_image_set_scale(preview_image, zoom);
         
         // Add event handler to clean up copied data when image is deleted
         lv_obj_add_event_cb(preview_image, [](lv_event_t* e) {
@@ -681,13 +756,9 @@ void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
             }
         }, LV_EVENT_DELETE, (void*)copied_img_dsc);
         
-        // Calculate actual scaled image dimensions
-        lv_coord_t scaled_width = (img_width * zoom) / 256;
-        lv_coord_t scaled_height = (img_height * zoom) / 256;
-        
         // Set bubble size to be 16 pixels larger than the image (8 pixels on each side)
-        lv_obj_set_width(img_bubble, scaled_width + 16);
-        lv_obj_set_height(img_bubble, scaled_height + 16);
+        lv_obj_set_width(img_bubble, img_width + 16);
+        lv_obj_set_height(img_bubble, img_height + 16);
         
         // Don't grow in flex layout
         lv_obj_set_style_flex_grow(img_bubble, 0, 0);
@@ -698,10 +769,19 @@ void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
         // Left align the image bubble like assistant messages
         lv_obj_align(img_bubble, LV_ALIGN_LEFT_MID, 0, 0);
 
+        image_bubble_ = img_bubble;
+        messages_since_image_ = 0;
+
         // Auto-scroll to the image bubble
-        lv_obj_scroll_to_view_recursive(img_bubble, LV_ANIM_ON);
+        lv_obj_scroll_to_view(img_bubble, LV_ANIM_ON);
     }
 }
+
+void LcdDisplay::GetPreviewImageSize(int& width, int& height) {
+    // 气泡最大为屏幕宽度的 70%、高度的 50%
+    width = LV_HOR_RES * 70 / 100;
+    height = LV_VER_RES * 50 / 100;
+}
 #else
 void LcdDisplay::SetupUI() {
     DisplayLockGuard lock(this);
@@ -749,6 +829,8 @@ void LcdDisplay::SetupUI() {
     preview_image_ = lv_image_create(content_);
     lv_obj_set_size(preview_image_, width_ * 0.5, height_ * 0.5);
     lv_obj_align(preview_image_, LV_ALIGN_CENTER, 0, 0);
+    // 按比例完整显示时图片可能小于预览区域，居中显示而不缩放
+    lv_image_set_inner_align(preview_image_, LV_IMAGE_ALIGN_CENTER);
     lv_obj_add_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
 
     chat_message_label_ = lv_label_create(content_);
@@ -814,9 +896,7 @@ void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
     }
     
     if (img_dsc != nullptr) {
-        // zoom factor 0.5
-        lv_image_set_scale(preview_image_, 128 * width_ / img_dsc->header.w);
-        // 设置图片源并显示预览图片
+        // 图片已按 GetPreviewImageSize() 的尺寸生成，原样居中显示
         lv_image_set_src(preview_image_, img_dsc);
         lv_obj_clear_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
         // 隐藏emotion_label_
@@ -831,6 +911,12 @@ void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
         }
     }
 }
+
+void LcdDisplay::GetPreviewImageSize(int& width, int& height) {
+    // 与 SetupUI() 中 preview_image_ 的大小一致
+    width = width_ / 2;
+    height = height_ / 2;
+}
 #endif
 
 void LcdDisplay::SetEmotion(const char* emotion) {
@@ -874,11 +960,13 @@ void LcdDisplay::SetEmotion(const char* emotion) {
     }
 
     // 如果找到匹配的表情就显示对应图标，否则显示默认的neutral表情
-    lv_obj_set_style_text_font(emotion_label_, fonts_.emoji_font, 0);
+    if (lv_obj_get_style_text_font(emotion_label_, 0) != fonts_.emoji_font) {
+        lv_obj_set_style_text_font(emotion_label_, fonts_.emoji_font, 0);
+    }
     if (it != emotions.end()) {
-        lv_label_set_text(emotion_label_, it->icon);
+        SetLabelText(emotion_label_, it->icon);
     } else {
-        lv_label_set_text(emotion_label_, "😶");
+        SetLabelText(emotion_label_, "😶");
     }
 
 #if !CONFIG_USE_WECHAT_MESSAGE_STYLE
@@ -895,8 +983,10 @@ void LcdDisplay::SetIcon(const char* icon) {
     if (emotion_label_ == nullptr) {
         return;
     }
-    lv_obj_set_style_text_font(emotion_label_, &font_awesome_30_4, 0);
-    lv_label_set_text(emotion_label_, icon);
+    if (lv_obj_get_style_text_font(emotion_label_, 0) != &font_awesome_30_4) {
+        lv_obj_set_style_text_font(emotion_label_, &font_awesome_30_4, 0);
+    }
+    SetLabelText(emotion_label_, icon);
 
 #if !CONFIG_USE_WECHAT_MESSAGE_STYLE
     // 显示emotion_label_，隐藏preview_image_
@@ -8,6 +8,13 @@
 #include <font_emoji.h>
 
 #include <atomic>
+#include <deque>
+#include <string>
+#include <memory>
+
+#if CONFIG_USE_FONT_PARTITION
+#include "partition_font.h"
+#endif
 
 // Theme color structure
 struct ThemeColors {
@@ -35,10 +42,37 @@ protected:
     lv_obj_t* side_bar_ = nullptr;
     lv_obj_t* preview_image_ = nullptr;
 
+    // 微信风格聊天界面：消息记录环形缓冲 + 复用的消息行池
+    struct ChatRecord {
+        const char* role;  // "user" / "assistant" / "system"
+        std::string content;
+    };
+    std::deque<ChatRecord> chat_records_;
+    std::deque<lv_obj_t*> chat_rows_;   // 按显示顺序排列，未绑定的隐藏行在最前面
+    size_t chat_window_start_ = 0;      // 第一个已绑定行对应的记录序号
+    bool chat_user_scrolling_ = false;
+    lv_obj_t* image_bubble_ = nullptr;
+    int messages_since_image_ = 0;
+    uint32_t chat_message_count_ = 0;
+    int64_t chat_layout_time_us_ = 0;
+    uint32_t chat_render_count_ = 0;
+    int64_t chat_render_time_us_ = 0;
+    int64_t chat_render_start_us_ = 0;
+    bool chat_render_pending_ = false;
+
     DisplayFonts fonts_;
     ThemeColors current_theme_;
+#if CONFIG_USE_FONT_PARTITION
+    std::unique_ptr<PartitionFont> partition_text_font_;
+    std::unique_ptr<PartitionFont> partition_icon_font_;
+#endif
 
     void SetupUI();
+    void BindChatRow(lv_obj_t* row, const ChatRecord& record);
+    size_t GetBoundChatRowCount() const;
+    void ShowLatestChatRecords();
+    void ShiftChatWindow(int count);
+    void OnChatScroll(lv_event_code_t code);
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
 
@@ -51,6 +85,7 @@ public:
     virtual void SetEmotion(const char* emotion) override;
     virtual void SetIcon(const char* icon) override;
     virtual void SetPreviewImage(const lv_img_dsc_t* img_dsc) override;
+    virtual void GetPreviewImageSize(int& width, int& height) override;
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
     virtual void SetChatMessage(const char* role, const char* content) override; 
 #endif  
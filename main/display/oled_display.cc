@@ -32,7 +32,11 @@ OledDisplay::OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handl
         .panel_handle = panel_,
         .control_handle = nullptr,
         .buffer_size = static_cast<uint32_t>(width_ * height_),
+#if CONFIG_DISPLAY_DOUBLE_BUFFER
+        .double_buffer = true,
+#else
         .double_buffer = false,
+#endif
         .trans_size = 0,
         .hres = static_cast<uint32_t>(width_),
         .vres = static_cast<uint32_t>(height_),
@@ -57,6 +61,9 @@ OledDisplay::OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handl
         return;
     }
 
+    // esp_lvgl_port 对单色屏使用 FULL 渲染模式，每次都刷新整屏，不需要按页对齐脏区域
+    SetupFlushTracking(1);
+
     if (height_ == 64) {
         SetupUI_128x64();
     } else {
@@ -0,0 +1,356 @@
+#include "partition_font.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <cstring>
+
+#define TAG "PartitionFont"
+
+// 字体分区目录：magic + 字体数量 + 若干 {名称, 偏移, 大小}
+#define FONT_PARTITION_MAGIC "XZFP"
+#define FONT_PARTITION_NAME_LENGTH 32
+
+template <typename T>
+static inline T ReadValue(const uint8_t* p) {
+    T value;
+    memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+// LVGL 二进制字体的字形数据按位紧密排列，高位在前
+class BitReader {
+public:
+    BitReader(const uint8_t* data, uint32_t bit_offset) : data_(data), bit_offset_(bit_offset) {}
+
+    uint32_t Read(int bits) {
+        uint32_t value = 0;
+        for (int i = 0; i < bits; i++) {
+            uint8_t byte = data_[bit_offset_ >> 3];
+            value = (value << 1) | ((byte >> (7 - (bit_offset_ & 7))) & 1);
+            bit_offset_++;
+        }
+        return value;
+    }
+
+    int32_t ReadSigned(int bits) {
+        uint32_t value = Read(bits);
+        if (bits > 0 && (value & (1u << (bits - 1)))) {
+            value |= ~0u << bits;
+        }
+        return (int32_t)value;
+    }
+
+    uint32_t offset() const { return bit_offset_; }
+
+private:
+    const uint8_t* data_;
+    uint32_t bit_offset_;
+};
+
+static const uint8_t* MapFontPartition(size_t* size) {
+    static const uint8_t* mapped_data = nullptr;
+    static size_t mapped_size = 0;
+    static bool tried = false;
+    if (tried) {
+        *size = mapped_size;
+        return mapped_data;
+    }
+    tried = true;
+
+    auto partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, CONFIG_FONT_PARTITION_LABEL);
+    if (partition == nullptr) {
+        ESP_LOGW(TAG, "Font partition %s not found", CONFIG_FONT_PARTITION_LABEL);
+        return nullptr;
+    }
+
+    const void* data = nullptr;
+    esp_partition_mmap_handle_t mmap_handle;
+    esp_err_t err = esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &data, &mmap_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to map font partition: %s", esp_err_to_name(err));
+        return nullptr;
+    }
+    if (memcmp(data, FONT_PARTITION_MAGIC, 4) != 0) {
+        ESP_LOGW(TAG, "Font partition %s is empty", CONFIG_FONT_PARTITION_LABEL);
+        esp_partition_munmap(mmap_handle);
+        return nullptr;
+    }
+
+    mapped_data = static_cast<const uint8_t*>(data);
+    mapped_size = partition->size;
+    *size = mapped_size;
+    return mapped_data;
+}
+
+PartitionFont* PartitionFont::Load(const char* name, size_t cache_size) {
+    size_t partition_size = 0;
+    const uint8_t* partition = MapFontPartition(&partition_size);
+    if (partition == nullptr) {
+        return nullptr;
+    }
+
+    uint32_t count = ReadValue<uint32_t>(partition + 4);
+    const uint8_t* entry = partition + 8;
+    const size_t entry_size = FONT_PARTITION_NAME_LENGTH + 8;
+    for (uint32_t i = 0; i < count && entry + entry_size <= partition + partition_size; i++, entry += entry_size) {
+        if (strncmp((const char*)entry, name, FONT_PARTITION_NAME_LENGTH) != 0) {
+            continue;
+        }
+        uint32_t offset = ReadValue<uint32_t>(entry + FONT_PARTITION_NAME_LENGTH);
+        uint32_t size = ReadValue<uint32_t>(entry + FONT_PARTITION_NAME_LENGTH + 4);
+        if (offset + size > partition_size) {
+            ESP_LOGE(TAG, "Font %s is out of the partition", name);
+            return nullptr;
+        }
+
+        auto font = new PartitionFont(name, partition + offset, size, cache_size);
+        if (!font->Parse()) {
+            delete font;
+            return nullptr;
+        }
+        ESP_LOGI(TAG, "Loaded font %s, %lu glyphs, line height %ld, cache %u bytes", name,
+            font->loca_count_, font->font_.line_height, cache_size);
+        return font;
+    }
+    ESP_LOGW(TAG, "Font %s not found in partition", name);
+    return nullptr;
+}
+
+PartitionFont::PartitionFont(const std::string& name, const uint8_t* data, size_t size, size_t cache_size)
+    : name_(name), data_(data), size_(size), cache_size_(cache_size) {
+}
+
+PartitionFont::~PartitionFont() {
+    for (auto& glyph : lru_) {
+        heap_caps_free(glyph.bitmap);
+    }
+}
+
+bool PartitionFont::Parse() {
+    // 依次查找 head / cmap / loca / glyf 表
+    const uint8_t* p = data_;
+    while (p + 8 <= data_ + size_) {
+        uint32_t length = ReadValue<uint32_t>(p);
+        if (length < 8 || p + length > data_ + size_) {
+            break;
+        }
+        if (memcmp(p + 4, "head", 4) == 0) {
+            head_ = p + 8;
+        } else if (memcmp(p + 4, "cmap", 4) == 0) {
+            cmap_ = p;
+            cmap_count_ = ReadValue<uint32_t>(p + 8);
+        } else if (memcmp(p + 4, "loca", 4) == 0) {
+            loca_ = p;
+            loca_count_ = ReadValue<uint32_t>(p + 8);
+        } else if (memcmp(p + 4, "glyf", 4) == 0) {
+            glyf_ = p;
+        }
+        p += length;
+    }
+    if (head_ == nullptr || cmap_ == nullptr || loca_ == nullptr || glyf_ == nullptr) {
+        ESP_LOGE(TAG, "Font %s is missing tables", name_.c_str());
+        return false;
+    }
+
+    uint8_t compression_id = head_[33];
+    bpp_ = head_[29];
+    if (compression_id != 0) {
+        ESP_LOGE(TAG, "Font %s is compressed, rebuild it with --no-compress", name_.c_str());
+        return false;
+    }
+    if (bpp_ != 1 && bpp_ != 2 && bpp_ != 4 && bpp_ != 8) {
+        ESP_LOGE(TAG, "Font %s has unsupported bpp %d", name_.c_str(), bpp_);
+        return false;
+    }
+
+    uint16_t ascent = ReadValue<uint16_t>(head_ + 8);
+    int16_t descent = ReadValue<int16_t>(head_ + 10);
+    font_.get_glyph_dsc = GetGlyphDsc;
+    font_.get_glyph_bitmap = GetGlyphBitmap;
+    font_.line_height = ascent - descent;
+    font_.base_line = -descent;
+    font_.subpx = LV_FONT_SUBPX_NONE;
+    font_.underline_position = ReadValue<int16_t>(head_ + 36);
+    font_.underline_thickness = ReadValue<uint16_t>(head_ + 38);
+    font_.user_data = this;
+    return true;
+}
+
+uint32_t PartitionFont::FindGlyphId(uint32_t letter) const {
+    for (uint32_t i = 0; i < cmap_count_; i++) {
+        const uint8_t* subtable = cmap_ + 12 + i * 16;
+        uint32_t data_offset = ReadValue<uint32_t>(subtable);
+        uint32_t range_start = ReadValue<uint32_t>(subtable + 4);
+        uint16_t range_length = ReadValue<uint16_t>(subtable + 8);
+        uint16_t glyph_id_start = ReadValue<uint16_t>(subtable + 10);
+        uint16_t entries_count = ReadValue<uint16_t>(subtable + 12);
+        uint8_t format = subtable[14];
+
+        uint32_t rcp = letter - range_start;
+        if (letter < range_start || rcp >= range_length) {
+            continue;
+        }
+
+        const uint8_t* data = cmap_ + data_offset;
+        switch (format) {
+            case LV_FONT_FMT_TXT_CMAP_FORMAT0_TINY:
+                return glyph_id_start + rcp;
+            case LV_FONT_FMT_TXT_CMAP_FORMAT0_FULL:
+                return glyph_id_start + data[rcp];
+            case LV_FONT_FMT_TXT_CMAP_SPARSE_TINY:
+            case LV_FONT_FMT_TXT_CMAP_SPARSE_FULL: {
+                // unicode_list 按升序排列
+                int low = 0, high = entries_count - 1;
+                while (low <= high) {
+                    int mid = (low + high) / 2;
+                    uint16_t value = ReadValue<uint16_t>(data + mid * 2);
+                    if (value == rcp) {
+                        if (format == LV_FONT_FMT_TXT_CMAP_SPARSE_TINY) {
+                            return glyph_id_start + mid;
+                        }
+                        return glyph_id_start + ReadValue<uint16_t>(data + entries_count * 2 + mid * 2);
+                    } else if (value < rcp) {
+                        low = mid + 1;
+                    } else {
+                        high = mid - 1;
+                    }
+                }
+                return 0;
+            }
+            default:
+                return 0;
+        }
+    }
+    return 0;
+}
+
+PartitionFont::GlyphHeader PartitionFont::ReadGlyphHeader(uint32_t gid) const {
+    uint8_t index_to_loc_format = head_[26];
+    uint8_t advance_width_format = head_[28];
+    uint8_t xy_bits = head_[30];
+    uint8_t wh_bits = head_[31];
+    uint8_t advance_width_bits = head_[32];
+
+    uint32_t offset = index_to_loc_format == 0 ? ReadValue<uint16_t>(loca_ + 12 + gid * 2)
+        : ReadValue<uint32_t>(loca_ + 12 + gid * 4);
+    BitReader reader(glyf_ + offset, 0);
+
+    GlyphHeader header;
+    if (advance_width_bits == 0) {
+        header.adv_w = ReadValue<uint16_t>(head_ + 22);
+    } else {
+        header.adv_w = reader.Read(advance_width_bits);
+    }
+    // advance_width_format 为 0 时是整数像素，否则是 1/16 像素
+    if (advance_width_format == 0) {
+        header.adv_w *= 16;
+    }
+    header.ofs_x = reader.ReadSigned(xy_bits);
+    header.ofs_y = reader.ReadSigned(xy_bits);
+    header.box_w = reader.Read(wh_bits);
+    header.box_h = reader.Read(wh_bits);
+    header.bitmap_bit_offset = (offset << 3) + reader.offset();
+    return header;
+}
+
+void PartitionFont::Evict(size_t required_size) {
+    while (!lru_.empty() && statistics_.cached_bytes + required_size > cache_size_) {
+        auto& glyph = lru_.back();
+        statistics_.cached_bytes -= glyph.size;
+        statistics_.evict_count++;
+        heap_caps_free(glyph.bitmap);
+        cache_.erase(glyph.gid);
+        lru_.pop_back();
+    }
+}
+
+const PartitionFont::CachedGlyph* PartitionFont::GetCachedGlyph(uint32_t gid, const GlyphHeader& header) {
+    auto it = cache_.find(gid);
+    if (it != cache_.end()) {
+        statistics_.hit_count++;
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return &lru_.front();
+    }
+
+    statistics_.miss_count++;
+    int64_t start_time = esp_timer_get_time();
+    size_t size = header.box_w * header.box_h;
+    Evict(size);
+    auto bitmap = (uint8_t*)heap_caps_malloc_prefer(size, 2, MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+    if (bitmap == nullptr) {
+        return nullptr;
+    }
+
+    // 解码为 A8，命中缓存时只需按行拷贝
+    BitReader reader(glyf_, header.bitmap_bit_offset);
+    for (size_t i = 0; i < size; i++) {
+        uint32_t value = reader.Read(bpp_);
+        switch (bpp_) {
+            case 1: bitmap[i] = value ? 0xFF : 0; break;
+            case 2: bitmap[i] = value * 85; break;
+            case 4: bitmap[i] = value * 17; break;
+            default: bitmap[i] = value; break;
+        }
+    }
+
+    lru_.push_front(CachedGlyph{gid, bitmap, size});
+    cache_[gid] = lru_.begin();
+    statistics_.cached_bytes += size;
+    statistics_.decode_time_us += esp_timer_get_time() - start_time;
+
+    if (statistics_.miss_count % 500 == 0) {
+        uint32_t total = statistics_.hit_count + statistics_.miss_count;
+        ESP_LOGI(TAG, "Font %s: hit rate %lu%%, cached %lu bytes in %u glyphs, avg decode %lldus, avg render %lldus",
+            name_.c_str(), statistics_.hit_count * 100 / total, statistics_.cached_bytes, lru_.size(),
+            statistics_.decode_time_us / statistics_.miss_count, statistics_.render_time_us / total);
+    }
+    return &lru_.front();
+}
+
+bool PartitionFont::GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc_out, uint32_t letter, uint32_t letter_next) {
+    auto self = static_cast<PartitionFont*>(font->user_data);
+    if (letter == '\t') {
+        letter = ' ';
+    }
+    uint32_t gid = self->FindGlyphId(letter);
+    if (gid == 0 || gid >= self->loca_count_) {
+        return false;
+    }
+
+    auto header = self->ReadGlyphHeader(gid);
+    dsc_out->adv_w = (header.adv_w + 8) >> 4;
+    dsc_out->box_w = header.box_w;
+    dsc_out->box_h = header.box_h;
+    dsc_out->ofs_x = header.ofs_x;
+    dsc_out->ofs_y = header.ofs_y;
+    dsc_out->format = LV_FONT_GLYPH_FORMAT_A8;
+    dsc_out->is_placeholder = false;
+    dsc_out->gid.index = gid;
+    return true;
+}
+
+const void* PartitionFont::GetGlyphBitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf) {
+    auto self = static_cast<PartitionFont*>(g_dsc->resolved_font->user_data);
+    uint32_t gid = g_dsc->gid.index;
+    if (gid == 0 || draw_buf == nullptr) {
+        return nullptr;
+    }
+
+    int64_t start_time = esp_timer_get_time();
+    auto header = self->ReadGlyphHeader(gid);
+    if (header.box_w == 0 || header.box_h == 0) {
+        return nullptr;
+    }
+    auto glyph = self->GetCachedGlyph(gid, header);
+    if (glyph == nullptr) {
+        return nullptr;
+    }
+
+    uint32_t stride = draw_buf->header.stride;
+    for (uint16_t y = 0; y < header.box_h; y++) {
+        memcpy(draw_buf->data + y * stride, glyph->bitmap + y * header.box_w, header.box_w);
+    }
+    self->statistics_.render_time_us += esp_timer_get_time() - start_time;
+    return draw_buf;
+}
@@ -0,0 +1,86 @@
+#ifndef PARTITION_FONT_H
+#define PARTITION_FONT_H
+
+#include <lvgl.h>
+#include <esp_partition.h>
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <memory>
+
+/*
+ * Font loaded on demand from a memory-mapped font partition
+ *
+ * The partition holds LVGL binary fonts (lv_font_conv --format bin --no-compress),
+ * packed by scripts/build_font_partition.py. Only the font tables are parsed at load
+ * time, glyph bitmaps stay in flash and are expanded into an LRU cache on first use.
+ */
+
+struct PartitionFontStatistics {
+    uint32_t hit_count = 0;
+    uint32_t miss_count = 0;
+    uint32_t evict_count = 0;
+    uint32_t cached_bytes = 0;
+    int64_t decode_time_us = 0;
+    int64_t render_time_us = 0;
+};
+
+class PartitionFont {
+public:
+    // Returns nullptr if the partition or the font does not exist
+    static PartitionFont* Load(const char* name, size_t cache_size);
+
+    ~PartitionFont();
+
+    const lv_font_t* font() const { return &font_; }
+    const std::string& name() const { return name_; }
+    PartitionFontStatistics GetStatistics() const { return statistics_; }
+
+private:
+    struct GlyphHeader {
+        uint32_t adv_w;
+        int16_t ofs_x;
+        int16_t ofs_y;
+        uint16_t box_w;
+        uint16_t box_h;
+        uint32_t bitmap_bit_offset;
+    };
+
+    struct CachedGlyph {
+        uint32_t gid;
+        uint8_t* bitmap;
+        size_t size;
+    };
+
+    std::string name_;
+    lv_font_t font_ = {};
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+
+    // Font tables, pointing into the mapped partition
+    const uint8_t* head_ = nullptr;
+    const uint8_t* cmap_ = nullptr;
+    const uint8_t* loca_ = nullptr;
+    const uint8_t* glyf_ = nullptr;
+    uint32_t cmap_count_ = 0;
+    uint32_t loca_count_ = 0;
+    uint8_t bpp_ = 4;
+
+    size_t cache_size_;
+    std::list<CachedGlyph> lru_;
+    std::unordered_map<uint32_t, std::list<CachedGlyph>::iterator> cache_;
+    PartitionFontStatistics statistics_;
+
+    PartitionFont(const std::string& name, const uint8_t* data, size_t size, size_t cache_size);
+    bool Parse();
+    uint32_t FindGlyphId(uint32_t letter) const;
+    GlyphHeader ReadGlyphHeader(uint32_t gid) const;
+    const CachedGlyph* GetCachedGlyph(uint32_t gid, const GlyphHeader& header);
+    void Evict(size_t required_size);
+
+    static bool GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc_out, uint32_t letter, uint32_t letter_next);
+    static const void* GetGlyphBitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf);
+};
+
+#endif // PARTITION_FONT_H
@@ -4,14 +4,24 @@
 
 #define TAG "CircularStrip"
 
-#define BLINK_INFINITE -1
+#if CONFIG_LED_STRIP_VU_METER
+static uint8_t GetInputLevel() {
+    return Application::GetInstance().GetAudioService().GetInputLevel();
+}
+
+static uint8_t GetOutputLevel() {
+    return Application::GetInstance().GetAudioService().GetOutputLevel();
+}
+#endif
 
-CircularStrip::CircularStrip(gpio_num_t gpio, uint8_t max_leds) : max_leds_(max_leds) {
+static uint32_t NowMs() {
+    return esp_timer_get_time() / 1000;
+}
+
+CircularStrip::CircularStrip(gpio_num_t gpio, uint8_t max_leds) : max_leds_(max_leds), compositor_(max_leds) {
     // If the gpio is not connected, you should use NoLed class
     assert(gpio != GPIO_NUM_NC);
 
-    colors_.resize(max_leds_);
-
     led_strip_config_t strip_config = {};
     strip_config.strip_gpio_num = gpio;
     strip_config.max_leds = max_leds_;
@@ -24,156 +34,102 @@ CircularStrip::CircularStrip(gpio_num_t gpio, uint8_t max_leds) : max_leds_(max_
     ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip_));
     led_strip_clear(led_strip_);
 
+#ifdef CONFIG_LED_STRIP_GAMMA
+    compositor_.SetGamma(CONFIG_LED_STRIP_GAMMA / 10.0f);
+#endif
+
     esp_timer_create_args_t strip_timer_args = {
         .callback = [](void *arg) {
             auto strip = static_cast<CircularStrip*>(arg);
             std::lock_guard<std::mutex> lock(strip->mutex_);
-            if (strip->strip_callback_ != nullptr) {
-                strip->strip_callback_();
-            }
+            strip->RenderFrame();
         },
         .arg = this,
         .dispatch_method = ESP_TIMER_TASK,
         .name = "strip_timer",
-        .skip_unhandled_events = false,
+        .skip_unhandled_events = true,
     };
     ESP_ERROR_CHECK(esp_timer_create(&strip_timer_args, &strip_timer_));
 }
 
 CircularStrip::~CircularStrip() {
     esp_timer_stop(strip_timer_);
+    esp_timer_delete(strip_timer_);
     if (led_strip_ != nullptr) {
         led_strip_del(led_strip_);
     }
 }
 
+// Called with mutex_ held
+void CircularStrip::RenderFrame() {
+    // 只有画面变化时才写入灯带
+    if (compositor_.Compose(NowMs())) {
+        auto& output = compositor_.output();
+        for (int i = 0; i < max_leds_; i++) {
+            led_strip_set_pixel(led_strip_, i, output[i].red, output[i].green, output[i].blue);
+        }
+        led_strip_refresh(led_strip_);
+    }
 
-void CircularStrip::SetAllColor(StripColor color) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
-    for (int i = 0; i < max_leds_; i++) {
-        colors_[i] = color;
-        led_strip_set_pixel(led_strip_, i, color.red, color.green, color.blue);
+    // 静态画面停止定时器，动画按最快的一层的帧间隔刷新
+    uint32_t interval = compositor_.frame_interval_ms();
+    if (interval != frame_interval_ms_) {
+        esp_timer_stop(strip_timer_);
+        frame_interval_ms_ = interval;
+        if (interval > 0) {
+            esp_timer_start_periodic(strip_timer_, interval * 1000);
+        }
     }
-    led_strip_refresh(led_strip_);
 }
 
-void CircularStrip::SetSingleColor(uint8_t index, StripColor color) {
+void CircularStrip::SetEffect(std::unique_ptr<LedEffect> effect, std::unique_ptr<LedEffect> overlay) {
+    if (led_strip_ == nullptr) {
+        return;
+    }
+
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
-    colors_[index] = color;
-    led_strip_set_pixel(led_strip_, index, color.red, color.green, color.blue);
-    led_strip_refresh(led_strip_);
+    uint32_t now = NowMs();
+    compositor_.SetLayer(0, std::move(effect), now);
+    compositor_.SetLayer(1, std::move(overlay), now);
+    RenderFrame();
 }
 
-void CircularStrip::Blink(StripColor color, int interval_ms) {
-    for (int i = 0; i < max_leds_; i++) {
-        colors_[i] = color;
-    }
-    StartStripTask(interval_ms, [this]() {
-        static bool on = true;
-        if (on) {
-            for (int i = 0; i < max_leds_; i++) {
-                led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
-            }
-            led_strip_refresh(led_strip_);
-        } else {
-            led_strip_clear(led_strip_);
-        }
-        on = !on;
-    });
+void CircularStrip::SetAllColor(StripColor color) {
+    SetEffect(std::make_unique<SolidEffect>(max_leds_, color));
 }
 
-void CircularStrip::FadeOut(int interval_ms) {
-    StartStripTask(interval_ms, [this]() {
-        bool all_off = true;
-        for (int i = 0; i < max_leds_; i++) {
-            colors_[i].red /= 2;
-            colors_[i].green /= 2;
-            colors_[i].blue /= 2;
-            if (colors_[i].red != 0 || colors_[i].green != 0 || colors_[i].blue != 0) {
-                all_off = false;
-            }
-            led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
-        }
-        if (all_off) {
-            led_strip_clear(led_strip_);
-            esp_timer_stop(strip_timer_);
-        } else {
-            led_strip_refresh(led_strip_);
-        }
-    });
+void CircularStrip::SetSingleColor(uint8_t index, StripColor color) {
+    if (index >= max_leds_) {
+        return;
+    }
+    std::vector<StripColor> colors;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        colors = compositor_.frame();
+    }
+    colors[index] = color;
+    SetEffect(std::make_unique<SolidEffect>(std::move(colors)));
 }
 
-void CircularStrip::Breathe(StripColor low, StripColor high, int interval_ms) {
-    StartStripTask(interval_ms, [this, low, high]() {
-        static bool increase = true;
-        static StripColor color = low;
-        if (increase) {
-            if (color.red < high.red) {
-                color.red++;
-            }
-            if (color.green < high.green) {
-                color.green++;
-            }
-            if (color.blue < high.blue) {
-                color.blue++;
-            }
-            if (color.red == high.red && color.green == high.green && color.blue == high.blue) {
-                increase = false;
-            }
-        } else {
-            if (color.red > low.red) {
-                color.red--;
-            }
-            if (color.green > low.green) {
-                color.green--;
-            }
-            if (color.blue > low.blue) {
-                color.blue--;
-            }
-            if (color.red == low.red && color.green == low.green && color.blue == low.blue) {
-                increase = true;
-            }
-        }
-        for (int i = 0; i < max_leds_; i++) {
-            led_strip_set_pixel(led_strip_, i, color.red, color.green, color.blue);
-        }
-        led_strip_refresh(led_strip_);
-    });
+void CircularStrip::Blink(StripColor color, int interval_ms) {
+    SetEffect(std::make_unique<BlinkEffect>(std::vector<StripColor>(max_leds_, color), interval_ms));
 }
 
-void CircularStrip::Scroll(StripColor low, StripColor high, int length, int interval_ms) {
-    for (int i = 0; i < max_leds_; i++) {
-        colors_[i] = low;
+void CircularStrip::FadeOut(int interval_ms) {
+    std::vector<StripColor> colors;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        colors = compositor_.frame();
     }
-    StartStripTask(interval_ms, [this, low, high, length]() {
-        static int offset = 0;
-        for (int i = 0; i < max_leds_; i++) {
-            colors_[i] = low;
-        }
-        for (int j = 0; j < length; j++) {
-            int i = (offset + j) % max_leds_;
-            colors_[i] = high;
-        }
-        for (int i = 0; i < max_leds_; i++) {
-            led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
-        }
-        led_strip_refresh(led_strip_);
-        offset = (offset + 1) % max_leds_;
-    });
+    SetEffect(std::make_unique<FadeOutEffect>(std::move(colors), interval_ms));
 }
 
-void CircularStrip::StartStripTask(int interval_ms, std::function<void()> cb) {
-    if (led_strip_ == nullptr) {
-        return;
-    }
+void CircularStrip::Breathe(StripColor low, StripColor high, int interval_ms) {
+    SetEffect(std::make_unique<BreatheEffect>(low, high, interval_ms));
+}
 
-    std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
-    
-    strip_callback_ = cb;
-    esp_timer_start_periodic(strip_timer_, interval_ms * 1000);
+void CircularStrip::Scroll(StripColor low, StripColor high, int length, int interval_ms) {
+    SetEffect(std::make_unique<ScrollEffect>(low, high, length, interval_ms));
 }
 
 void CircularStrip::SetBrightness(uint8_t default_brightness, uint8_t low_brightness) {
@@ -208,12 +164,25 @@ void CircularStrip::OnStateChanged() {
         case kDeviceStateListening:
         case kDeviceStateAudioTesting: {
             StripColor color = { default_brightness_, low_brightness_, low_brightness_ };
+#if CONFIG_LED_STRIP_VU_METER
+            // 底色保持暗光，音量条按麦克风电平点亮
+            StripColor base = { low_brightness_, low_brightness_, low_brightness_ };
+            SetEffect(std::make_unique<SolidEffect>(max_leds_, base),
+                std::make_unique<VuMeterEffect>(GetInputLevel, color));
+#else
             SetAllColor(color);
+#endif
             break;
         }
         case kDeviceStateSpeaking: {
             StripColor color = { low_brightness_, default_brightness_, low_brightness_ };
+#if CONFIG_LED_STRIP_VU_METER
+            StripColor base = { low_brightness_, low_brightness_, low_brightness_ };
+            SetEffect(std::make_unique<SolidEffect>(max_leds_, base),
+                std::make_unique<VuMeterEffect>(GetOutputLevel, color));
+#else
             SetAllColor(color);
+#endif
             break;
         }
         case kDeviceStateUpgrading: {
@@ -23,6 +23,7 @@
 
 #define LEDC_DUTY              (8191)
 #define LEDC_FADE_TIME    (1000)
+#define LEDC_TRANSITION_TIME    (150)
 // GPIO_LED
 
 GpioLed::GpioLed(gpio_num_t gpio)
@@ -64,12 +65,6 @@ GpioLed::GpioLed(gpio_num_t gpio, int output_invert, ledc_timer_t timer_num, led
     // Initialize fade service.
     ledc_fade_func_install(0);
 
-    // When the callback registered by ledc_cb_degister is called, run led ->OnFadeEnd()
-    ledc_cbs_t ledc_callbacks = {
-        .fade_cb = FadeCallback
-    };
-    ledc_cb_register(ledc_channel_.speed_mode, ledc_channel_.channel, &ledc_callbacks, this);
-
     esp_timer_create_args_t blink_timer_args = {
         .callback = [](void *arg) {
             auto led = static_cast<GpioLed*>(arg);
@@ -82,11 +77,25 @@ GpioLed::GpioLed(gpio_num_t gpio, int output_invert, ledc_timer_t timer_num, led
     };
     ESP_ERROR_CHECK(esp_timer_create(&blink_timer_args, &blink_timer_));
 
+    // 呼吸效果由 LEDC 硬件渐变完成，定时器只在每次渐变结束时反转方向
+    esp_timer_create_args_t fade_timer_args = {
+        .callback = [](void *arg) {
+            auto led = static_cast<GpioLed*>(arg);
+            led->OnFadeTimer();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "Fade Timer",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&fade_timer_args, &fade_timer_));
+
     ledc_initialized_ = true;
 }
 
 GpioLed::~GpioLed() {
     esp_timer_stop(blink_timer_);
+    esp_timer_stop(fade_timer_);
     if (ledc_initialized_) {
         ledc_fade_stop(ledc_channel_.speed_mode, ledc_channel_.channel);
         ledc_fade_func_uninstall();
@@ -109,9 +118,8 @@ void GpioLed::TurnOn() {
 
     std::lock_guard<std::mutex> lock(mutex_);
     esp_timer_stop(blink_timer_);
-    ledc_fade_stop(ledc_channel_.speed_mode, ledc_channel_.channel);
-    ledc_set_duty(ledc_channel_.speed_mode, ledc_channel_.channel, duty_);
-    ledc_update_duty(ledc_channel_.speed_mode, ledc_channel_.channel);
+    esp_timer_stop(fade_timer_);
+    FadeTo(duty_, LEDC_TRANSITION_TIME);
 }
 
 void GpioLed::TurnOff() {
@@ -121,9 +129,8 @@ void GpioLed::TurnOff() {
 
     std::lock_guard<std::mutex> lock(mutex_);
     esp_timer_stop(blink_timer_);
-    ledc_fade_stop(ledc_channel_.speed_mode, ledc_channel_.channel);
-    ledc_set_duty(ledc_channel_.speed_mode, ledc_channel_.channel, 0);
-    ledc_update_duty(ledc_channel_.speed_mode, ledc_channel_.channel);
+    esp_timer_stop(fade_timer_);
+    FadeTo(0, LEDC_TRANSITION_TIME);
 }
 
 void GpioLed::BlinkOnce() {
@@ -145,6 +152,7 @@ void GpioLed::StartBlinkTask(int times, int interval_ms) {
 
     std::lock_guard<std::mutex> lock(mutex_);
     esp_timer_stop(blink_timer_);
+    esp_timer_stop(fade_timer_);
     ledc_fade_stop(ledc_channel_.speed_mode, ledc_channel_.channel);
 
     blink_counter_ = times * 2;
@@ -167,6 +175,16 @@ void GpioLed::OnBlinkTimer() {
     ledc_update_duty(ledc_channel_.speed_mode, ledc_channel_.channel);
 }
 
+// Called with mutex_ held
+void GpioLed::FadeTo(uint32_t duty, int fade_time_ms) {
+    ledc_fade_stop(ledc_channel_.speed_mode, ledc_channel_.channel);
+    if (ledc_get_duty(ledc_channel_.speed_mode, ledc_channel_.channel) == duty) {
+        return;
+    }
+    ledc_set_fade_time_and_start(ledc_channel_.speed_mode, ledc_channel_.channel,
+                                 duty, fade_time_ms, LEDC_FADE_NO_WAIT);
+}
+
 void GpioLed::StartFadeTask() {
     if (!ledc_initialized_) {
         return;
@@ -174,29 +192,16 @@ void GpioLed::StartFadeTask() {
 
     std::lock_guard<std::mutex> lock(mutex_);
     esp_timer_stop(blink_timer_);
-    ledc_fade_stop(ledc_channel_.speed_mode, ledc_channel_.channel);
+    esp_timer_stop(fade_timer_);
     fade_up_ = true;
-    ledc_set_fade_with_time(ledc_channel_.speed_mode,
-                            ledc_channel_.channel, LEDC_DUTY, LEDC_FADE_TIME);
-    ledc_fade_start(ledc_channel_.speed_mode,
-                    ledc_channel_.channel, LEDC_FADE_NO_WAIT);
+    FadeTo(duty_, LEDC_FADE_TIME);
+    esp_timer_start_periodic(fade_timer_, LEDC_FADE_TIME * 1000);
 }
 
-void GpioLed::OnFadeEnd() {
+void GpioLed::OnFadeTimer() {
     std::lock_guard<std::mutex> lock(mutex_);
     fade_up_ = !fade_up_;
-    ledc_set_fade_with_time(ledc_channel_.speed_mode,
-                            ledc_channel_.channel, fade_up_ ? LEDC_DUTY : 0, LEDC_FADE_TIME);
-    ledc_fade_start(ledc_channel_.speed_mode,
-                    ledc_channel_.channel, LEDC_FADE_NO_WAIT);
-}
-
-bool IRAM_ATTR GpioLed::FadeCallback(const ledc_cb_param_t *param, void *user_arg) {
-    if (param->event == LEDC_FADE_END_EVT) {
-        auto led = static_cast<GpioLed*>(user_arg);
-        led->OnFadeEnd();
-    }
-    return true;
+    FadeTo(fade_up_ ? duty_ : 0, LEDC_FADE_TIME);
 }
 
 void GpioLed::OnStateChanged() {
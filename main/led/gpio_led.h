@@ -31,6 +31,7 @@ class GpioLed : public Led {
     int blink_counter_ = 0;
     int blink_interval_ms_ = 0;
     esp_timer_handle_t blink_timer_ = nullptr;
+    esp_timer_handle_t fade_timer_ = nullptr;
     bool fade_up_ = true;
 
     void StartBlinkTask(int times, int interval_ms);
@@ -40,8 +41,8 @@ class GpioLed : public Led {
     void Blink(int times, int interval_ms);
     void StartContinuousBlink(int interval_ms);
     void StartFadeTask();
-    void OnFadeEnd();
-    static bool IRAM_ATTR FadeCallback(const ledc_cb_param_t *param, void *user_arg);
+    void OnFadeTimer();
+    void FadeTo(uint32_t duty, int fade_time_ms);
 };
 
 #endif  // _GPIO_LED_H_
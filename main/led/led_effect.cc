@@ -0,0 +1,167 @@
+#include "led_effect.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+// 通道值从 from 向 to 移动 steps，到达后停住
+static uint8_t Approach(uint8_t from, uint8_t to, uint32_t steps) {
+    if (from < to) {
+        return std::min<uint32_t>(from + steps, to);
+    }
+    return from - std::min<uint32_t>(steps, from - to);
+}
+
+static uint8_t Scale(uint8_t value, uint32_t scale) {
+    return (value * scale + 127) / 255;
+}
+
+void SolidEffect::Render(uint32_t time_ms, std::vector<StripColor>& frame) {
+    size_t count = std::min(frame.size(), colors_.size());
+    std::copy(colors_.begin(), colors_.begin() + count, frame.begin());
+}
+
+void BlinkEffect::Render(uint32_t time_ms, std::vector<StripColor>& frame) {
+    bool on = (time_ms / interval_ms_) % 2 == 0;
+    for (size_t i = 0; i < frame.size(); i++) {
+        frame[i] = (on && i < colors_.size()) ? colors_[i] : StripColor{};
+    }
+}
+
+BreatheEffect::BreatheEffect(StripColor low, StripColor high, uint32_t step_ms)
+    : low_(low), high_(high), step_ms_(step_ms) {
+    distance_ = std::max({ std::abs(high.red - low.red), std::abs(high.green - low.green),
+        std::abs(high.blue - low.blue) });
+}
+
+void BreatheEffect::Render(uint32_t time_ms, std::vector<StripColor>& frame) {
+    StripColor color = low_;
+    if (distance_ > 0) {
+        uint32_t phase = (time_ms / step_ms_) % (distance_ * 2);
+        if (phase <= distance_) {
+            color.red = Approach(low_.red, high_.red, phase);
+            color.green = Approach(low_.green, high_.green, phase);
+            color.blue = Approach(low_.blue, high_.blue, phase);
+        } else {
+            uint32_t steps = phase - distance_;
+            color.red = Approach(high_.red, low_.red, steps);
+            color.green = Approach(high_.green, low_.green, steps);
+            color.blue = Approach(high_.blue, low_.blue, steps);
+        }
+    }
+    std::fill(frame.begin(), frame.end(), color);
+}
+
+void ScrollEffect::Render(uint32_t time_ms, std::vector<StripColor>& frame) {
+    if (frame.empty()) {
+        return;
+    }
+    std::fill(frame.begin(), frame.end(), low_);
+    size_t offset = (time_ms / step_ms_) % frame.size();
+    for (int j = 0; j < length_; j++) {
+        frame[(offset + j) % frame.size()] = high_;
+    }
+}
+
+void FadeOutEffect::Render(uint32_t time_ms, std::vector<StripColor>& frame) {
+    uint32_t shift = std::min<uint32_t>(time_ms / step_ms_, 8);
+    for (size_t i = 0; i < frame.size(); i++) {
+        StripColor color = i < from_.size() ? from_[i] : StripColor{};
+        frame[i] = { (uint8_t)(color.red >> shift), (uint8_t)(color.green >> shift), (uint8_t)(color.blue >> shift) };
+    }
+}
+
+void VuMeterEffect::Render(uint32_t time_ms, std::vector<StripColor>& frame) {
+    if (frame.empty()) {
+        return;
+    }
+
+    int level = level_();
+    int release = release_ms_ > 0 ? (int)((time_ms - last_time_ms_) * 255 / release_ms_) : 255;
+    last_time_ms_ = time_ms;
+    display_level_ = std::max(level, display_level_ - release);
+
+    // 点亮的灯珠数量，以 1/255 颗为单位，最后一颗按小数部分调节亮度
+    uint32_t lit = display_level_ * frame.size();
+    for (size_t i = 0; i < frame.size(); i++) {
+        uint32_t scale = std::min<uint32_t>(lit, 255);
+        lit -= scale;
+        StripColor& pixel = frame[i];
+        pixel.red = std::max(pixel.red, Scale(color_.red, scale));
+        pixel.green = std::max(pixel.green, Scale(color_.green, scale));
+        pixel.blue = std::max(pixel.blue, Scale(color_.blue, scale));
+    }
+}
+
+LedCompositor::LedCompositor(size_t led_count)
+    : frame_(led_count), output_(led_count) {
+    BuildLut();
+}
+
+void LedCompositor::BuildLut() {
+    for (int i = 0; i < 256; i++) {
+        float value = gamma_ == 1.0f ? i / 255.0f : std::pow(i / 255.0f, gamma_);
+        lut_[i] = (uint8_t)std::lround(value * brightness_);
+    }
+}
+
+void LedCompositor::SetBrightness(uint8_t brightness) {
+    if (brightness_ != brightness) {
+        brightness_ = brightness;
+        BuildLut();
+    }
+}
+
+void LedCompositor::SetGamma(float gamma) {
+    if (gamma > 0 && gamma_ != gamma) {
+        gamma_ = gamma;
+        BuildLut();
+    }
+}
+
+void LedCompositor::SetLayer(int layer, std::unique_ptr<LedEffect> effect, uint32_t now_ms) {
+    layers_[layer].effect = std::move(effect);
+    layers_[layer].start_ms = now_ms;
+}
+
+void LedCompositor::ClearLayer(int layer) {
+    layers_[layer].effect.reset();
+}
+
+bool LedCompositor::Compose(uint32_t now_ms) {
+    std::fill(frame_.begin(), frame_.end(), StripColor{});
+    for (auto& layer : layers_) {
+        if (!layer.effect) {
+            continue;
+        }
+        uint32_t time_ms = now_ms - layer.start_ms;
+        layer.effect->Render(time_ms, frame_);
+        if (layer.effect->finished(time_ms)) {
+            layer.effect.reset();
+        }
+    }
+
+    bool dirty = false;
+    for (size_t i = 0; i < frame_.size(); i++) {
+        StripColor color = { lut_[frame_[i].red], lut_[frame_[i].green], lut_[frame_[i].blue] };
+        if (color != output_[i]) {
+            output_[i] = color;
+            dirty = true;
+        }
+    }
+    return dirty;
+}
+
+uint32_t LedCompositor::frame_interval_ms() const {
+    uint32_t interval = 0;
+    for (auto& layer : layers_) {
+        if (!layer.effect) {
+            continue;
+        }
+        uint32_t layer_interval = layer.effect->frame_interval_ms();
+        if (layer_interval > 0 && (interval == 0 || layer_interval < interval)) {
+            interval = layer_interval;
+        }
+    }
+    return interval;
+}
@@ -0,0 +1,169 @@
+#ifndef _LED_EFFECT_H_
+#define _LED_EFFECT_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <functional>
+
+/*
+ * LED effects and compositor
+ *
+ * Effects only depend on the time elapsed since they were started and render into a
+ * plain color buffer, so they hold no hardware state and can be run on the host.
+ * The compositor stacks the layers, maps the result through a brightness / gamma LUT
+ * and tells the driver whether the frame differs from the one already on the strip.
+ */
+
+struct StripColor {
+    uint8_t red = 0, green = 0, blue = 0;
+};
+
+inline bool operator==(const StripColor& a, const StripColor& b) {
+    return a.red == b.red && a.green == b.green && a.blue == b.blue;
+}
+
+inline bool operator!=(const StripColor& a, const StripColor& b) {
+    return !(a == b);
+}
+
+class LedEffect {
+public:
+    virtual ~LedEffect() = default;
+
+    // 渲染效果开始后 time_ms 时刻的画面，frame 中已经是下层的合成结果
+    virtual void Render(uint32_t time_ms, std::vector<StripColor>& frame) = 0;
+    // 动画的帧间隔，0 表示静态画面，不需要定时刷新
+    virtual uint32_t frame_interval_ms() const { return 0; }
+    // 一次性的效果播放完后返回 true，合成器会移除该层
+    virtual bool finished(uint32_t time_ms) const { return false; }
+};
+
+class SolidEffect : public LedEffect {
+public:
+    explicit SolidEffect(std::vector<StripColor> colors) : colors_(std::move(colors)) {}
+    SolidEffect(size_t count, StripColor color) : colors_(count, color) {}
+
+    void Render(uint32_t time_ms, std::vector<StripColor>& frame) override;
+
+private:
+    std::vector<StripColor> colors_;
+};
+
+class BlinkEffect : public LedEffect {
+public:
+    BlinkEffect(std::vector<StripColor> colors, uint32_t interval_ms)
+        : colors_(std::move(colors)), interval_ms_(interval_ms) {}
+
+    void Render(uint32_t time_ms, std::vector<StripColor>& frame) override;
+    uint32_t frame_interval_ms() const override { return interval_ms_; }
+
+private:
+    std::vector<StripColor> colors_;
+    uint32_t interval_ms_;
+};
+
+// 每个 step_ms 各通道向目标值移动 1，在 low 与 high 之间往返
+class BreatheEffect : public LedEffect {
+public:
+    BreatheEffect(StripColor low, StripColor high, uint32_t step_ms);
+
+    void Render(uint32_t time_ms, std::vector<StripColor>& frame) override;
+    uint32_t frame_interval_ms() const override { return step_ms_; }
+
+private:
+    StripColor low_;
+    StripColor high_;
+    uint32_t step_ms_;
+    uint32_t distance_;
+};
+
+class ScrollEffect : public LedEffect {
+public:
+    ScrollEffect(StripColor low, StripColor high, int length, uint32_t step_ms)
+        : low_(low), high_(high), length_(length), step_ms_(step_ms) {}
+
+    void Render(uint32_t time_ms, std::vector<StripColor>& frame) override;
+    uint32_t frame_interval_ms() const override { return step_ms_; }
+
+private:
+    StripColor low_;
+    StripColor high_;
+    int length_;
+    uint32_t step_ms_;
+};
+
+// 每个 step_ms 亮度减半，直到全部熄灭
+class FadeOutEffect : public LedEffect {
+public:
+    FadeOutEffect(std::vector<StripColor> from, uint32_t step_ms)
+        : from_(std::move(from)), step_ms_(step_ms) {}
+
+    void Render(uint32_t time_ms, std::vector<StripColor>& frame) override;
+    uint32_t frame_interval_ms() const override { return step_ms_; }
+    bool finished(uint32_t time_ms) const override { return time_ms / step_ms_ >= 8; }
+
+private:
+    std::vector<StripColor> from_;
+    uint32_t step_ms_;
+};
+
+// 音量条：level() 返回 0-255 的电平，立即上升，按 release_ms 从满量程回落到 0
+// 与下层按通道取最大值，单颗灯珠时表现为亮度随电平变化
+class VuMeterEffect : public LedEffect {
+public:
+    VuMeterEffect(std::function<uint8_t()> level, StripColor color, uint32_t release_ms = 300)
+        : level_(std::move(level)), color_(color), release_ms_(release_ms) {}
+
+    void Render(uint32_t time_ms, std::vector<StripColor>& frame) override;
+    uint32_t frame_interval_ms() const override { return 20; }
+
+private:
+    std::function<uint8_t()> level_;
+    StripColor color_;
+    uint32_t release_ms_;
+    uint32_t last_time_ms_ = 0;
+    int display_level_ = 0;
+};
+
+class LedCompositor {
+public:
+    // 第 0 层是状态效果，第 1 层在其结果上继续绘制（如音量条）
+    static constexpr int kLayerCount = 2;
+
+    explicit LedCompositor(size_t led_count);
+
+    void SetBrightness(uint8_t brightness);
+    void SetGamma(float gamma);
+    void SetLayer(int layer, std::unique_ptr<LedEffect> effect, uint32_t now_ms);
+    void ClearLayer(int layer);
+
+    // 合成 now_ms 时刻的画面，输出与上一帧不同时返回 true
+    bool Compose(uint32_t now_ms);
+    // 需要的刷新间隔，所有层都是静态画面时返回 0
+    uint32_t frame_interval_ms() const;
+
+    size_t led_count() const { return frame_.size(); }
+    // LUT 之前的合成结果
+    const std::vector<StripColor>& frame() const { return frame_; }
+    // LUT 之后写入灯带的数据
+    const std::vector<StripColor>& output() const { return output_; }
+
+private:
+    struct Layer {
+        std::unique_ptr<LedEffect> effect;
+        uint32_t start_ms = 0;
+    };
+
+    Layer layers_[kLayerCount];
+    std::vector<StripColor> frame_;
+    std::vector<StripColor> output_;
+    uint8_t lut_[256];
+    uint8_t brightness_ = 255;
+    float gamma_ = 1.0f;
+
+    void BuildLut();
+};
+
+#endif // _LED_EFFECT_H_
@@ -0,0 +1,151 @@
+#include "local_commands.h"
+#include "mcp_server.h"
+#include "board.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <cstdlib>
+
+#define TAG "LocalCommands"
+
+// 连接服务器之前最多保留的通知数量
+#define MAX_PENDING_NOTIFICATIONS 8
+
+static std::string Trim(const std::string& str) {
+    auto begin = str.find_first_not_of(' ');
+    if (begin == std::string::npos) {
+        return "";
+    }
+    auto end = str.find_last_not_of(' ');
+    return str.substr(begin, end - begin + 1);
+}
+
+static std::vector<std::string> Split(const std::string& str, char delimiter) {
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (true) {
+        auto pos = str.find(delimiter, start);
+        parts.push_back(Trim(str.substr(start, pos - start)));
+        if (pos == std::string::npos) {
+            break;
+        }
+        start = pos + 1;
+    }
+    return parts;
+}
+
+static bool IsInteger(const std::string& value, size_t start) {
+    return value.size() > start && std::all_of(value.begin() + start, value.end(), ::isdigit);
+}
+
+LocalCommands::LocalCommands() {
+    for (auto& entry : Split(CONFIG_LOCAL_COMMANDS, ';')) {
+        if (entry.empty()) {
+            continue;
+        }
+        auto colon = entry.find(':');
+        if (colon == std::string::npos) {
+            ESP_LOGW(TAG, "Invalid command entry: %s", entry.c_str());
+            continue;
+        }
+        LocalCommand command;
+        command.phrase = Trim(entry.substr(0, colon));
+        auto fields = Split(entry.substr(colon + 1), ',');
+        command.tool = fields[0];
+        for (size_t i = 1; i < fields.size(); i++) {
+            auto equal = fields[i].find('=');
+            if (equal == std::string::npos) {
+                ESP_LOGW(TAG, "Invalid argument in %s: %s", command.phrase.c_str(), fields[i].c_str());
+                continue;
+            }
+            command.arguments.emplace_back(Trim(fields[i].substr(0, equal)), Trim(fields[i].substr(equal + 1)));
+        }
+        if (command.phrase.empty() || command.tool.empty()) {
+            ESP_LOGW(TAG, "Invalid command entry: %s", entry.c_str());
+            continue;
+        }
+        ESP_LOGI(TAG, "Command %d: %s -> %s", (int)commands_.size(), command.phrase.c_str(), command.tool.c_str());
+        commands_.push_back(std::move(command));
+    }
+}
+
+// 相对值从设备状态中读取当前值，工具 self.<component>.xxx 对应状态中的 <component> 对象
+cJSON* LocalCommands::BuildArguments(const LocalCommand& command) {
+    cJSON* status = nullptr;
+    auto arguments = cJSON_CreateObject();
+    for (auto& [name, value] : command.arguments) {
+        bool relative = !value.empty() && (value[0] == '+' || value[0] == '-');
+        if (relative && IsInteger(value, 1)) {
+            if (status == nullptr) {
+                status = cJSON_Parse(Board::GetInstance().GetDeviceStatusJson().c_str());
+            }
+            auto component = command.tool.substr(0, command.tool.rfind('.'));
+            component = component.substr(component.rfind('.') + 1);
+            auto current = cJSON_GetObjectItem(cJSON_GetObjectItem(status, component.c_str()), name.c_str());
+            if (!cJSON_IsNumber(current)) {
+                ESP_LOGW(TAG, "No current value for %s.%s", component.c_str(), name.c_str());
+                continue;
+            }
+            int target = std::clamp(current->valueint + atoi(value.c_str()), 0, 100);
+            cJSON_AddNumberToObject(arguments, name.c_str(), target);
+        } else if (IsInteger(value, 0)) {
+            cJSON_AddNumberToObject(arguments, name.c_str(), atoi(value.c_str()));
+        } else if (value == "true" || value == "false") {
+            cJSON_AddBoolToObject(arguments, name.c_str(), value == "true");
+        } else {
+            cJSON_AddStringToObject(arguments, name.c_str(), value.c_str());
+        }
+    }
+    cJSON_Delete(status);
+    return arguments;
+}
+
+bool LocalCommands::Execute(int index) {
+    if (index < 0 || index >= (int)commands_.size()) {
+        return false;
+    }
+    auto& command = commands_[index];
+    auto start_time = esp_timer_get_time();
+
+    auto arguments = BuildArguments(command);
+    std::string result;
+    bool success = McpServer::GetInstance().CallTool(command.tool, arguments, result);
+    ESP_LOGI(TAG, "%s -> %s: %s, %lld ms", command.phrase.c_str(), command.tool.c_str(),
+        success ? "ok" : result.c_str(), (esp_timer_get_time() - start_time) / 1000);
+
+#if CONFIG_LOCAL_COMMANDS_NOTIFY_SERVER
+    AddNotification(command, arguments, success);
+#endif
+    cJSON_Delete(arguments);
+    return success;
+}
+
+// 服务器不参与本地命令，只在下次打开音频通道时告知设备状态的变化
+void LocalCommands::AddNotification(const LocalCommand& command, const cJSON* arguments, bool success) {
+    auto root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "jsonrpc", "2.0");
+    cJSON_AddStringToObject(root, "method", "notifications/local_command");
+    auto params = cJSON_CreateObject();
+    cJSON_AddStringToObject(params, "phrase", command.phrase.c_str());
+    cJSON_AddStringToObject(params, "tool", command.tool.c_str());
+    cJSON_AddItemToObject(params, "arguments", cJSON_Duplicate(arguments, true));
+    cJSON_AddBoolToObject(params, "success", success);
+    cJSON_AddItemToObject(root, "params", params);
+
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::lock_guard<std::mutex> lock(mutex_);
+    notifications_.emplace_back(json_str);
+    while (notifications_.size() > MAX_PENDING_NOTIFICATIONS) {
+        notifications_.pop_front();
+    }
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+}
+
+std::vector<std::string> LocalCommands::TakeNotifications() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> notifications(notifications_.begin(), notifications_.end());
+    notifications_.clear();
+    return notifications;
+}
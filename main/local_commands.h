@@ -0,0 +1,54 @@
+#ifndef _LOCAL_COMMANDS_H_
+#define _LOCAL_COMMANDS_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+#include <cJSON.h>
+
+/*
+ * On-device command words mapped directly to MCP tools
+ *
+ * CONFIG_LOCAL_COMMANDS is a list of `pinyin:tool,name=value,...` entries separated by `;`.
+ * The phrases are registered in MultiNet next to the custom wake word; a recognized phrase
+ * calls the tool locally instead of going through server STT / LLM / tools/call / TTS.
+ * An integer value written as `+N` / `-N` is relative to the current value reported by
+ * `self.get_device_status` (e.g. `self.audio_speaker.set_volume,volume=+10`).
+ */
+
+struct LocalCommand {
+    std::string phrase;
+    std::string tool;
+    std::vector<std::pair<std::string, std::string>> arguments;
+};
+
+class LocalCommands {
+public:
+    static LocalCommands& GetInstance() {
+        static LocalCommands instance;
+        return instance;
+    }
+    LocalCommands(const LocalCommands&) = delete;
+    LocalCommands& operator=(const LocalCommands&) = delete;
+
+    const std::vector<LocalCommand>& commands() const { return commands_; }
+    // 在主任务中调用
+    bool Execute(int index);
+    // 取出尚未发送给服务器的通知
+    std::vector<std::string> TakeNotifications();
+
+private:
+    LocalCommands();
+
+    std::vector<LocalCommand> commands_;
+    std::mutex mutex_;
+    std::deque<std::string> notifications_;
+
+    cJSON* BuildArguments(const LocalCommand& command);
+    void AddNotification(const LocalCommand& command, const cJSON* arguments, bool success);
+};
+
+#endif // _LOCAL_COMMANDS_H_
@@ -77,8 +77,9 @@ void McpServer::AddCommonTools() {
             PropertyList({
                 Property("theme", kPropertyTypeString)
             }),
-            [display](const PropertyList& properties) -> ReturnValue {
-                display->SetTheme(properties["theme"].value<std::string>().c_str());
+            [](const PropertyList& properties) -> ReturnValue {
+                auto display_queue = Application::GetInstance().GetDisplayQueue();
+                display_queue->SetTheme(properties["theme"].value<std::string>());
                 return true;
             });
     }
@@ -89,17 +90,20 @@ void McpServer::AddCommonTools() {
             "Take a photo and explain it. Use this tool after the user asks you to see something.\n"
             "Args:\n"
             "  `question`: The question that you want to ask about the photo.\n"
+            "  `resolution`: Optional upload resolution tier: `auto`, `low`, `medium`, `high` or `full`.\n"
+            "    Only use a higher tier when small details (e.g. text) are needed. It applies to this photo only.\n"
             "Return:\n"
             "  A JSON object that provides the photo information.",
             PropertyList({
-                Property("question", kPropertyTypeString)
+                Property("question", kPropertyTypeString),
+                Property("resolution", kPropertyTypeString, std::string(""))
             }),
             [camera](const PropertyList& properties) -> ReturnValue {
                 if (!camera->Capture()) {
                     return "{\"success\": false, \"message\": \"Failed to capture photo\"}";
                 }
                 auto question = properties["question"].value<std::string>();
-                return camera->Explain(question);
+                return camera->Explain(question, properties["resolution"].value<std::string>());
             });
     }
 
@@ -137,16 +141,18 @@ void McpServer::ParseCapabilities(const cJSON* capabilities) {
     if (cJSON_IsObject(vision)) {
         auto url = cJSON_GetObjectItem(vision, "url");
         auto token = cJSON_GetObjectItem(vision, "token");
-        if (cJSON_IsString(url)) {
-            auto camera = Board::GetInstance().GetCamera();
-            if (camera) {
-                std::string url_str = std::string(url->valuestring);
-                std::string token_str;
-                if (cJSON_IsString(token)) {
-                    token_str = std::string(token->valuestring);
-                }
-                camera->SetExplainUrl(url_str, token_str);
+        auto resolution = cJSON_GetObjectItem(vision, "resolution");
+        auto camera = Board::GetInstance().GetCamera();
+        if (cJSON_IsString(url) && camera) {
+            std::string url_str = std::string(url->valuestring);
+            std::string token_str;
+            if (cJSON_IsString(token)) {
+                token_str = std::string(token->valuestring);
             }
+            camera->SetExplainUrl(url_str, token_str);
+        }
+        if (cJSON_IsString(resolution) && camera) {
+            camera->SetUploadTier(resolution->valuestring);
         }
     }
 }
@@ -305,19 +311,8 @@ void McpServer::GetToolsList(int id, const std::string& cursor) {
     ReplyResult(id, json);
 }
 
-void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, int stack_size) {
-    auto tool_iter = std::find_if(tools_.begin(), tools_.end(), 
-                                 [&tool_name](const McpTool* tool) { 
-                                     return tool->name() == tool_name; 
-                                 });
-    
-    if (tool_iter == tools_.end()) {
-        ESP_LOGE(TAG, "tools/call: Unknown tool: %s", tool_name.c_str());
-        ReplyError(id, "Unknown tool: " + tool_name);
-        return;
-    }
-
-    PropertyList arguments = (*tool_iter)->properties();
+bool McpServer::ParseToolArguments(const McpTool* tool, const cJSON* tool_arguments, PropertyList& arguments, std::string& error) {
+    arguments = tool->properties();
     try {
         for (auto& argument : arguments) {
             bool found = false;
@@ -337,13 +332,60 @@ void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* to
 
             if (!argument.has_default_value() && !found) {
                 ESP_LOGE(TAG, "tools/call: Missing valid argument: %s", argument.name().c_str());
-                ReplyError(id, "Missing valid argument: " + argument.name());
-                return;
+                error = "Missing valid argument: " + argument.name();
+                return false;
             }
         }
     } catch (const std::exception& e) {
         ESP_LOGE(TAG, "tools/call: %s", e.what());
-        ReplyError(id, e.what());
+        error = e.what();
+        return false;
+    }
+    return true;
+}
+
+// 本地直接调用工具（例如本地命令词），在调用者的任务中同步执行，不经过服务器
+bool McpServer::CallTool(const std::string& tool_name, const cJSON* tool_arguments, std::string& result) {
+    auto tool_iter = std::find_if(tools_.begin(), tools_.end(), 
+                                 [&tool_name](const McpTool* tool) { 
+                                     return tool->name() == tool_name; 
+                                 });
+    if (tool_iter == tools_.end()) {
+        ESP_LOGE(TAG, "Local call: Unknown tool: %s", tool_name.c_str());
+        result = "Unknown tool: " + tool_name;
+        return false;
+    }
+
+    PropertyList arguments;
+    if (!ParseToolArguments(*tool_iter, tool_arguments, arguments, result)) {
+        return false;
+    }
+    try {
+        result = (*tool_iter)->Call(arguments);
+    } catch (const std::exception& e) {
+        ESP_LOGE(TAG, "Local call: %s", e.what());
+        result = e.what();
+        return false;
+    }
+    return true;
+}
+
+void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, int stack_size) {
+    auto tool_iter = std::find_if(tools_.begin(), tools_.end(), 
+                                 [&tool_name](const McpTool* tool) { 
+                                     return tool->name() == tool_name; 
+                                 });
+    
+    if (tool_iter == tools_.end()) {
+        ESP_LOGE(TAG, "tools/call: Unknown tool: %s", tool_name.c_str());
+        ReplyError(id, "Unknown tool: " + tool_name);
+        return;
+    }
+
+    PropertyList arguments;
+    std::string error;
+    if (!ParseToolArguments(*tool_iter, tool_arguments, arguments, error)) {
+        ReplyError(id, error);
         return;
     }
 
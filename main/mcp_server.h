@@ -261,6 +261,7 @@ public:
     void AddTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback);
     void ParseMessage(const cJSON* json);
     void ParseMessage(const std::string& message);
+    bool CallTool(const std::string& tool_name, const cJSON* tool_arguments, std::string& result);
 
 private:
     McpServer();
@@ -273,6 +274,7 @@ private:
 
     void GetToolsList(int id, const std::string& cursor);
     void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, int stack_size);
+    bool ParseToolArguments(const McpTool* tool, const cJSON* tool_arguments, PropertyList& arguments, std::string& error);
 
     std::vector<McpTool*> tools_;
     std::thread tool_call_thread_;
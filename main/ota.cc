@@ -1,6 +1,8 @@
 #include "ota.h"
 #include "system_info.h"
 #include "settings.h"
+#include "ota_pipeline.h"
+#include "ota_decoder.h"
 #include "assets/lang_config.h"
 
 #include <cJSON.h>
@@ -8,6 +10,7 @@
 #include <esp_partition.h>
 #include <esp_ota_ops.h>
 #include <esp_app_format.h>
+#include <spi_flash_mmap.h>
 #include <esp_efuse.h>
 #include <esp_efuse_table.h>
 #ifdef SOC_HMAC_SUPPORTED
@@ -15,12 +18,23 @@
 #endif
 
 #include <cstring>
+#include <strings.h>
 #include <vector>
 #include <sstream>
 #include <algorithm>
+#include <mutex>
 
 #define TAG "Ota"
 
+#define OTA_MAX_ATTEMPTS 5
+#define OTA_RETRY_DELAY_MS 3000
+#define OTA_CHECKPOINT_INTERVAL (256 * 1024)
+
+// 分区表中存在 MODELS_PARTITION_B 时模型包 A/B 交替写入，否则原地覆盖 MODELS_PARTITION_A
+#define MODELS_PARTITION_A "model"
+#define MODELS_PARTITION_B "model_1"
+#define MODELS_ERASE_BLOCK_SIZE (64 * 1024)
+
 
 Ota::Ota() {
 #ifdef ESP_EFUSE_BLOCK_USR_DATA
@@ -145,14 +159,11 @@ bool Ota::CheckVersion() {
         Settings settings("mqtt", true);
         cJSON *item = NULL;
         cJSON_ArrayForEach(item, mqtt) {
+            // 未变化的值不会产生 NVS 写入
             if (cJSON_IsString(item)) {
-                if (settings.GetString(item->string) != item->valuestring) {
-                    settings.SetString(item->string, item->valuestring);
-                }
+                settings.SetString(item->string, item->valuestring);
             } else if (cJSON_IsNumber(item)) {
-                if (settings.GetInt(item->string) != item->valueint) {
-                    settings.SetInt(item->string, item->valueint);
-                }
+                settings.SetInt(item->string, item->valueint);
             }
         }
         has_mqtt_config_ = true;
@@ -166,14 +177,11 @@ bool Ota::CheckVersion() {
         Settings settings("websocket", true);
         cJSON *item = NULL;
         cJSON_ArrayForEach(item, websocket) {
+            // 未变化的值不会产生 NVS 写入
             if (cJSON_IsString(item)) {
-                if (settings.GetString(item->string) != item->valuestring) {
-                    settings.SetString(item->string, item->valuestring);
-                }
+                settings.SetString(item->string, item->valuestring);
             } else if (cJSON_IsNumber(item)) {
-                if (settings.GetInt(item->string) != item->valueint) {
-                    settings.SetInt(item->string, item->valueint);
-                }
+                settings.SetInt(item->string, item->valueint);
             }
         }
         has_websocket_config_ = true;
@@ -217,6 +225,14 @@ bool Ota::CheckVersion() {
         if (cJSON_IsString(url)) {
             firmware_url_ = url->valuestring;
         }
+        // 可选，下载完成后校验下载文件的 SHA-256
+        cJSON *sha256 = cJSON_GetObjectItem(firmware, "sha256");
+        firmware_sha256_ = cJSON_IsString(sha256) ? sha256->valuestring : "";
+        // 可选，"raw" (默认) / "deflate" / "delta"，差分镜像需要指定基础版本
+        cJSON *format = cJSON_GetObjectItem(firmware, "format");
+        firmware_format_ = cJSON_IsString(format) ? format->valuestring : "raw";
+        cJSON *base_version = cJSON_GetObjectItem(firmware, "base_version");
+        firmware_base_version_ = cJSON_IsString(base_version) ? base_version->valuestring : "";
 
         if (cJSON_IsString(version) && cJSON_IsString(url)) {
             // Check if the version is newer, for example, 0.1.0 is newer than 0.0.1
@@ -236,6 +252,37 @@ bool Ota::CheckVersion() {
         ESP_LOGW(TAG, "No firmware section found!");
     }
 
+    // Response: { "models": { "version": "wn9_nihaoxiaozhi-2", "url": "http://", "sha256": "..." } }
+    // 版本号与已安装的模型包不同即更新，服务器可以借此回退模型
+    has_new_models_ = false;
+    cJSON *models = cJSON_GetObjectItem(root, "models");
+    if (cJSON_IsObject(models)) {
+        cJSON *version = cJSON_GetObjectItem(models, "version");
+        cJSON *url = cJSON_GetObjectItem(models, "url");
+        cJSON *sha256 = cJSON_GetObjectItem(models, "sha256");
+        if (cJSON_IsString(version) && cJSON_IsString(url)) {
+            models_version_ = version->valuestring;
+            models_url_ = url->valuestring;
+            models_sha256_ = cJSON_IsString(sha256) ? sha256->valuestring : "";
+
+            Settings settings("models", false);
+            auto installed_version = settings.GetString("version");
+            has_new_models_ = models_version_ != installed_version;
+#if !CONFIG_OTA_MODELS_IN_PLACE_UPDATE
+            // 没有备用分区时只能原地覆盖，中断后设备没有可用的模型，需要显式开启
+            if (has_new_models_ && FindModelsPartition(MODELS_PARTITION_B) == nullptr) {
+                ESP_LOGW(TAG, "Models %s ignored, no %s partition for an A/B update", models_version_.c_str(),
+                    MODELS_PARTITION_B);
+                has_new_models_ = false;
+            }
+#endif
+            if (has_new_models_) {
+                ESP_LOGI(TAG, "New models available: %s, installed: %s", models_version_.c_str(),
+                    installed_version.empty() ? "unknown" : installed_version.c_str());
+            }
+        }
+    }
+
     cJSON_Delete(root);
     return true;
 }
@@ -262,6 +309,32 @@ void Ota::MarkCurrentVersionValid() {
 
 bool Ota::Upgrade(const std::string& firmware_url) {
     ESP_LOGI(TAG, "Upgrading firmware from %s", firmware_url.c_str());
+    // 升级期间会长时间占用 flash，先提交尚未写入的设置
+    Settings::Flush();
+
+    OtaPipeline pipeline(CONFIG_OTA_BUFFER_SIZE * 1024, CONFIG_OTA_BUFFER_COUNT);
+    pipeline.OnProgress(upgrade_callback_);
+    for (int attempt = 1; attempt <= OTA_MAX_ATTEMPTS; attempt++) {
+        bool retry = false;
+        if (TryUpgrade(firmware_url, pipeline, retry)) {
+            return true;
+        }
+        if (!retry || attempt == OTA_MAX_ATTEMPTS) {
+            break;
+        }
+        ESP_LOGW(TAG, "Upgrade attempt %d failed, resuming in %d ms", attempt, OTA_RETRY_DELAY_MS);
+        vTaskDelay(pdMS_TO_TICKS(OTA_RETRY_DELAY_MS));
+    }
+    return false;
+}
+
+/*
+ * The "ota" namespace records how far the download into the update partition got:
+ * partition label, server version, image version, image size, ETag, the written offset
+ * and the SHA-256 of the bytes before that offset. A later attempt (or the next boot)
+ * continues from the offset with a Range request if everything still matches.
+ */
+bool Ota::TryUpgrade(const std::string& firmware_url, OtaPipeline& pipeline, bool& retry) {
     esp_ota_handle_t update_handle = 0;
     auto update_partition = esp_ota_get_next_update_partition(NULL);
     if (update_partition == NULL) {
@@ -273,82 +346,198 @@ bool Ota::Upgrade(const std::string& firmware_url) {
     bool image_header_checked = false;
     std::string image_header;
 
+    if (firmware_format_ == "delta" && firmware_base_version_ != current_version_) {
+        ESP_LOGE(TAG, "Delta image is based on %s, running %s", firmware_base_version_.c_str(), current_version_.c_str());
+        return false;
+    }
+    if (firmware_format_ != "raw" && firmware_format_ != "deflate" && firmware_format_ != "delta") {
+        ESP_LOGE(TAG, "Unsupported firmware format: %s", firmware_format_.c_str());
+        return false;
+    }
+
+    // 检查是否可以从上次中断的位置继续，解码器的状态无法保存，只有原始镜像支持续传
+    Settings checkpoint("ota", true);
+    bool resumable = firmware_format_ == "raw";
+    size_t offset = 0;
+    size_t total_size = 0;
+    std::string etag;
+    if (resumable && checkpoint.GetString("partition") == update_partition->label && checkpoint.GetString("target") == firmware_version_) {
+        offset = checkpoint.GetInt("offset");
+        total_size = checkpoint.GetInt("size");
+        etag = checkpoint.GetString("etag");
+        if (offset > 0 && offset < total_size && !VerifyResumePoint(update_partition, checkpoint, pipeline, offset)) {
+            offset = 0;
+        }
+    }
+
     auto network = Board::GetInstance().GetNetwork();
     auto http = network->CreateHttp(0);
+    if (offset > 0) {
+        http->SetHeader("Range", "bytes=" + std::to_string(offset) + "-");
+        // 服务器上的文件变化时 If-Range 不成立，会返回完整的 200 响应
+        if (!etag.empty()) {
+            http->SetHeader("If-Range", etag);
+        }
+    }
     if (!http->Open("GET", firmware_url)) {
         ESP_LOGE(TAG, "Failed to open HTTP connection");
+        retry = true;
         return false;
     }
 
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to get firmware, status code: %d", http->GetStatusCode());
+    auto status_code = http->GetStatusCode();
+    if (status_code == 206 && offset > 0) {
+        unsigned int range_start = 0, range_end = 0, range_total = 0;
+        auto content_range = http->GetResponseHeader("Content-Range");
+        if (sscanf(content_range.c_str(), "bytes %u-%u/%u", &range_start, &range_end, &range_total) != 3 ||
+            range_start != offset || range_total != total_size) {
+            ESP_LOGW(TAG, "Unexpected Content-Range: %s, restarting from 0", content_range.c_str());
+            http->Close();
+            checkpoint.EraseAll();
+            retry = true;
+            return false;
+        }
+        esp_err_t err = esp_ota_resume(update_partition, OTA_WITH_SEQUENTIAL_WRITES, offset, &update_handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to resume OTA: %s", esp_err_to_name(err));
+            http->Close();
+            checkpoint.EraseAll();
+            retry = true;
+            return false;
+        }
+        image_header_checked = true;
+        ESP_LOGI(TAG, "Resuming download at %u/%u", offset, total_size);
+    } else if (status_code == 200) {
+        if (offset > 0) {
+            ESP_LOGW(TAG, "Firmware changed on server, restarting from 0");
+            offset = 0;
+        }
+        checkpoint.EraseAll();
+        total_size = http->GetBodyLength();
+        etag = http->GetResponseHeader("ETag");
+        if (etag.empty()) {
+            etag = http->GetResponseHeader("Last-Modified");
+        }
+    } else {
+        ESP_LOGE(TAG, "Failed to get firmware, status code: %d", status_code);
         return false;
     }
 
-    size_t content_length = http->GetBodyLength();
-    if (content_length == 0) {
+    if (total_size == 0) {
         ESP_LOGE(TAG, "Failed to get content length");
         return false;
     }
 
-    char buffer[512];
-    size_t total_read = 0, recent_read = 0;
-    auto last_calc_time = esp_timer_get_time();
-    while (true) {
-        int ret = http->Read(buffer, sizeof(buffer));
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
-            return false;
-        }
-
-        // Calculate speed and progress every second
-        recent_read += ret;
-        total_read += ret;
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || ret == 0) {
-            size_t progress = total_read * 100 / content_length;
-            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s", progress, total_read, content_length, recent_read);
-            if (upgrade_callback_) {
-                upgrade_callback_(progress, recent_read);
+    // Runs on the writer task of the pipeline, receives the decoded app image
+    auto write_image = [&](const uint8_t* data, size_t size) {
+        esp_err_t err;
+        if (!image_header_checked) {
+            image_header.append((const char*)data, size);
+            if (image_header.size() < sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
+                return true;
+            }
+            esp_app_desc_t new_app_info;
+            memcpy(&new_app_info, image_header.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
+            ESP_LOGI(TAG, "New firmware version: %s", new_app_info.version);
+
+            auto current_version = esp_app_get_description()->version;
+            if (memcmp(new_app_info.version, current_version, sizeof(new_app_info.version)) == 0) {
+                ESP_LOGE(TAG, "Firmware version is the same, skipping upgrade");
+                return false;
             }
-            last_calc_time = esp_timer_get_time();
-            recent_read = 0;
-        }
 
-        if (ret == 0) {
-            break;
-        }
+            if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
+                esp_ota_abort(update_handle);
+                update_handle = 0;
+                ESP_LOGE(TAG, "Failed to begin OTA");
+                return false;
+            }
 
-        if (!image_header_checked) {
-            image_header.append(buffer, ret);
-            if (image_header.size() >= sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
-                esp_app_desc_t new_app_info;
-                memcpy(&new_app_info, image_header.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
-                ESP_LOGI(TAG, "New firmware version: %s", new_app_info.version);
-
-                auto current_version = esp_app_get_description()->version;
-                if (memcmp(new_app_info.version, current_version, sizeof(new_app_info.version)) == 0) {
-                    ESP_LOGE(TAG, "Firmware version is the same, skipping upgrade");
-                    return false;
-                }
-
-                if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
-                    esp_ota_abort(update_handle);
-                    ESP_LOGE(TAG, "Failed to begin OTA");
-                    return false;
-                }
-
-                image_header_checked = true;
-                std::string().swap(image_header);
+            image_header_checked = true;
+            if (resumable) {
+                checkpoint.SetString("partition", update_partition->label);
+                checkpoint.SetString("target", firmware_version_);
+                checkpoint.SetString("version", std::string(new_app_info.version, strnlen(new_app_info.version, sizeof(new_app_info.version))));
+                checkpoint.SetInt("size", total_size);
+                checkpoint.SetString("etag", etag);
             }
+
+            // 头部之前缓存的数据与本次数据一起写入
+            err = esp_ota_write(update_handle, image_header.data(), image_header.size());
+            std::string().swap(image_header);
+        } else {
+            err = esp_ota_write(update_handle, data, size);
         }
-        auto err = esp_ota_write(update_handle, buffer, ret);
         if (err != ESP_OK) {
             ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
+            return false;
+        }
+        return true;
+    };
+
+    // 压缩和差分镜像先经过解码器，补丁从运行中的分区读取未变化的部分
+    auto running_partition = esp_ota_get_running_partition();
+    std::unique_ptr<DeltaDecoder> patcher;
+    std::unique_ptr<OtaDecoder> decoder;
+    if (firmware_format_ == "deflate") {
+        decoder = std::make_unique<InflateDecoder>(write_image);
+    } else if (firmware_format_ == "delta") {
+        patcher = std::make_unique<DeltaDecoder>([running_partition](uint32_t offset, uint8_t* data, size_t size) {
+            return esp_partition_read(running_partition, offset, data, size) == ESP_OK;
+        }, running_partition->size, write_image);
+        decoder = std::make_unique<InflateDecoder>([&patcher](const uint8_t* data, size_t size) {
+            return patcher->Feed(data, size);
+        });
+    }
+
+    size_t written = offset;
+    size_t last_checkpoint = offset;
+    auto sink = [&](const uint8_t* data, size_t size) {
+        if (decoder) {
+            return decoder->Feed(data, size);
+        }
+        if (!write_image(data, size)) {
+            return false;
+        }
+
+        // 只在扇区边界记录进度，续传时 esp_ota_write 会先擦除下一个扇区
+        written += size;
+        if (written % SPI_FLASH_SEC_SIZE == 0 && written - last_checkpoint >= OTA_CHECKPOINT_INTERVAL) {
+            checkpoint.SetInt("offset", written);
+            checkpoint.SetString("sha256", pipeline.GetRunningSha256());
+            Settings::Flush();
+            last_checkpoint = written;
+        }
+        return true;
+    };
+
+    bool success = pipeline.Run(http.get(), total_size, sink, offset);
+    http->Close();
+    if (success && decoder) {
+        success = decoder->Finish() && (!patcher || patcher->Finish());
+    }
+    if (!success || !image_header_checked) {
+        if (update_handle != 0) {
+            esp_ota_abort(update_handle);
+        }
+        // 网络中断时保留进度，其他错误从头开始
+        retry = pipeline.IsDownloadFailed();
+        if (!retry) {
+            checkpoint.EraseAll();
+        }
+        return false;
+    }
+    checkpoint.EraseAll();
+
+    if (!firmware_sha256_.empty()) {
+        auto sha256 = pipeline.GetSha256();
+        if (strcasecmp(sha256.c_str(), firmware_sha256_.c_str()) != 0) {
+            ESP_LOGE(TAG, "SHA-256 mismatch, expected %s, got %s", firmware_sha256_.c_str(), sha256.c_str());
             esp_ota_abort(update_handle);
             return false;
         }
+        ESP_LOGI(TAG, "SHA-256 verified: %s", sha256.c_str());
     }
-    http->Close();
 
     esp_err_t err = esp_ota_end(update_handle);
     if (err != ESP_OK) {
@@ -370,7 +559,185 @@ bool Ota::Upgrade(const std::string& firmware_url) {
     return true;
 }
 
-bool Ota::StartUpgrade(std::function<void(int progress, size_t speed)> callback) {
+bool Ota::VerifyResumePoint(const esp_partition_t* partition, Settings& checkpoint, OtaPipeline& pipeline, size_t offset) {
+    // 分区中已写入的镜像头必须是记录的版本
+    esp_app_desc_t app_desc;
+    if (esp_partition_read(partition, sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t),
+            &app_desc, sizeof(app_desc)) != ESP_OK || app_desc.magic_word != ESP_APP_DESC_MAGIC_WORD) {
+        ESP_LOGW(TAG, "No image header in partition %s, restarting from 0", partition->label);
+        return false;
+    }
+    std::string version(app_desc.version, strnlen(app_desc.version, sizeof(app_desc.version)));
+    if (version != checkpoint.GetString("version")) {
+        ESP_LOGW(TAG, "Partition holds version %s, restarting from 0", version.c_str());
+        return false;
+    }
+
+    // 已写入部分的哈希必须与记录一致，同时作为整个镜像哈希的前缀
+    std::string digest;
+    if (!pipeline.HashPrefix(partition, offset, digest) || digest != checkpoint.GetString("sha256")) {
+        ESP_LOGW(TAG, "Written data does not match the checkpoint, restarting from 0");
+        return false;
+    }
+    return true;
+}
+
+const esp_partition_t* Ota::FindModelsPartition(const std::string& label) {
+    return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label.c_str());
+}
+
+bool Ota::IsModelsUpdatePending() {
+    Settings settings("models", false);
+    return !settings.GetString("pending").empty();
+}
+
+srmodel_list_t* Ota::LoadModels() {
+    // 唤醒词、命令词与 AFE 共用同一份模型列表
+    static std::mutex mutex;
+    static srmodel_list_t* models = nullptr;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (models != nullptr) {
+        return models;
+    }
+
+    if (IsModelsUpdatePending()) {
+        ESP_LOGE(TAG, "Models update was interrupted, models are not available");
+        return nullptr;
+    }
+    Settings settings("models", false);
+    auto label = settings.GetString("partition", MODELS_PARTITION_A);
+    if (FindModelsPartition(label) == nullptr) {
+        label = MODELS_PARTITION_A;
+    }
+    ESP_LOGI(TAG, "Loading models from partition %s", label.c_str());
+    models = esp_srmodel_init(label.c_str());
+    return models;
+}
+
+bool Ota::StartModelsUpgrade(std::function<void(const OtaProgress& progress)> callback) {
+    ESP_LOGI(TAG, "Upgrading models to %s from %s", models_version_.c_str(), models_url_.c_str());
+    Settings::Flush();
+
+    Settings settings("models", true);
+    std::string active = settings.GetString("partition", MODELS_PARTITION_A);
+    const esp_partition_t* partition = nullptr;
+    if (FindModelsPartition(MODELS_PARTITION_B) != nullptr) {
+        partition = FindModelsPartition(active == MODELS_PARTITION_B ? MODELS_PARTITION_A : MODELS_PARTITION_B);
+    } else {
+        partition = FindModelsPartition(MODELS_PARTITION_A);
+    }
+    if (partition == nullptr) {
+        ESP_LOGE(TAG, "Models partition not found");
+        return false;
+    }
+
+    // 原地覆盖时先记录，写入完成前重启不会加载半个模型包
+    bool in_place = active == partition->label;
+#if !CONFIG_OTA_MODELS_IN_PLACE_UPDATE
+    if (in_place) {
+        ESP_LOGE(TAG, "In-place models update is disabled");
+        return false;
+    }
+#endif
+    if (in_place) {
+        settings.SetString("pending", models_version_);
+        settings.EraseKey("version");
+        Settings::Flush();
+    }
+
+    OtaPipeline pipeline(CONFIG_OTA_BUFFER_SIZE * 1024, CONFIG_OTA_BUFFER_COUNT);
+    pipeline.OnProgress(callback);
+    for (int attempt = 1; attempt <= OTA_MAX_ATTEMPTS; attempt++) {
+        bool retry = false;
+        if (UpgradeModels(partition, pipeline, retry)) {
+            settings.SetString("version", models_version_);
+            settings.SetString("partition", partition->label);
+            settings.EraseKey("pending");
+            Settings::Flush();
+            ESP_LOGI(TAG, "Models upgrade successful, partition %s", partition->label);
+            return true;
+        }
+        if (!retry || attempt == OTA_MAX_ATTEMPTS) {
+            break;
+        }
+        ESP_LOGW(TAG, "Models upgrade attempt %d failed, retrying in %d ms", attempt, OTA_RETRY_DELAY_MS);
+        vTaskDelay(pdMS_TO_TICKS(OTA_RETRY_DELAY_MS));
+    }
+    return false;
+}
+
+bool Ota::UpgradeModels(const esp_partition_t* partition, OtaPipeline& pipeline, bool& retry) {
+    auto network = Board::GetInstance().GetNetwork();
+    auto http = network->CreateHttp(0);
+    if (!http->Open("GET", models_url_)) {
+        ESP_LOGE(TAG, "Failed to open HTTP connection");
+        retry = true;
+        return false;
+    }
+    if (http->GetStatusCode() != 200) {
+        ESP_LOGE(TAG, "Failed to get models, status code: %d", http->GetStatusCode());
+        return false;
+    }
+    size_t total_size = http->GetBodyLength();
+    if (total_size == 0 || total_size > partition->size) {
+        ESP_LOGE(TAG, "Invalid models size %u, partition %s is %lu bytes", total_size, partition->label, partition->size);
+        return false;
+    }
+
+    // 边下载边按块擦除，避免开始前长时间擦除整个分区
+    size_t written = 0;
+    size_t erased = 0;
+    auto sink = [&](const uint8_t* data, size_t size) {
+        while (erased < written + size) {
+            size_t length = std::min<size_t>(MODELS_ERASE_BLOCK_SIZE, partition->size - erased);
+            esp_err_t err = esp_partition_erase_range(partition, erased, length);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to erase models partition: %s", esp_err_to_name(err));
+                return false;
+            }
+            erased += length;
+        }
+        esp_err_t err = esp_partition_write(partition, written, data, size);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to write models partition: %s", esp_err_to_name(err));
+            return false;
+        }
+        written += size;
+        return true;
+    };
+
+    bool success = pipeline.Run(http.get(), total_size, sink);
+    http->Close();
+    if (!success) {
+        retry = pipeline.IsDownloadFailed();
+        return false;
+    }
+
+    auto sha256 = pipeline.GetSha256();
+    if (!models_sha256_.empty() && strcasecmp(sha256.c_str(), models_sha256_.c_str()) != 0) {
+        ESP_LOGE(TAG, "Models SHA-256 mismatch, expected %s, got %s", models_sha256_.c_str(), sha256.c_str());
+        return false;
+    }
+
+    // 回读校验 flash 中的内容，再确认模型包可以被解析
+    std::string digest;
+    if (!pipeline.HashPrefix(partition, total_size, digest) || digest != sha256) {
+        ESP_LOGE(TAG, "Models partition read back mismatch");
+        return false;
+    }
+    srmodel_list_t* models = esp_srmodel_init(partition->label);
+    if (models == nullptr || models->num <= 0) {
+        ESP_LOGE(TAG, "Downloaded models pack is invalid");
+        return false;
+    }
+    for (int i = 0; i < models->num; i++) {
+        ESP_LOGI(TAG, "Model %d: %s", i, models->model_name[i]);
+    }
+    esp_srmodel_deinit(models);
+    return true;
+}
+
+bool Ota::StartUpgrade(std::function<void(const OtaProgress& progress)> callback) {
     upgrade_callback_ = callback;
     return Upgrade(firmware_url_);
 }
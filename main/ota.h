@@ -5,7 +5,11 @@
 #include <string>
 
 #include <esp_err.h>
+#include <esp_partition.h>
+#include <model_path.h>
 #include "board.h"
+#include "settings.h"
+#include "ota_pipeline.h"
 
 class Ota {
 public:
@@ -20,9 +24,18 @@ public:
     bool HasWebsocketConfig() { return has_websocket_config_; }
     bool HasActivationCode() { return has_activation_code_; }
     bool HasServerTime() { return has_server_time_; }
-    bool StartUpgrade(std::function<void(int progress, size_t speed)> callback);
+    bool StartUpgrade(std::function<void(const OtaProgress& progress)> callback);
     void MarkCurrentVersionValid();
 
+    // 模型包 (wakenet / multinet / NS / VAD) 独立于固件升级，写入成功后需要重启
+    bool HasNewModels() { return has_new_models_; }
+    bool StartModelsUpgrade(std::function<void(const OtaProgress& progress)> callback);
+    const std::string& GetModelsVersion() const { return models_version_; }
+    // 原地更新模型分区被中断时，分区内容不可用
+    static bool IsModelsUpdatePending();
+    // 代替 esp_srmodel_init("model")，从当前生效的模型分区加载；只加载一次，调用者不要释放
+    static srmodel_list_t* LoadModels();
+
     const std::string& GetFirmwareVersion() const { return firmware_version_; }
     const std::string& GetCurrentVersion() const { return current_version_; }
     const std::string& GetActivationMessage() const { return activation_message_; }
@@ -39,15 +52,26 @@ private:
     bool has_activation_code_ = false;
     bool has_serial_number_ = false;
     bool has_activation_challenge_ = false;
+    bool has_new_models_ = false;
     std::string current_version_;
     std::string firmware_version_;
     std::string firmware_url_;
+    std::string firmware_sha256_;
+    std::string firmware_format_ = "raw";
+    std::string firmware_base_version_;
+    std::string models_version_;
+    std::string models_url_;
+    std::string models_sha256_;
     std::string activation_challenge_;
     std::string serial_number_;
     int activation_timeout_ms_ = 30000;
 
     bool Upgrade(const std::string& firmware_url);
-    std::function<void(int progress, size_t speed)> upgrade_callback_;
+    bool TryUpgrade(const std::string& firmware_url, OtaPipeline& pipeline, bool& retry);
+    bool UpgradeModels(const esp_partition_t* partition, OtaPipeline& pipeline, bool& retry);
+    static const esp_partition_t* FindModelsPartition(const std::string& label);
+    bool VerifyResumePoint(const esp_partition_t* partition, Settings& checkpoint, OtaPipeline& pipeline, size_t offset);
+    std::function<void(const OtaProgress& progress)> upgrade_callback_;
     std::vector<int> ParseVersion(const std::string& version);
     bool IsNewVersionAvailable(const std::string& currentVersion, const std::string& newVersion);
     std::string GetActivationPayload();
@@ -0,0 +1,248 @@
+#include "ota_decoder.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <mbedtls/sha256.h>
+#include "rom/miniz.h"
+
+#include <cstring>
+#include <algorithm>
+
+#define TAG "OtaDecoder"
+
+#define DELTA_MAGIC "XZD1"
+#define DELTA_HEADER_SIZE 44
+#define DELTA_OP_END 0x00
+#define DELTA_OP_COPY 0x01
+#define DELTA_OP_INSERT 0x02
+#define DELTA_COPY_BUFFER_SIZE 4096
+
+static uint32_t ReadUint32(const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+InflateDecoder::InflateDecoder(Writer writer) : writer_(writer) {
+    inflator_ = (tinfl_decompressor*)heap_caps_malloc(sizeof(tinfl_decompressor), MALLOC_CAP_DEFAULT);
+    // tinfl 以输出缓冲区作为 32KB 的滑动窗口
+    dict_ = (uint8_t*)heap_caps_malloc_prefer(TINFL_LZ_DICT_SIZE, 2, MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+    if (inflator_ == nullptr || dict_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate inflater");
+        failed_ = true;
+        return;
+    }
+    tinfl_init(inflator_);
+}
+
+InflateDecoder::~InflateDecoder() {
+    heap_caps_free(inflator_);
+    heap_caps_free(dict_);
+}
+
+bool InflateDecoder::Feed(const uint8_t* data, size_t size) {
+    if (failed_) {
+        return false;
+    }
+
+    while (!done_) {
+        size_t in_bytes = size;
+        size_t out_bytes = TINFL_LZ_DICT_SIZE - dict_offset_;
+        auto status = tinfl_decompress(inflator_, data, &in_bytes, dict_, dict_ + dict_offset_, &out_bytes,
+            TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_COMPUTE_ADLER32 | TINFL_FLAG_HAS_MORE_INPUT);
+        data += in_bytes;
+        size -= in_bytes;
+
+        if (out_bytes > 0) {
+            if (!writer_(dict_ + dict_offset_, out_bytes)) {
+                failed_ = true;
+                return false;
+            }
+            dict_offset_ = (dict_offset_ + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+
+        if (status < TINFL_STATUS_DONE) {
+            ESP_LOGE(TAG, "Inflate failed: %d", status);
+            failed_ = true;
+            return false;
+        }
+        if (status == TINFL_STATUS_DONE) {
+            done_ = true;
+        } else if (status == TINFL_STATUS_NEEDS_MORE_INPUT && size == 0) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool InflateDecoder::Finish() {
+    if (!done_) {
+        ESP_LOGE(TAG, "Compressed stream is truncated");
+    }
+    return done_ && !failed_;
+}
+
+DeltaDecoder::DeltaDecoder(BaseReader base_reader, size_t base_size, Writer writer)
+    : base_reader_(base_reader), base_size_(base_size), writer_(writer) {
+    copy_buffer_ = (uint8_t*)heap_caps_malloc(DELTA_COPY_BUFFER_SIZE, MALLOC_CAP_DEFAULT);
+    if (copy_buffer_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate copy buffer");
+        failed_ = true;
+    }
+}
+
+DeltaDecoder::~DeltaDecoder() {
+    heap_caps_free(copy_buffer_);
+}
+
+// 把字段凑齐到 field_size 字节，凑齐后返回 true
+bool DeltaDecoder::Collect(const uint8_t*& data, size_t& size, size_t field_size) {
+    size_t length = std::min(field_size - field_size_, size);
+    memcpy(field_ + field_size_, data, length);
+    field_size_ += length;
+    data += length;
+    size -= length;
+    if (field_size_ < field_size) {
+        return false;
+    }
+    field_size_ = 0;
+    return true;
+}
+
+bool DeltaDecoder::Feed(const uint8_t* data, size_t size) {
+    while (size > 0 && !failed_) {
+        switch (state_) {
+        case kStateHeader:
+            if (Collect(data, size, DELTA_HEADER_SIZE)) {
+                if (!VerifyHeader()) {
+                    failed_ = true;
+                    break;
+                }
+                state_ = kStateOp;
+            }
+            break;
+        case kStateOp: {
+            uint8_t op = *data++;
+            size--;
+            if (op == DELTA_OP_COPY) {
+                state_ = kStateCopy;
+            } else if (op == DELTA_OP_INSERT) {
+                state_ = kStateInsertLength;
+            } else if (op == DELTA_OP_END) {
+                state_ = kStateEnd;
+            } else {
+                ESP_LOGE(TAG, "Unknown patch op 0x%02x", op);
+                failed_ = true;
+            }
+            break;
+        }
+        case kStateCopy:
+            if (Collect(data, size, 8)) {
+                if (!Copy(ReadUint32(field_), ReadUint32(field_ + 4))) {
+                    failed_ = true;
+                    break;
+                }
+                state_ = kStateOp;
+            }
+            break;
+        case kStateInsertLength:
+            if (Collect(data, size, 4)) {
+                remaining_ = ReadUint32(field_);
+                state_ = remaining_ > 0 ? kStateInsert : kStateOp;
+            }
+            break;
+        case kStateInsert: {
+            size_t length = std::min<size_t>(remaining_, size);
+            if (!Output(data, length)) {
+                failed_ = true;
+                break;
+            }
+            data += length;
+            size -= length;
+            remaining_ -= length;
+            if (remaining_ == 0) {
+                state_ = kStateOp;
+            }
+            break;
+        }
+        case kStateEnd:
+            ESP_LOGE(TAG, "Unexpected data after the end of patch");
+            failed_ = true;
+            break;
+        }
+    }
+    return !failed_;
+}
+
+bool DeltaDecoder::Finish() {
+    if (failed_) {
+        return false;
+    }
+    if (state_ != kStateEnd || output_size_ != target_size_) {
+        ESP_LOGE(TAG, "Patch is truncated, %u/%u bytes", output_size_, target_size_);
+        return false;
+    }
+    return true;
+}
+
+bool DeltaDecoder::VerifyHeader() {
+    if (memcmp(field_, DELTA_MAGIC, 4) != 0) {
+        ESP_LOGE(TAG, "Invalid patch magic");
+        return false;
+    }
+    target_size_ = ReadUint32(field_ + 4);
+    size_t base_size = ReadUint32(field_ + 8);
+    if (base_size > base_size_) {
+        ESP_LOGE(TAG, "Patch base is %u bytes, running image is %u bytes", base_size, base_size_);
+        return false;
+    }
+
+    // 补丁只能应用在生成它的那个镜像上
+    mbedtls_sha256_context sha256;
+    uint8_t digest[32];
+    mbedtls_sha256_init(&sha256);
+    mbedtls_sha256_starts(&sha256, 0);
+    bool success = true;
+    for (size_t offset = 0; offset < base_size; offset += DELTA_COPY_BUFFER_SIZE) {
+        size_t length = std::min<size_t>(DELTA_COPY_BUFFER_SIZE, base_size - offset);
+        if (!base_reader_(offset, copy_buffer_, length)) {
+            success = false;
+            break;
+        }
+        mbedtls_sha256_update(&sha256, copy_buffer_, length);
+    }
+    mbedtls_sha256_finish(&sha256, digest);
+    mbedtls_sha256_free(&sha256);
+    if (!success || memcmp(digest, field_ + 12, sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "Patch was built against a different base image");
+        return false;
+    }
+
+    // 之后的 COPY 只能引用补丁生成时的基础镜像
+    base_size_ = base_size;
+    ESP_LOGI(TAG, "Applying patch, base %u bytes, target %u bytes", base_size, target_size_);
+    return true;
+}
+
+bool DeltaDecoder::Copy(uint32_t offset, uint32_t length) {
+    if ((uint64_t)offset + length > base_size_) {
+        ESP_LOGE(TAG, "Copy out of range: %lu+%lu", offset, length);
+        return false;
+    }
+    while (length > 0) {
+        size_t chunk = std::min<size_t>(length, DELTA_COPY_BUFFER_SIZE);
+        if (!base_reader_(offset, copy_buffer_, chunk) || !Output(copy_buffer_, chunk)) {
+            return false;
+        }
+        offset += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+bool DeltaDecoder::Output(const uint8_t* data, size_t size) {
+    if (output_size_ + size > target_size_) {
+        ESP_LOGE(TAG, "Patch output exceeds target size %u", target_size_);
+        return false;
+    }
+    output_size_ += size;
+    return writer_(data, size);
+}
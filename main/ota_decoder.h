@@ -0,0 +1,92 @@
+#ifndef _OTA_DECODER_H
+#define _OTA_DECODER_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <cstdint>
+
+/*
+ * Streaming decoders for compressed and delta firmware images
+ *
+ * "deflate": the app image compressed with zlib, inflated with the miniz inflater in ROM.
+ * "delta":   a zlib compressed patch against the running app image (scripts/ota_delta.py):
+ *
+ *   header  "XZD1", u32 target_size, u32 base_size, u8 base_sha256[32]
+ *   ops     u8 0x01 COPY   u32 base_offset, u32 length   copy from the running image
+ *           u8 0x02 INSERT u32 length, length bytes      new data
+ *           u8 0x00 END
+ *
+ * All integers are little-endian. Decoders push their output to the next stage and
+ * read the base image through a callback, so they keep no partition state themselves.
+ */
+
+class OtaDecoder {
+public:
+    // 返回 false 时中止解码
+    using Writer = std::function<bool(const uint8_t* data, size_t size)>;
+
+    virtual ~OtaDecoder() = default;
+    virtual bool Feed(const uint8_t* data, size_t size) = 0;
+    // 输入结束后调用，数据不完整时返回 false
+    virtual bool Finish() = 0;
+};
+
+class InflateDecoder : public OtaDecoder {
+public:
+    explicit InflateDecoder(Writer writer);
+    ~InflateDecoder();
+
+    bool Feed(const uint8_t* data, size_t size) override;
+    bool Finish() override;
+
+private:
+    Writer writer_;
+    struct tinfl_decompressor_tag* inflator_ = nullptr;
+    uint8_t* dict_ = nullptr;
+    size_t dict_offset_ = 0;
+    bool done_ = false;
+    bool failed_ = false;
+};
+
+class DeltaDecoder : public OtaDecoder {
+public:
+    using BaseReader = std::function<bool(uint32_t offset, uint8_t* data, size_t size)>;
+
+    // base_size 为基础镜像所在分区的大小，补丁头中记录的镜像大小不能超过它
+    DeltaDecoder(BaseReader base_reader, size_t base_size, Writer writer);
+    ~DeltaDecoder();
+
+    bool Feed(const uint8_t* data, size_t size) override;
+    bool Finish() override;
+    size_t target_size() const { return target_size_; }
+
+private:
+    enum State {
+        kStateHeader,
+        kStateOp,
+        kStateCopy,
+        kStateInsertLength,
+        kStateInsert,
+        kStateEnd,
+    };
+
+    BaseReader base_reader_;
+    size_t base_size_;
+    Writer writer_;
+    State state_ = kStateHeader;
+    uint8_t field_[44];
+    size_t field_size_ = 0;
+    size_t target_size_ = 0;
+    size_t output_size_ = 0;
+    uint32_t remaining_ = 0;
+    uint8_t* copy_buffer_ = nullptr;
+    bool failed_ = false;
+
+    bool Collect(const uint8_t*& data, size_t& size, size_t field_size);
+    bool VerifyHeader();
+    bool Copy(uint32_t offset, uint32_t length);
+    bool Output(const uint8_t* data, size_t size);
+};
+
+#endif // _OTA_DECODER_H
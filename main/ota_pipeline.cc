@@ -0,0 +1,249 @@
+#include "ota_pipeline.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <freertos/task.h>
+
+#include <cstring>
+#include <algorithm>
+
+#define TAG "OtaPipeline"
+
+#define WRITER_DONE_EVENT (1 << 0)
+#define PROGRESS_INTERVAL_US 1000000
+
+OtaPipeline::OtaPipeline(size_t buffer_size, int buffer_count)
+    : buffer_size_(buffer_size), buffer_count_(buffer_count) {
+    event_group_ = xEventGroupCreate();
+    free_queue_ = xQueueCreate(buffer_count_, sizeof(Buffer*));
+    // 多留一个位置给结束标记
+    filled_queue_ = xQueueCreate(buffer_count_ + 1, sizeof(Buffer*));
+
+    buffers_ = new Buffer[buffer_count_];
+    for (int i = 0; i < buffer_count_; i++) {
+        buffers_[i].data = (uint8_t*)heap_caps_malloc_prefer(buffer_size_, 2, MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+        buffers_[i].size = 0;
+        if (buffers_[i].data == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate %u bytes for buffer %d", buffer_size_, i);
+            continue;
+        }
+        Buffer* buffer = &buffers_[i];
+        xQueueSend(free_queue_, &buffer, 0);
+        allocated_count_++;
+    }
+    mbedtls_sha256_init(&sha256_);
+}
+
+OtaPipeline::~OtaPipeline() {
+    for (int i = 0; i < buffer_count_; i++) {
+        heap_caps_free(buffers_[i].data);
+    }
+    delete[] buffers_;
+    vQueueDelete(free_queue_);
+    vQueueDelete(filled_queue_);
+    vEventGroupDelete(event_group_);
+    mbedtls_sha256_free(&sha256_);
+}
+
+bool OtaPipeline::Run(Http* http, size_t total_bytes, Sink sink, size_t offset) {
+    // 少于两个缓冲区时下载与写入无法交替进行
+    if (allocated_count_ < 2) {
+        ESP_LOGE(TAG, "Only %d of %d buffers allocated, at least 2 are required", allocated_count_, buffer_count_);
+        return false;
+    }
+
+    if (offset > 0 && offset != prefix_size_) {
+        ESP_LOGE(TAG, "Resume offset %u does not match hashed prefix %u", offset, prefix_size_);
+        return false;
+    }
+
+    sink_ = sink;
+    aborted_ = false;
+    write_failed_ = false;
+    download_failed_ = false;
+    written_bytes_ = offset;
+    statistics_ = {};
+    if (offset == 0) {
+        mbedtls_sha256_starts(&sha256_, 0);
+    }
+    prefix_size_ = 0;
+    xEventGroupClearBits(event_group_, WRITER_DONE_EVENT);
+
+    // 写入任务与下载任务同优先级，交替占用 CPU
+    auto ret = xTaskCreate([](void* arg) {
+        auto pipeline = (OtaPipeline*)arg;
+        pipeline->WriterTask();
+        vTaskDelete(NULL);
+    }, "ota_writer", 4096, this, uxTaskPriorityGet(NULL), nullptr);
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create OTA writer task");
+        return false;
+    }
+
+    auto start_time = esp_timer_get_time();
+    auto last_report_time = start_time;
+    size_t downloaded = offset, recent_downloaded = 0;
+    bool eof = false;
+
+    while (!eof && !download_failed_ && !write_failed_ && !aborted_) {
+        Buffer* buffer = nullptr;
+        auto wait_start = esp_timer_get_time();
+        xQueueReceive(free_queue_, &buffer, portMAX_DELAY);
+        statistics_.download_stall_us += esp_timer_get_time() - wait_start;
+
+        buffer->size = 0;
+        while (buffer->size < buffer_size_ && !write_failed_ && !aborted_) {
+            int ret = http->Read((char*)buffer->data + buffer->size, buffer_size_ - buffer->size);
+            if (ret < 0) {
+                ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
+                download_failed_ = true;
+                break;
+            }
+            if (ret == 0) {
+                eof = true;
+                break;
+            }
+            buffer->size += ret;
+            downloaded += ret;
+            recent_downloaded += ret;
+
+            auto now = esp_timer_get_time();
+            if (now - last_report_time >= PROGRESS_INTERVAL_US) {
+                size_t written = written_bytes_;
+                OtaProgress progress = {
+                    .total_bytes = total_bytes,
+                    .downloaded_bytes = downloaded,
+                    .written_bytes = written,
+                    .speed = (size_t)(recent_downloaded * 1000000LL / (now - last_report_time)),
+                    .progress = total_bytes > 0 ? (int)((uint64_t)written * 100 / total_bytes) : 0,
+                };
+                ESP_LOGI(TAG, "Progress: %d%% (%u/%u), Speed: %uB/s", progress.progress, written, total_bytes, progress.speed);
+                if (on_progress_) {
+                    on_progress_(progress);
+                }
+                last_report_time = now;
+                recent_downloaded = 0;
+            }
+        }
+
+        // 出错时已读到的数据仍然写入，续传可以少下载一部分
+        if (buffer->size > 0 && !write_failed_ && !aborted_) {
+            xQueueSend(filled_queue_, &buffer, portMAX_DELAY);
+        } else {
+            xQueueSend(free_queue_, &buffer, portMAX_DELAY);
+        }
+    }
+
+    // 结束标记，等待写入任务处理完所有缓冲区
+    Buffer* end = nullptr;
+    xQueueSend(filled_queue_, &end, portMAX_DELAY);
+    xEventGroupWaitBits(event_group_, WRITER_DONE_EVENT, pdTRUE, pdTRUE, portMAX_DELAY);
+    statistics_.bytes = downloaded - offset;
+    statistics_.elapsed_us = esp_timer_get_time() - start_time;
+
+    if (write_failed_ || aborted_) {
+        return false;
+    }
+    if (download_failed_ || (total_bytes > 0 && downloaded != total_bytes)) {
+        ESP_LOGE(TAG, "Download incomplete: %u/%u", downloaded, total_bytes);
+        download_failed_ = true;
+        return false;
+    }
+    mbedtls_sha256_finish(&sha256_, sha256_digest_);
+
+    int64_t elapsed_ms = statistics_.elapsed_us / 1000;
+    ESP_LOGI(TAG, "Downloaded %u bytes in %lld ms (%lld B/s), download stall: %lld ms, writer idle: %lld ms, write: %lld ms",
+        statistics_.bytes, elapsed_ms, elapsed_ms > 0 ? (int64_t)statistics_.bytes * 1000 / elapsed_ms : 0,
+        statistics_.download_stall_us / 1000, statistics_.writer_idle_us / 1000, statistics_.write_us / 1000);
+
+    if (on_progress_) {
+        on_progress_({
+            .total_bytes = total_bytes,
+            .downloaded_bytes = downloaded,
+            .written_bytes = written_bytes_,
+            .speed = 0,
+            .progress = 100,
+        });
+    }
+    return true;
+}
+
+void OtaPipeline::WriterTask() {
+    while (true) {
+        Buffer* buffer = nullptr;
+        auto wait_start = esp_timer_get_time();
+        xQueueReceive(filled_queue_, &buffer, portMAX_DELAY);
+        statistics_.writer_idle_us += esp_timer_get_time() - wait_start;
+        if (buffer == nullptr) {
+            break;
+        }
+
+        if (!write_failed_ && !aborted_) {
+            auto write_start = esp_timer_get_time();
+            mbedtls_sha256_update(&sha256_, buffer->data, buffer->size);
+            if (sink_(buffer->data, buffer->size)) {
+                written_bytes_ += buffer->size;
+            } else {
+                write_failed_ = true;
+            }
+            statistics_.write_us += esp_timer_get_time() - write_start;
+        }
+        xQueueSend(free_queue_, &buffer, portMAX_DELAY);
+    }
+    xEventGroupSetBits(event_group_, WRITER_DONE_EVENT);
+}
+
+bool OtaPipeline::HashPrefix(const esp_partition_t* partition, size_t size, std::string& digest) {
+    Buffer* buffer = nullptr;
+    if (xQueueReceive(free_queue_, &buffer, 0) != pdTRUE) {
+        return false;
+    }
+
+    auto start_time = esp_timer_get_time();
+    mbedtls_sha256_starts(&sha256_, 0);
+    bool success = true;
+    for (size_t offset = 0; offset < size; offset += buffer_size_) {
+        size_t length = std::min(buffer_size_, size - offset);
+        if (esp_partition_read(partition, offset, buffer->data, length) != ESP_OK) {
+            success = false;
+            break;
+        }
+        mbedtls_sha256_update(&sha256_, buffer->data, length);
+    }
+    xQueueSend(free_queue_, &buffer, 0);
+    if (!success) {
+        ESP_LOGE(TAG, "Failed to read partition %s", partition->label);
+        return false;
+    }
+
+    prefix_size_ = size;
+    digest = GetRunningSha256();
+    ESP_LOGI(TAG, "Hashed %u bytes of partition %s in %lld ms", size, partition->label,
+        (esp_timer_get_time() - start_time) / 1000);
+    return true;
+}
+
+std::string OtaPipeline::GetRunningSha256() {
+    mbedtls_sha256_context context;
+    uint8_t digest[32];
+    mbedtls_sha256_init(&context);
+    mbedtls_sha256_clone(&context, &sha256_);
+    mbedtls_sha256_finish(&context, digest);
+    mbedtls_sha256_free(&context);
+    return ToHex(digest);
+}
+
+std::string OtaPipeline::GetSha256() const {
+    return ToHex(sha256_digest_);
+}
+
+std::string OtaPipeline::ToHex(const uint8_t* digest) {
+    std::string hex;
+    char byte[3];
+    for (int i = 0; i < 32; i++) {
+        snprintf(byte, sizeof(byte), "%02x", digest[i]);
+        hex += byte;
+    }
+    return hex;
+}
@@ -0,0 +1,94 @@
+#ifndef _OTA_PIPELINE_H
+#define _OTA_PIPELINE_H
+
+#include <functional>
+#include <string>
+#include <atomic>
+#include <memory>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/event_groups.h>
+#include <mbedtls/sha256.h>
+#include <esp_partition.h>
+#include <http.h>
+
+/*
+ * Download / flash write pipeline for OTA
+ *
+ * The calling task reads the HTTP body into large buffers (PSRAM when available) and a
+ * writer task hashes and writes the filled buffers, so network receive overlaps with
+ * flash erase / program. Buffers circulate between a free queue and a filled queue.
+ */
+
+struct OtaProgress {
+    size_t total_bytes;
+    size_t downloaded_bytes;
+    size_t written_bytes;
+    size_t speed;       // bytes/s over the last report interval
+    int progress;       // percent written
+};
+
+struct OtaPipelineStatistics {
+    size_t bytes = 0;
+    int64_t elapsed_us = 0;
+    int64_t download_stall_us = 0;  // 下载等待空闲缓冲区的时间，说明写 flash 更慢
+    int64_t writer_idle_us = 0;     // 写入任务等待数据的时间，说明网络更慢
+    int64_t write_us = 0;
+};
+
+class OtaPipeline {
+public:
+    // 返回 false 时中止下载
+    using Sink = std::function<bool(const uint8_t* data, size_t size)>;
+
+    OtaPipeline(size_t buffer_size, int buffer_count);
+    ~OtaPipeline();
+
+    void OnProgress(std::function<void(const OtaProgress&)> callback) { on_progress_ = callback; }
+
+    // 断点续传：读取分区中已写入的 size 字节作为哈希的前缀，digest 返回这部分的 SHA-256
+    bool HashPrefix(const esp_partition_t* partition, size_t size, std::string& digest);
+
+    // total_bytes 为 0 时不计算百分比；offset 是已写入的字节数，大于 0 时需先调用 HashPrefix()
+    bool Run(Http* http, size_t total_bytes, Sink sink, size_t offset = 0);
+    void Abort() { aborted_ = true; }
+    // 失败原因是网络而不是写入，可以断点续传重试
+    bool IsDownloadFailed() const { return download_failed_; }
+
+    // SHA-256 of the prefix and everything passed to the sink, valid after Run() returns true
+    std::string GetSha256() const;
+    // SHA-256 of the data hashed so far, only valid inside the sink
+    std::string GetRunningSha256();
+    const OtaPipelineStatistics& GetStatistics() const { return statistics_; }
+
+private:
+    struct Buffer {
+        uint8_t* data;
+        size_t size;
+    };
+
+    size_t buffer_size_;
+    int buffer_count_;
+    int allocated_count_ = 0;
+    Buffer* buffers_ = nullptr;
+    QueueHandle_t free_queue_ = nullptr;
+    QueueHandle_t filled_queue_ = nullptr;
+    EventGroupHandle_t event_group_ = nullptr;
+    std::atomic<bool> aborted_ = false;
+    std::atomic<bool> write_failed_ = false;
+    bool download_failed_ = false;
+    size_t prefix_size_ = 0;
+    std::atomic<size_t> written_bytes_ = 0;
+
+    Sink sink_;
+    mbedtls_sha256_context sha256_;
+    uint8_t sha256_digest_[32] = {0};
+    std::function<void(const OtaProgress&)> on_progress_;
+    OtaPipelineStatistics statistics_;
+
+    void WriterTask();
+    static std::string ToHex(const uint8_t* digest);
+};
+
+#endif // _OTA_PIPELINE_H
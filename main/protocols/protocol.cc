@@ -70,6 +70,17 @@ void Protocol::SendMcpMessage(const std::string& payload) {
     SendText(message);
 }
 
+void Protocol::SendTtsCacheHit(const std::string& hash) {
+    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"tts\",\"state\":\"cache_hit\",\"hash\":\"" + hash + "\"}";
+    SendText(message);
+}
+
+// 服务器只能发送序号不超过 credit 的音频包
+void Protocol::SendFlowCredit(uint32_t credit) {
+    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"flow\",\"credit\":" + std::to_string(credit) + "}";
+    SendText(message);
+}
+
 bool Protocol::IsTimeout() const {
     const int kTimeoutSeconds = 120;
     auto now = std::chrono::steady_clock::now();
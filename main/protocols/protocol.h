@@ -54,6 +54,10 @@ public:
     inline const std::string& session_id() const {
         return session_id_;
     }
+    // 最近收到的音频包序号，流控额度以此为基准
+    inline uint32_t incoming_audio_sequence() const {
+        return incoming_audio_sequence_;
+    }
 
     void OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback);
     void OnIncomingJson(std::function<void(const cJSON* root)> callback);
@@ -71,6 +75,8 @@ public:
     virtual void SendStopListening();
     virtual void SendAbortSpeaking(AbortReason reason);
     virtual void SendMcpMessage(const std::string& message);
+    virtual void SendTtsCacheHit(const std::string& hash);
+    virtual void SendFlowCredit(uint32_t credit);
 
 protected:
     std::function<void(const cJSON* root)> on_incoming_json_;
@@ -83,6 +89,7 @@ protected:
     int server_frame_duration_ = 60;
     bool error_occurred_ = false;
     std::string session_id_;
+    uint32_t incoming_audio_sequence_ = 0;
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
 
     virtual bool SendText(const std::string& text) = 0;
@@ -110,6 +110,8 @@ bool WebsocketProtocol::OpenAudioChannel() {
 
     websocket_->OnData([this](const char* data, size_t len, bool binary) {
         if (binary) {
+            // Websocket 没有包序号，按收到的二进制帧计数
+            incoming_audio_sequence_++;
             if (on_incoming_audio_ != nullptr) {
                 if (version_ == 2) {
                     BinaryProtocol2* bp2 = (BinaryProtocol2*)data;
@@ -171,6 +173,7 @@ bool WebsocketProtocol::OpenAudioChannel() {
         }
     });
 
+    incoming_audio_sequence_ = 0;
     ESP_LOGI(TAG, "Connecting to websocket server: %s with version: %d", url.c_str(), version_);
     if (!websocket_->Connect(url.c_str())) {
         ESP_LOGE(TAG, "Failed to connect to websocket server");
@@ -209,6 +212,11 @@ std::string WebsocketProtocol::GetHelloMessage() {
     cJSON_AddBoolToObject(features, "aec", true);
 #endif
     cJSON_AddBoolToObject(features, "mcp", true);
+    cJSON_AddBoolToObject(features, "flow_control", true);
+#if CONFIG_USE_TTS_CACHE
+    // 句子边界依赖 JSON 与音频同在一条有序的连接上，MQTT + UDP 不声明
+    cJSON_AddBoolToObject(features, "tts_cache", true);
+#endif
     cJSON_AddItemToObject(root, "features", features);
     cJSON_AddStringToObject(root, "transport", "websocket");
     cJSON* audio_params = cJSON_CreateObject();
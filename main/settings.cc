@@ -1,88 +1,340 @@
 #include "settings.h"
 
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_system.h>
 #include <nvs_flash.h>
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <vector>
+
 #define TAG "Settings"
 
-Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
-    nvs_open(ns.c_str(), read_write_ ? NVS_READWRITE : NVS_READONLY, &nvs_handle_);
-}
+// 提交失败后重试的间隔
+#define SETTINGS_FLUSH_RETRY_MS 10000
+
+namespace {
 
-Settings::~Settings() {
-    if (nvs_handle_ != 0) {
-        if (read_write_ && dirty_) {
-            ESP_ERROR_CHECK(nvs_commit(nvs_handle_));
+struct Entry {
+    nvs_type_t type = NVS_TYPE_ANY;
+    int32_t int_value = 0;
+    std::string string_value;
+    bool dirty = false;
+    bool erased = false;
+};
+
+struct Namespace {
+    bool erase_all = false;
+    std::map<std::string, Entry> entries;
+};
+
+class SettingsCache {
+public:
+    static SettingsCache& GetInstance() {
+        static SettingsCache instance;
+        return instance;
+    }
+
+    // 返回 false 表示键不存在或类型不匹配
+    bool Get(const std::string& ns, const std::string& key, nvs_type_t type, Entry& entry) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& entries = Load(ns).entries;
+        statistics_.cache_reads++;
+        auto it = entries.find(key);
+        if (it == entries.end() || it->second.erased || it->second.type != type) {
+            return false;
         }
-        nvs_close(nvs_handle_);
+        entry = it->second;
+        return true;
     }
-}
 
-std::string Settings::GetString(const std::string& key, const std::string& default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
+    void Set(const std::string& ns, const std::string& key, nvs_type_t type, int32_t int_value, const std::string& string_value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& entry = Load(ns).entries[key];
+        if (!entry.erased && entry.type == type && entry.int_value == int_value && entry.string_value == string_value) {
+            return;
+        }
+        entry.type = type;
+        entry.int_value = int_value;
+        entry.string_value = string_value;
+        entry.erased = false;
+        entry.dirty = true;
+        ScheduleFlush();
     }
 
-    size_t length = 0;
-    if (nvs_get_str(nvs_handle_, key.c_str(), nullptr, &length) != ESP_OK) {
-        return default_value;
+    void Erase(const std::string& ns, const std::string& key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& entries = Load(ns).entries;
+        auto it = entries.find(key);
+        if (it == entries.end() || it->second.erased) {
+            return;
+        }
+        it->second.erased = true;
+        it->second.dirty = true;
+        ScheduleFlush();
+    }
+
+    void EraseAll(const std::string& ns) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& space = Load(ns);
+        space.entries.clear();
+        space.erase_all = true;
+        ScheduleFlush();
+    }
+
+    void Flush() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        esp_timer_stop(flush_timer_);
+        bool success = true;
+        for (auto& [ns, space] : namespaces_) {
+            success &= FlushNamespace(ns, space);
+        }
+        // 失败的修改仍然是脏的，稍后再试
+        if (!success) {
+            ScheduleFlush(SETTINGS_FLUSH_RETRY_MS);
+        }
+    }
+
+    SettingsStatistics GetStatistics() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return statistics_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<std::string, Namespace> namespaces_;
+    esp_timer_handle_t flush_timer_ = nullptr;
+    std::atomic<bool> flush_task_running_ = false;
+    SettingsStatistics statistics_;
+
+    SettingsCache() {
+        esp_timer_create_args_t flush_timer_args = {
+            .callback = [](void* arg) {
+                static_cast<SettingsCache*>(arg)->StartFlushTask();
+            },
+            .arg = this,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "settings_flush",
+            .skip_unhandled_events = true,
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&flush_timer_args, &flush_timer_));
+
+        // esp_restart() 之前写入尚未提交的修改
+        esp_register_shutdown_handler([]() {
+            SettingsCache::GetInstance().Flush();
+        });
     }
 
-    std::string value;
-    value.resize(length);
-    ESP_ERROR_CHECK(nvs_get_str(nvs_handle_, key.c_str(), value.data(), &length));
-    while (!value.empty() && value.back() == '\0') {
-        value.pop_back();
+    // Called with mutex_ held, 每次写入都会推迟提交，连续的修改只提交一次
+    void ScheduleFlush(int delay_ms = SETTINGS_FLUSH_DELAY_MS) {
+        esp_timer_stop(flush_timer_);
+        esp_timer_start_once(flush_timer_, delay_ms * 1000);
     }
-    return value;
+
+    // NVS 提交会擦写 flash，可能耗时几十毫秒，不在 esp_timer 任务中执行
+    void StartFlushTask() {
+        if (flush_task_running_.exchange(true)) {
+            return;
+        }
+        auto ret = xTaskCreate([](void* arg) {
+            auto cache = static_cast<SettingsCache*>(arg);
+            cache->Flush();
+            cache->flush_task_running_ = false;
+            vTaskDelete(NULL);
+        }, "settings_flush", 4096, this, 1, nullptr);
+        if (ret != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create settings flush task");
+            flush_task_running_ = false;
+            std::lock_guard<std::mutex> lock(mutex_);
+            ScheduleFlush(SETTINGS_FLUSH_RETRY_MS);
+        }
+    }
+
+    // Called with mutex_ held
+    Namespace& Load(const std::string& ns) {
+        auto it = namespaces_.find(ns);
+        if (it != namespaces_.end()) {
+            return it->second;
+        }
+
+        auto& space = namespaces_[ns];
+        nvs_handle_t handle;
+        if (nvs_open(ns.c_str(), NVS_READONLY, &handle) != ESP_OK) {
+            return space;
+        }
+
+        nvs_iterator_t iterator = nullptr;
+        esp_err_t ret = nvs_entry_find(NVS_DEFAULT_PART_NAME, ns.c_str(), NVS_TYPE_ANY, &iterator);
+        while (ret == ESP_OK) {
+            nvs_entry_info_t info;
+            nvs_entry_info(iterator, &info);
+
+            // Settings 只会写入 i32 / u8 / str，其他类型的键由别的模块管理
+            Entry entry;
+            entry.type = info.type;
+            bool loaded = false;
+            if (info.type == NVS_TYPE_I32) {
+                loaded = nvs_get_i32(handle, info.key, &entry.int_value) == ESP_OK;
+            } else if (info.type == NVS_TYPE_U8) {
+                uint8_t value;
+                loaded = nvs_get_u8(handle, info.key, &value) == ESP_OK;
+                entry.int_value = value;
+            } else if (info.type == NVS_TYPE_STR) {
+                size_t length = 0;
+                if (nvs_get_str(handle, info.key, nullptr, &length) == ESP_OK) {
+                    entry.string_value.resize(length);
+                    loaded = nvs_get_str(handle, info.key, entry.string_value.data(), &length) == ESP_OK;
+                    while (!entry.string_value.empty() && entry.string_value.back() == '\0') {
+                        entry.string_value.pop_back();
+                    }
+                }
+            }
+            if (loaded) {
+                statistics_.nvs_reads++;
+                space.entries[info.key] = std::move(entry);
+            }
+            ret = nvs_entry_next(&iterator);
+        }
+        nvs_release_iterator(iterator);
+        nvs_close(handle);
+
+        ESP_LOGD(TAG, "Loaded %u keys from namespace %s", (unsigned)space.entries.size(), ns.c_str());
+        return space;
+    }
+
+    // Called with mutex_ held, 返回 false 表示有修改没有提交成功，这些修改保持为脏
+    bool FlushNamespace(const std::string& ns, Namespace& space) {
+        bool dirty = space.erase_all;
+        for (auto& [key, entry] : space.entries) {
+            dirty |= entry.dirty;
+        }
+        if (!dirty) {
+            return true;
+        }
+
+        nvs_handle_t handle;
+        esp_err_t ret = nvs_open(ns.c_str(), NVS_READWRITE, &handle);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to open namespace %s: %s", ns.c_str(), esp_err_to_name(ret));
+            return false;
+        }
+
+        // 擦除失败时不写入其他修改，否则重试擦除时会把它们一起擦掉
+        if (space.erase_all) {
+            ret = nvs_erase_all(handle);
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to erase namespace %s: %s", ns.c_str(), esp_err_to_name(ret));
+                nvs_close(handle);
+                return false;
+            }
+        }
+
+        bool success = true;
+
+        std::vector<std::string> written;
+        for (auto& [key, entry] : space.entries) {
+            if (!entry.dirty) {
+                continue;
+            }
+            if (entry.erased) {
+                ret = nvs_erase_key(handle, key.c_str());
+                if (ret == ESP_ERR_NVS_NOT_FOUND) {
+                    ret = ESP_OK;
+                }
+            } else if (entry.type == NVS_TYPE_I32) {
+                ret = nvs_set_i32(handle, key.c_str(), entry.int_value);
+            } else if (entry.type == NVS_TYPE_U8) {
+                ret = nvs_set_u8(handle, key.c_str(), entry.int_value);
+            } else {
+                ret = nvs_set_str(handle, key.c_str(), entry.string_value.c_str());
+            }
+            statistics_.nvs_writes++;
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to write %s.%s: %s", ns.c_str(), key.c_str(), esp_err_to_name(ret));
+                success = false;
+            } else {
+                written.push_back(key);
+            }
+        }
+
+        ret = nvs_commit(handle);
+        statistics_.nvs_commits++;
+        nvs_close(handle);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to commit namespace %s: %s", ns.c_str(), esp_err_to_name(ret));
+            return false;
+        }
+
+        // 只有提交成功的修改才清除脏标记
+        space.erase_all = false;
+        for (const auto& key : written) {
+            auto it = space.entries.find(key);
+            if (it->second.erased) {
+                space.entries.erase(it);
+            } else {
+                it->second.dirty = false;
+            }
+        }
+
+        ESP_LOGI(TAG, "Committed namespace %s, NVS reads: %lu, writes: %lu, commits: %lu", ns.c_str(),
+            statistics_.nvs_reads, statistics_.nvs_writes, statistics_.nvs_commits);
+        return success;
+    }
+};
+
+} // namespace
+
+Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
+}
+
+std::string Settings::GetString(const std::string& key, const std::string& default_value) {
+    Entry entry;
+    if (!SettingsCache::GetInstance().Get(ns_, key, NVS_TYPE_STR, entry)) {
+        return default_value;
+    }
+    return entry.string_value;
 }
 
 void Settings::SetString(const std::string& key, const std::string& value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_str(nvs_handle_, key.c_str(), value.c_str()));
-        dirty_ = true;
+        SettingsCache::GetInstance().Set(ns_, key, NVS_TYPE_STR, 0, value);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
 
 int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
-    }
-
-    int32_t value;
-    if (nvs_get_i32(nvs_handle_, key.c_str(), &value) != ESP_OK) {
+    Entry entry;
+    if (!SettingsCache::GetInstance().Get(ns_, key, NVS_TYPE_I32, entry)) {
         return default_value;
     }
-    return value;
+    return entry.int_value;
 }
 
 void Settings::SetInt(const std::string& key, int32_t value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_i32(nvs_handle_, key.c_str(), value));
-        dirty_ = true;
+        SettingsCache::GetInstance().Set(ns_, key, NVS_TYPE_I32, value, "");
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
 
 bool Settings::GetBool(const std::string& key, bool default_value) {
-    if (nvs_handle_ == 0) {
+    Entry entry;
+    if (!SettingsCache::GetInstance().Get(ns_, key, NVS_TYPE_U8, entry)) {
         return default_value;
     }
-
-    uint8_t value;
-    if (nvs_get_u8(nvs_handle_, key.c_str(), &value) != ESP_OK) {
-        return default_value;
-    }
-    return value != 0;
+    return entry.int_value != 0;
 }
 
 void Settings::SetBool(const std::string& key, bool value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_u8(nvs_handle_, key.c_str(), value ? 1 : 0));
-        dirty_ = true;
+        SettingsCache::GetInstance().Set(ns_, key, NVS_TYPE_U8, value ? 1 : 0, "");
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -90,10 +342,7 @@ void Settings::SetBool(const std::string& key, bool value) {
 
 void Settings::EraseKey(const std::string& key) {
     if (read_write_) {
-        auto ret = nvs_erase_key(nvs_handle_, key.c_str());
-        if (ret != ESP_ERR_NVS_NOT_FOUND) {
-            ESP_ERROR_CHECK(ret);
-        }
+        SettingsCache::GetInstance().Erase(ns_, key);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -101,8 +350,16 @@ void Settings::EraseKey(const std::string& key) {
 
 void Settings::EraseAll() {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_erase_all(nvs_handle_));
+        SettingsCache::GetInstance().EraseAll(ns_);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
+
+void Settings::Flush() {
+    SettingsCache::GetInstance().Flush();
+}
+
+SettingsStatistics Settings::GetStatistics() {
+    return SettingsCache::GetInstance().GetStatistics();
+}
@@ -4,10 +4,26 @@
 #include <string>
 #include <nvs_flash.h>
 
+/*
+ * Settings are served from a process-wide RAM cache, each namespace is read from NVS
+ * once on first use. Writes only update the cache and are committed to NVS after
+ * SETTINGS_FLUSH_DELAY_MS without further writes (on a short-lived task, not in the
+ * esp_timer task), or immediately by Flush(). Writes that fail stay pending and are
+ * retried later. Pending writes are also flushed by esp_restart().
+ */
+
+#define SETTINGS_FLUSH_DELAY_MS 3000
+
+struct SettingsStatistics {
+    uint32_t nvs_reads = 0;
+    uint32_t nvs_writes = 0;
+    uint32_t nvs_commits = 0;
+    uint32_t cache_reads = 0;
+};
+
 class Settings {
 public:
     Settings(const std::string& ns, bool read_write = false);
-    ~Settings();
 
     std::string GetString(const std::string& key, const std::string& default_value = "");
     void SetString(const std::string& key, const std::string& value);
@@ -18,11 +34,13 @@ public:
     void EraseKey(const std::string& key);
     void EraseAll();
 
+    // Commit pending writes of all namespaces now, e.g. before OTA or deep sleep
+    static void Flush();
+    static SettingsStatistics GetStatistics();
+
 private:
     std::string ns_;
-    nvs_handle_t nvs_handle_ = 0;
     bool read_write_ = false;
-    bool dirty_ = false;
 };
 
 #endif
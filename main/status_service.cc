@@ -0,0 +1,136 @@
+#include "status_service.h"
+#include "application.h"
+#include "board.h"
+#include "display_queue.h"
+#include "audio_codec.h"
+#include "font_awesome_symbols.h"
+#include "assets/lang_config.h"
+
+#include <esp_log.h>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#define TAG "StatusService"
+
+#define STATUS_BATTERY_INTERVAL_SECONDS 5
+#define STATUS_NETWORK_INTERVAL_SECONDS 10
+
+StatusService::StatusService(DisplayQueue* display_queue) : display_queue_(display_queue) {
+    // Create a power management lock
+    auto ret = esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "status_update", &pm_lock_);
+    if (ret == ESP_ERR_NOT_SUPPORTED) {
+        ESP_LOGI(TAG, "Power management not supported");
+    } else {
+        ESP_ERROR_CHECK(ret);
+    }
+
+    xTaskCreate([](void* arg) {
+        StatusService* service = (StatusService*)arg;
+        service->StatusTask();
+        vTaskDelete(NULL);
+    }, "status_service", 4096, this, 1, &task_handle_);
+}
+
+StatusService::~StatusService() {
+    if (task_handle_ != nullptr) {
+        vTaskDelete(task_handle_);
+    }
+    if (pm_lock_ != nullptr) {
+        esp_pm_lock_delete(pm_lock_);
+    }
+}
+
+void StatusService::Refresh() {
+    xTaskNotifyGive(task_handle_);
+}
+
+void StatusService::StatusTask() {
+    bool update_all = true;
+    while (true) {
+        Update(update_all);
+        // 被 Refresh 唤醒时立即采样所有数据源
+        update_all = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000)) > 0;
+    }
+}
+
+void StatusService::Update(bool update_all) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& app = Application::GetInstance();
+    auto& board = Board::GetInstance();
+    uint32_t ticks = ticks_++;
+
+    // Mute icon
+    auto codec = board.GetAudioCodec();
+    bool muted = codec->output_volume() == 0;
+    if (update_all || muted != muted_) {
+        muted_ = muted;
+        display_queue_->SetMuted(muted_);
+    }
+
+    // Clock "HH:MM", shown by the display when the status text is idle
+    time_t now = time(NULL);
+    struct tm* tm = localtime(&now);
+    // Check if the we have already set the time
+    if (tm->tm_year >= 2025 - 1900) {
+        char time_str[16];
+        strftime(time_str, sizeof(time_str), "%H:%M  ", tm);
+        if (clock_ != time_str) {
+            clock_ = time_str;
+            display_queue_->SetClock(time_str);
+        }
+    }
+
+    // Battery
+    if (update_all || ticks % STATUS_BATTERY_INTERVAL_SECONDS == 0) {
+        esp_pm_lock_acquire(pm_lock_);
+        int battery_level;
+        bool charging, discharging;
+        if (board.GetBatteryLevel(battery_level, charging, discharging)) {
+            const char* icon = nullptr;
+            if (charging) {
+                icon = FONT_AWESOME_BATTERY_CHARGING;
+            } else {
+                const char* levels[] = {
+                    FONT_AWESOME_BATTERY_EMPTY, // 0-19%
+                    FONT_AWESOME_BATTERY_1,    // 20-39%
+                    FONT_AWESOME_BATTERY_2,    // 40-59%
+                    FONT_AWESOME_BATTERY_3,    // 60-79%
+                    FONT_AWESOME_BATTERY_FULL, // 80-99%
+                    FONT_AWESOME_BATTERY_FULL, // 100%
+                };
+                icon = levels[std::clamp(battery_level, 0, 100) / 20];
+            }
+            bool low_battery = strcmp(icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && discharging;
+            if (update_all || icon != battery_icon_ || low_battery != low_battery_) {
+                if (low_battery && !low_battery_) {
+                    app.PlaySound(Lang::Sounds::P3_LOW_BATTERY);
+                }
+                battery_icon_ = icon;
+                low_battery_ = low_battery;
+                display_queue_->SetBatteryIcon(battery_icon_, low_battery_);
+            }
+        }
+        esp_pm_lock_release(pm_lock_);
+    }
+
+    // Network
+    if (update_all || ticks % STATUS_NETWORK_INTERVAL_SECONDS == 0) {
+        // 升级固件时，不读取 4G 网络状态，避免占用 UART 资源
+        auto device_state = app.GetDeviceState();
+        static const std::vector<DeviceState> allowed_states = {
+            kDeviceStateIdle,
+            kDeviceStateStarting,
+            kDeviceStateWifiConfiguring,
+            kDeviceStateListening,
+            kDeviceStateActivating,
+        };
+        if (std::find(allowed_states.begin(), allowed_states.end(), device_state) != allowed_states.end()) {
+            const char* icon = board.GetNetworkStateIcon();
+            if (icon != nullptr && (update_all || icon != network_icon_)) {
+                network_icon_ = icon;
+                display_queue_->SetNetworkIcon(network_icon_);
+            }
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef _STATUS_SERVICE_H_
+#define _STATUS_SERVICE_H_
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_pm.h>
+
+#include <string>
+#include <mutex>
+
+class DisplayQueue;
+
+/*
+ * Status bar model
+ *
+ * A background task samples each status source at its own rate (mute and clock every
+ * second, battery every 5 seconds, network every 10 seconds) and only pushes the fields
+ * that changed to the display queue. Slow board I/O (PMIC over I2C, AT commands over UART)
+ * never runs in the esp_timer task or the UI task, and the display lock is only taken by
+ * the UI task that drains the queue.
+ */
+class StatusService {
+public:
+    StatusService(DisplayQueue* display_queue);
+    ~StatusService();
+
+    // Sample every source now and push all changes, e.g. right after the network is up
+    void Refresh();
+    // Sample and apply synchronously in the calling task
+    void Update(bool update_all);
+
+private:
+    DisplayQueue* display_queue_;
+    TaskHandle_t task_handle_ = nullptr;
+    esp_pm_lock_handle_t pm_lock_ = nullptr;
+    std::mutex mutex_;
+    uint32_t ticks_ = 0;
+
+    bool muted_ = false;
+    bool low_battery_ = false;
+    const char* battery_icon_ = nullptr;
+    const char* network_icon_ = nullptr;
+    std::string clock_;
+
+    void StatusTask();
+};
+
+#endif // _STATUS_SERVICE_H_
@@ -0,0 +1,59 @@
+#! /usr/bin/env python3
+"""
+生成字体分区镜像
+
+字体使用 lv_font_conv 生成 LVGL 二进制格式（必须关闭压缩），例如：
+    lv_font_conv --font AlibabaPuHuiTi.ttf -r 0x20-0x7F -r 0x4E00-0x9FA5 --size 20 --bpp 4 \\
+        --format bin --no-compress -o text.bin
+
+然后打包并烧录到 fonts 分区：
+    python scripts/build_font_partition.py -o fonts.bin text=text.bin icon=icon.bin
+    esptool.py write_flash <fonts 分区偏移> fonts.bin
+"""
+import argparse
+import struct
+
+MAGIC = b"XZFP"
+NAME_LENGTH = 32
+ALIGNMENT = 4
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Build the font partition image")
+    parser.add_argument("-o", "--output", required=True, help="output image")
+    parser.add_argument("fonts", nargs="+", help="name=path of an LVGL binary font")
+    args = parser.parse_args()
+
+    fonts = []
+    for item in args.fonts:
+        name, path = item.split("=", 1)
+        if len(name.encode()) > NAME_LENGTH:
+            raise ValueError(f"Font name too long: {name}")
+        with open(path, "rb") as f:
+            data = f.read()
+        if data[4:8] != b"head":
+            raise ValueError(f"{path} is not an LVGL binary font")
+        # head 表中的 compression_id
+        if data[8 + 33] != 0:
+            raise ValueError(f"{path} is compressed, rebuild it with --no-compress")
+        fonts.append((name, data))
+
+    offset = len(MAGIC) + 4 + len(fonts) * (NAME_LENGTH + 8)
+    header = MAGIC + struct.pack("<I", len(fonts))
+    body = b""
+    for name, data in fonts:
+        padding = (-offset) % ALIGNMENT
+        body += b"\0" * padding
+        offset += padding
+        header += name.encode().ljust(NAME_LENGTH, b"\0") + struct.pack("<II", offset, len(data))
+        body += data
+        offset += len(data)
+        print(f"{name}: {len(data)} bytes")
+
+    with open(args.output, "wb") as f:
+        f.write(header + body)
+    print(f"Font partition image: {args.output}, {offset} bytes")
+
+
+if __name__ == "__main__":
+    main()
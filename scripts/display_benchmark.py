@@ -0,0 +1,223 @@
+#!/usr/bin/env python3
+"""
+Record and check the display benchmark (CONFIG_DISPLAY_BENCHMARK, see
+main/display/display_benchmark.h) from a serial log.
+
+    # save the log of a benchmark run
+    idf.py monitor | tee benchmark.log
+
+    # store the CRCs (and, with CONFIG_DISPLAY_BENCHMARK_SCREENSHOTS, PNG screenshots)
+    # as the reference of this board build
+    python scripts/display_benchmark.py record benchmark.log
+
+    # compare a later run with the stored reference, exit code 1 on any difference
+    python scripts/display_benchmark.py check benchmark.log -o actual/
+
+References live in main/boards/<board>/display_benchmark/<name>-<lang>-<theme>.json,
+screenshots in a directory of the same name next to it. Each board build in
+config.json covers one resolution and font, so record one reference per build.
+"""
+import argparse
+import base64
+import json
+import os
+import re
+import struct
+import sys
+import zlib
+
+BOARDS_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'main', 'boards')
+
+ANSI_RE = re.compile(r'\x1b\[[0-9;]*m')
+HEADER_RE = re.compile(r'DisplayBenchmark: Benchmark board=(\S+) name=(\S+) size=(\d+)x(\d+) font=(\d+) '
+                       r'lang=(\S+) theme=(\S+) steps=(\d+)')
+STEP_RE = re.compile(r'DisplayBenchmark: (\S+)\s+(-?\d+)\s+(-?\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+) crc=([0-9a-f]{8})')
+FRAME_RE = re.compile(r'^DBF (\S+) (\d+) (\d+) (\d+) (\d+)/(\d+) (\S+)$')
+
+# 渲染耗时超过参考值的这个比例时提示（不作为失败条件，耗时受 flash 缓存等影响）
+RENDER_TIME_WARN_RATIO = 1.2
+
+
+def parse_log(path):
+    """Return the runs found in the log, each with its header, steps and screenshots."""
+    runs = []
+    run = None
+    with open(path, 'r', encoding='utf-8', errors='replace') as f:
+        for line in f:
+            line = ANSI_RE.sub('', line).strip()
+            m = HEADER_RE.search(line)
+            if m:
+                run = {
+                    'board': m.group(1), 'name': m.group(2),
+                    'width': int(m.group(3)), 'height': int(m.group(4)), 'font': int(m.group(5)),
+                    'lang': m.group(6), 'theme': m.group(7), 'step_count': int(m.group(8)),
+                    'steps': [], 'frames': {},
+                }
+                runs.append(run)
+                continue
+            if run is None:
+                continue
+            m = FRAME_RE.match(line)
+            if m:
+                step = m.group(1)
+                frame = run['frames'].setdefault(step, {
+                    'width': int(m.group(2)), 'height': int(m.group(3)), 'stride': int(m.group(4)),
+                    'count': int(m.group(6)), 'chunks': {},
+                })
+                frame['chunks'][int(m.group(5))] = m.group(7)
+                continue
+            m = STEP_RE.search(line)
+            if m:
+                run['steps'].append({
+                    'name': m.group(1), 'apply_us': int(m.group(2)), 'render_us': int(m.group(3)),
+                    'flushes': int(m.group(4)), 'bytes': int(m.group(5)),
+                    'internal': int(m.group(6)), 'spiram': int(m.group(7)), 'crc': m.group(8),
+                })
+    return runs
+
+
+def last_complete_run(path):
+    runs = [run for run in parse_log(path) if len(run['steps']) == run['step_count']]
+    if not runs:
+        sys.exit(f'{path}: no complete benchmark run found')
+    return runs[-1]
+
+
+def reference_path(run, boards_dir):
+    key = f"{run['name']}-{run['lang']}-{run['theme']}"
+    return os.path.join(boards_dir, run['board'], 'display_benchmark', key + '.json')
+
+
+def frame_pixels(frame):
+    """Decode the RGB565 screenshot of one step, None if lines are missing."""
+    if len(frame['chunks']) != frame['count']:
+        return None
+    return b''.join(base64.b64decode(frame['chunks'][i]) for i in range(frame['count']))
+
+
+def write_png(path, frame):
+    data = frame_pixels(frame)
+    if data is None:
+        print(f'{path}: screenshot is incomplete, skipped')
+        return False
+    width, height, stride = frame['width'], frame['height'], frame['stride']
+    raw = bytearray()
+    for y in range(height):
+        raw.append(0)  # 不使用行过滤
+        row = data[y * stride:y * stride + width * 2]
+        for (pixel,) in struct.iter_unpack('<H', row):
+            r, g, b = pixel >> 11, (pixel >> 5) & 0x3F, pixel & 0x1F
+            raw += bytes(((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)))
+
+    def chunk(kind, body):
+        return struct.pack('>I', len(body)) + kind + body + struct.pack('>I', zlib.crc32(kind + body))
+
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, 'wb') as f:
+        f.write(b'\x89PNG\r\n\x1a\n')
+        f.write(chunk(b'IHDR', struct.pack('>IIBBBBB', width, height, 8, 2, 0, 0, 0)))
+        f.write(chunk(b'IDAT', zlib.compress(bytes(raw), 9)))
+        f.write(chunk(b'IEND', b''))
+    return True
+
+
+def write_screenshots(run, directory, steps=None):
+    count = 0
+    for name, frame in run['frames'].items():
+        if steps is None or name in steps:
+            count += write_png(os.path.join(directory, name + '.png'), frame)
+    return count
+
+
+def cmd_record(args):
+    run = last_complete_run(args.log)
+    for step in run['steps']:
+        if step['crc'] == '00000000':
+            sys.exit(f"step {step['name']}: snapshot failed on the device, not recording")
+
+    path = args.reference or reference_path(run, args.boards_dir)
+    reference = {key: run[key] for key in ('board', 'name', 'width', 'height', 'font', 'lang', 'theme')}
+    reference['steps'] = {step['name']: {'crc': step['crc'], 'render_us': step['render_us'],
+                                         'bytes': step['bytes']} for step in run['steps']}
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, 'w', encoding='utf-8') as f:
+        json.dump(reference, f, indent=2)
+        f.write('\n')
+    print(f"Recorded {len(run['steps'])} steps of {run['name']} ({run['width']}x{run['height']}) to {path}")
+
+    if run['frames']:
+        screenshots = os.path.splitext(path)[0]
+        print(f'Wrote {write_screenshots(run, screenshots)} screenshots to {screenshots}')
+    return 0
+
+
+def cmd_check(args):
+    run = last_complete_run(args.log)
+    path = args.reference or reference_path(run, args.boards_dir)
+    if not os.path.exists(path):
+        print(f"No reference for {run['name']} at {path}, record one with: "
+              f"python scripts/display_benchmark.py record {args.log}")
+        return 1
+    with open(path, 'r', encoding='utf-8') as f:
+        reference = json.load(f)
+
+    errors = []
+    for key in ('width', 'height', 'font', 'lang', 'theme'):
+        if reference[key] != run[key]:
+            errors.append(f'{key} is {run[key]}, reference has {reference[key]}')
+
+    expected = reference['steps']
+    actual = {step['name']: step for step in run['steps']}
+    mismatched = []
+    print(f"{'step':20} {'crc':>8} {'reference':>9} {'render_us':>10} {'reference':>10}")
+    for name, step in actual.items():
+        ref = expected.get(name)
+        if ref is None:
+            errors.append(f'step {name} is not in the reference')
+            continue
+        status = ''
+        if step['crc'] != ref['crc']:
+            mismatched.append(name)
+            status = 'MISMATCH'
+        elif step['render_us'] > ref['render_us'] * RENDER_TIME_WARN_RATIO:
+            status = 'slower'
+        print(f"{name:20} {step['crc']:>8} {ref['crc']:>9} {step['render_us']:>10} {ref['render_us']:>10} {status}")
+    for name in expected:
+        if name not in actual:
+            errors.append(f'step {name} is missing from the run')
+    errors += [f'step {name}: rendering differs from the reference' for name in mismatched]
+
+    if mismatched and args.output and run['frames']:
+        count = write_screenshots(run, args.output, set(mismatched))
+        print(f'Wrote {count} screenshots of the mismatched steps to {args.output}')
+
+    for error in errors:
+        print('ERROR:', error)
+    if errors:
+        return 1
+    print(f"{run['name']}: all {len(actual)} steps match {path}")
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--boards-dir', default=BOARDS_DIR, help='where references are stored per board')
+    sub = parser.add_subparsers(dest='command', required=True)
+
+    p = sub.add_parser('record', help='store the last run in the log as the reference')
+    p.add_argument('log')
+    p.add_argument('--reference', help='reference file, default derived from the board build')
+    p.set_defaults(func=cmd_record)
+
+    p = sub.add_parser('check', help='compare the last run in the log with the reference')
+    p.add_argument('log')
+    p.add_argument('--reference', help='reference file, default derived from the board build')
+    p.add_argument('-o', '--output', help='write screenshots of mismatched steps here')
+    p.set_defaults(func=cmd_check)
+
+    args = parser.parse_args()
+    sys.exit(args.func(args))
+
+
+if __name__ == '__main__':
+    main()
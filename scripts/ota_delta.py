@@ -0,0 +1,255 @@
+#!/usr/bin/env python3
+"""
+Build compressed and delta firmware images for OTA (see main/ota_decoder.h).
+
+    # zlib compressed image, advertise "format": "deflate"
+    python scripts/ota_delta.py compress build/xiaozhi.bin -o xiaozhi.bin.z
+
+    # patch against the firmware running on the device, advertise
+    # "format": "delta" and "base_version": <version of old.bin>
+    python scripts/ota_delta.py diff --base old.bin build/xiaozhi.bin -o xiaozhi.patch
+
+    # decode an image the same way the device does
+    python scripts/ota_delta.py apply xiaozhi.patch --base old.bin -o new.bin
+
+    # regenerate the test vectors decoded by test_apps/ota_decoder on the device
+    python scripts/ota_delta.py fixtures -o test_apps/ota_decoder/main/fixtures
+
+compress and diff decode their output again and compare it with the input before
+writing, so a broken image is never produced.
+"""
+import argparse
+import hashlib
+import os
+import random
+import struct
+import sys
+import zlib
+
+DELTA_MAGIC = b'XZD1'
+OP_END = 0x00
+OP_COPY = 0x01
+OP_INSERT = 0x02
+
+# 基础镜像每隔 STEP 字节取一个 KEY 字节的块建立索引
+KEY = 32
+STEP = 8
+# 短于该长度的匹配不如直接插入
+MIN_MATCH = 32
+
+
+def make_patch(base, target):
+    index = {}
+    for offset in range(0, len(base) - KEY + 1, STEP):
+        index.setdefault(base[offset:offset + KEY], offset)
+
+    ops = []
+    insert_start = 0
+    position = 0
+    while position + KEY <= len(target):
+        base_offset = index.get(target[position:position + KEY])
+        if base_offset is None:
+            position += 1
+            continue
+
+        # 向前扩展到未输出的插入数据中，再向后扩展
+        start, base_start = position, base_offset
+        while start > insert_start and base_start > 0 and target[start - 1] == base[base_start - 1]:
+            start -= 1
+            base_start -= 1
+        end, base_end = position + KEY, base_offset + KEY
+        while end < len(target) and base_end < len(base) and target[end] == base[base_end]:
+            end += 1
+            base_end += 1
+
+        if end - start < MIN_MATCH:
+            position += 1
+            continue
+        if start > insert_start:
+            ops.append((OP_INSERT, target[insert_start:start]))
+        ops.append((OP_COPY, base_start, end - start))
+        insert_start = position = end
+
+    if insert_start < len(target):
+        ops.append((OP_INSERT, target[insert_start:]))
+
+    out = bytearray(DELTA_MAGIC)
+    out += struct.pack('<II', len(target), len(base))
+    out += hashlib.sha256(base).digest()
+    for op in ops:
+        if op[0] == OP_COPY:
+            out += struct.pack('<BII', OP_COPY, op[1], op[2])
+        else:
+            out += struct.pack('<BI', OP_INSERT, len(op[1]))
+            out += op[1]
+    out.append(OP_END)
+    return bytes(out), ops
+
+
+def apply_patch(patch, base):
+    if patch[:4] != DELTA_MAGIC:
+        raise ValueError('invalid patch magic')
+    target_size, base_size = struct.unpack_from('<II', patch, 4)
+    if base_size > len(base) or hashlib.sha256(base[:base_size]).digest() != patch[12:44]:
+        raise ValueError('patch was built against a different base image')
+
+    out = bytearray()
+    position = 44
+    while True:
+        op = patch[position]
+        position += 1
+        if op == OP_END:
+            break
+        if op == OP_COPY:
+            offset, length = struct.unpack_from('<II', patch, position)
+            position += 8
+            if offset + length > base_size:
+                raise ValueError(f'copy out of range: {offset}+{length}')
+            out += base[offset:offset + length]
+        elif op == OP_INSERT:
+            (length,) = struct.unpack_from('<I', patch, position)
+            position += 4
+            out += patch[position:position + length]
+            position += length
+        else:
+            raise ValueError(f'unknown patch op 0x{op:02x}')
+        if len(out) > target_size:
+            raise ValueError('patch output exceeds target size')
+
+    if position != len(patch) or len(out) != target_size:
+        raise ValueError('patch is truncated')
+    return bytes(out)
+
+
+def decode(image, base=None):
+    data = zlib.decompress(image)
+    if data[:4] == DELTA_MAGIC:
+        if base is None:
+            raise ValueError('delta image needs --base')
+        return apply_patch(data, base)
+    return data
+
+
+def read(path):
+    with open(path, 'rb') as f:
+        return f.read()
+
+
+def write(path, data):
+    with open(path, 'wb') as f:
+        f.write(data)
+
+
+def build_compressed(target):
+    image = zlib.compress(target, 9)
+    if decode(image) != target:
+        sys.exit('roundtrip check failed')
+    return image
+
+
+def build_delta(base, target):
+    patch, ops = make_patch(base, target)
+    image = zlib.compress(patch, 9)
+    if decode(image, base) != target:
+        sys.exit('roundtrip check failed')
+    return image, ops
+
+
+def make_fixture_images():
+    # 固定种子生成类似固件的数据：重复出现的代码块夹杂少量随机字节
+    rng = random.Random(20250601)
+    blocks = [rng.randbytes(256) for _ in range(16)]
+    base = bytearray()
+    while len(base) < 32 * 1024:
+        base += blocks[rng.randrange(len(blocks))]
+        base += rng.randbytes(rng.randrange(64))
+
+    # 新版本修改、插入、删除几段，并在末尾追加数据
+    target = bytearray(base)
+    target[1000:1100] = rng.randbytes(100)
+    target[8000:8000] = rng.randbytes(3000)
+    del target[20000:22000]
+    target += rng.randbytes(500)
+    return bytes(base), bytes(target)
+
+
+def cmd_compress(args):
+    target = read(args.firmware)
+    image = build_compressed(target)
+    write(args.output, image)
+    print(f"{len(target)} -> {len(image)} bytes ({len(image) * 100 / len(target):.1f}%)")
+    print(f"sha256 {hashlib.sha256(image).hexdigest()}")
+
+
+def cmd_diff(args):
+    base = read(args.base)
+    target = read(args.firmware)
+    image, ops = build_delta(base, target)
+    write(args.output, image)
+
+    copied = sum(op[2] for op in ops if op[0] == OP_COPY)
+    print(f"{len(ops)} ops, {copied} of {len(target)} bytes copied from base")
+    print(f"{len(target)} -> {len(image)} bytes ({len(image) * 100 / len(target):.1f}%)")
+    print(f"sha256 {hashlib.sha256(image).hexdigest()}")
+
+
+def cmd_apply(args):
+    base = read(args.base) if args.base else None
+    try:
+        target = decode(read(args.image), base)
+    except (ValueError, zlib.error) as e:
+        sys.exit(f'failed to decode: {e}')
+    write(args.output, target)
+    print(f"{len(target)} bytes, sha256 {hashlib.sha256(target).hexdigest()}")
+
+
+def cmd_fixtures(args):
+    base, target = make_fixture_images()
+    compressed = build_compressed(target)
+    delta, ops = build_delta(base, target)
+
+    os.makedirs(args.output, exist_ok=True)
+    files = {
+        'base.bin': base,
+        'target.bin': target,
+        'target.bin.z': compressed,
+        'target.patch': delta,
+        'target.sha256': hashlib.sha256(target).hexdigest().encode(),
+    }
+    for name, data in files.items():
+        write(os.path.join(args.output, name), data)
+        print(f"{name}: {len(data)} bytes")
+    print(f"{len(ops)} ops, target sha256 {hashlib.sha256(target).hexdigest()}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description='生成 OTA 压缩镜像和差分补丁')
+    subparsers = parser.add_subparsers(dest='command', required=True)
+
+    p = subparsers.add_parser('compress', help='压缩完整固件')
+    p.add_argument('firmware', help='新固件，例如 build/xiaozhi.bin')
+    p.add_argument('--output', '-o', required=True, help='输出文件')
+    p.set_defaults(func=cmd_compress)
+
+    p = subparsers.add_parser('diff', help='生成相对于设备上运行固件的补丁')
+    p.add_argument('firmware', help='新固件，例如 build/xiaozhi.bin')
+    p.add_argument('--base', '-b', required=True, help='设备上正在运行的固件')
+    p.add_argument('--output', '-o', required=True, help='输出文件')
+    p.set_defaults(func=cmd_diff)
+
+    p = subparsers.add_parser('apply', help='解码压缩镜像或补丁，用于检查')
+    p.add_argument('image', help='compress 或 diff 生成的文件')
+    p.add_argument('--base', '-b', help='补丁的基础固件')
+    p.add_argument('--output', '-o', required=True, help='输出文件')
+    p.set_defaults(func=cmd_apply)
+
+    p = subparsers.add_parser('fixtures', help='生成设备端解码测试使用的测试向量')
+    p.add_argument('--output', '-o', required=True, help='输出目录')
+    p.set_defaults(func=cmd_fixtures)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == '__main__':
+    main()
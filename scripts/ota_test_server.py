@@ -0,0 +1,200 @@
+#!/usr/bin/env python3
+"""
+Local OTA stand-in server for measuring firmware upgrade throughput.
+
+The device asks this server for the version (set its `ota_url` to
+http://<host>:<port>/xiaozhi/ota/) and downloads the firmware from it. The
+firmware is served at a throttled rate so the download / flash write pipeline
+can be measured under different network speeds.
+
+    python scripts/ota_test_server.py build/xiaozhi.bin --version 9.9.9 --rate 200
+
+Every finished transfer prints its size, duration and average speed. Compare it
+with the "Downloaded ... B/s" line in the device log.
+
+Range / If-Range requests are supported for resumable downloads. With --drop the
+server cuts each transfer at a random point with the given probability, and with
+--change it serves a different ETag so the device has to restart from zero:
+
+    python scripts/ota_test_server.py build/xiaozhi.bin --rate 100 --drop 0.7
+
+Compressed images and patches from scripts/ota_delta.py are served the same way,
+--format and --base-version are passed to the device in the version JSON:
+
+    python scripts/ota_test_server.py xiaozhi.patch --format delta --base-version 1.6.0
+
+A model pack (build/srmodels/srmodels.bin) can be offered next to the firmware with
+--models; the device installs it when --models-version differs from its own:
+
+    python scripts/ota_test_server.py build/xiaozhi.bin --version 0.0.0 --models build/srmodels/srmodels.bin
+"""
+import argparse
+import hashlib
+import json
+import os
+import random
+import re
+import socket
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+def get_local_ip():
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    try:
+        s.connect(('8.8.8.8', 80))
+        return s.getsockname()[0]
+    except OSError:
+        return '127.0.0.1'
+    finally:
+        s.close()
+
+
+class OtaHandler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+
+    def log_message(self, format, *args):
+        print(f"{self.address_string()} - {format % args}")
+
+    def send_version(self):
+        host = self.headers.get('Host') or f"{self.server.public_ip}:{self.server.server_port}"
+        firmware = {
+            'version': self.server.args.version,
+            'url': f"http://{host}/firmware.bin",
+            'sha256': self.server.firmware_sha256,
+            'format': self.server.args.format,
+        }
+        if self.server.args.base_version:
+            firmware['base_version'] = self.server.args.base_version
+        response = {'firmware': firmware}
+        if self.server.models is not None:
+            response['models'] = {
+                'version': self.server.args.models_version,
+                'url': f"http://{host}/models.bin",
+                'sha256': self.server.models_sha256,
+            }
+        body = json.dumps(response).encode()
+        self.send_response(200)
+        self.send_header('Content-Type', 'application/json')
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def send_firmware(self, data, etag):
+        start, end = 0, len(data) - 1
+
+        # 只有 If-Range 与当前 ETag 一致时才按 Range 返回部分内容
+        range_header = self.headers.get('Range')
+        if_range = self.headers.get('If-Range')
+        match = re.match(r'bytes=(\d+)-(\d*)$', range_header or '')
+        if match and (if_range is None or if_range == etag):
+            start = int(match.group(1))
+            if match.group(2):
+                end = min(int(match.group(2)), end)
+            if start > end:
+                self.send_response(416)
+                self.send_header('Content-Range', f"bytes */{len(data)}")
+                self.send_header('Content-Length', '0')
+                self.end_headers()
+                return
+            self.send_response(206)
+            self.send_header('Content-Range', f"bytes {start}-{end}/{len(data)}")
+        else:
+            self.send_response(200)
+        self.send_header('Content-Type', 'application/octet-stream')
+        self.send_header('Content-Length', str(end - start + 1))
+        self.send_header('Accept-Ranges', 'bytes')
+        self.send_header('ETag', etag)
+        self.end_headers()
+
+        # 按概率在随机位置断开连接，模拟不稳定的网络
+        drop_at = None
+        if random.random() < self.server.args.drop:
+            drop_at = random.randint(start, end)
+
+        rate = self.server.args.rate * 1024
+        chunk_size = self.server.args.chunk
+        begin = time.monotonic()
+        sent = 0
+        position = start
+        try:
+            while position <= end:
+                chunk_end = min(position + chunk_size, end + 1)
+                if drop_at is not None and chunk_end > drop_at:
+                    self.wfile.write(data[position:drop_at])
+                    self.wfile.flush()
+                    print(f"Dropping connection at {drop_at}/{len(data)}")
+                    self.close_connection = True
+                    self.connection.shutdown(socket.SHUT_RDWR)
+                    return
+                self.wfile.write(data[position:chunk_end])
+                sent += chunk_end - position
+                position = chunk_end
+                if rate > 0:
+                    # 按目标速率限速
+                    delay = begin + sent / rate - time.monotonic()
+                    if delay > 0:
+                        time.sleep(delay)
+        except (BrokenPipeError, ConnectionResetError):
+            print(f"Connection closed after {sent} bytes")
+            return
+        elapsed = time.monotonic() - begin
+        print(f"Sent {sent} bytes ({start}-{end}) in {elapsed:.2f}s, {sent / elapsed / 1024:.1f} KB/s")
+
+    def do_GET(self):
+        if self.path.startswith('/firmware.bin'):
+            self.send_firmware(self.server.firmware, self.server.etag)
+        elif self.path.startswith('/models.bin') and self.server.models is not None:
+            self.send_firmware(self.server.models, f'"{self.server.models_sha256[:16]}"')
+        else:
+            self.send_version()
+
+    def do_POST(self):
+        length = int(self.headers.get('Content-Length', 0))
+        self.rfile.read(length)
+        self.send_version()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='本地 OTA 测试服务器，限速提供固件下载')
+    parser.add_argument('firmware', help='固件文件，例如 build/xiaozhi.bin')
+    parser.add_argument('--version', '-v', default='9.9.9', help='返回给设备的版本号，需高于当前版本')
+    parser.add_argument('--port', '-p', type=int, default=8080, help='监听端口 (默认: 8080)')
+    parser.add_argument('--rate', '-r', type=int, default=0, help='限速 KB/s，0 表示不限速')
+    parser.add_argument('--chunk', type=int, default=1460, help='每次发送的字节数 (默认: 1460)')
+    parser.add_argument('--drop', type=float, default=0, help='每次传输中途断开的概率 0-1 (默认: 0)')
+    parser.add_argument('--change', action='store_true', help='使用随机 ETag，模拟服务器上的固件已更换')
+    parser.add_argument('--format', choices=['raw', 'deflate', 'delta'], default='raw', help='固件格式 (默认: raw)')
+    parser.add_argument('--base-version', help='delta 格式的基础版本，即设备上正在运行的版本')
+    parser.add_argument('--models', help='模型包，例如 build/srmodels/srmodels.bin')
+    parser.add_argument('--models-version', default='test', help='模型包版本，与设备上的不同即会更新 (默认: test)')
+    args = parser.parse_args()
+    if args.format == 'delta' and not args.base_version:
+        parser.error('--format delta requires --base-version')
+
+    server = ThreadingHTTPServer(('0.0.0.0', args.port), OtaHandler)
+    server.args = args
+    with open(args.firmware, 'rb') as f:
+        server.firmware = f.read()
+    server.firmware_sha256 = hashlib.sha256(server.firmware).hexdigest()
+    server.etag = f'"{server.firmware_sha256[:16]}"'
+    if args.change:
+        server.etag = f'"{random.getrandbits(64):016x}"'
+    server.public_ip = get_local_ip()
+    server.models = None
+    if args.models:
+        with open(args.models, 'rb') as f:
+            server.models = f.read()
+        server.models_sha256 = hashlib.sha256(server.models).hexdigest()
+        print(f"Serving models {os.path.basename(args.models)} ({len(server.models)} bytes, version {args.models_version})")
+
+    print(f"Serving {os.path.basename(args.firmware)} ({len(server.firmware)} bytes, sha256 {server.firmware_sha256})")
+    print(f"Set the device ota_url to http://{server.public_ip}:{args.port}/xiaozhi/ota/")
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+"""
+Local stand-in server for the device-side TTS cache (CONFIG_USE_TTS_CACHE).
+
+Every time the device starts listening, the server answers with the same
+sentences. Each sentence is a .p3 file (see scripts/p3_tools) announced with
+`sentence_start` and a hash of the file, then streamed in real time. When the
+device replies `cache_hit` the rest of that sentence is skipped.
+
+    pip install websockets
+    python scripts/tts_cache_test_server.py main/assets/common/success.p3 main/assets/common/exclamation.p3
+
+Point the device at http://<host>:8002/xiaozhi/ota/ (the OTA response only
+contains the websocket section) and talk to it a few times. The first answer
+is a miss, later answers should be hits. Each answer prints the downlink bytes
+and the time until the first frame was sent or the first hit arrived:
+
+    answer 2: <hits>/<sentences> sentences hit, <sent> of <total> bytes sent, first audio after <ms> ms
+"""
+import argparse
+import asyncio
+import hashlib
+import json
+import os
+import socket
+import struct
+import threading
+import time
+import uuid
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+import websockets
+
+
+def get_local_ip():
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    try:
+        s.connect(('8.8.8.8', 80))
+        return s.getsockname()[0]
+    except OSError:
+        return '127.0.0.1'
+    finally:
+        s.close()
+
+
+def load_p3(path):
+    frames = []
+    with open(path, 'rb') as f:
+        data = f.read()
+    position = 0
+    while position + 4 <= len(data):
+        _, _, size = struct.unpack('>BBH', data[position:position + 4])
+        frames.append(data[position + 4:position + 4 + size])
+        position += 4 + size
+    return {
+        'text': os.path.basename(path),
+        'hash': hashlib.sha256(data).hexdigest()[:32],
+        'frames': frames,
+    }
+
+
+class Session:
+    def __init__(self, ws, args, sentences):
+        self.ws = ws
+        self.args = args
+        self.sentences = sentences
+        self.session_id = str(uuid.uuid4())
+        self.hits = set()
+        self.answering = None
+        self.answers = 0
+        self.first_hit = None
+
+    def message(self, **fields):
+        return json.dumps({'session_id': self.session_id, **fields})
+
+    async def answer(self):
+        self.answers += 1
+        self.hits.clear()
+        self.first_hit = None
+        start = time.monotonic()
+        first_audio = None
+        sent = total = 0
+        await self.ws.send(self.message(type='stt', text='(tts cache test)'))
+        await self.ws.send(self.message(type='tts', state='start'))
+        for sentence in self.sentences:
+            await self.ws.send(self.message(type='tts', state='sentence_start',
+                                            text=sentence['text'], hash=sentence['hash']))
+            # 给设备回复 cache_hit 的时间，与真实服务器合成第一帧的耗时相当
+            await asyncio.sleep(self.args.synth_delay / 1000)
+            for frame in sentence['frames']:
+                total += len(frame)
+                if sentence['hash'] in self.hits:
+                    continue
+                if first_audio is None:
+                    first_audio = time.monotonic()
+                await self.ws.send(frame)
+                sent += len(frame)
+                await asyncio.sleep(self.args.frame_duration / 1000)
+        await self.ws.send(self.message(type='tts', state='stop'))
+
+        # 命中时设备在收到 sentence_start 后立即本地播放
+        if self.first_hit is not None and (first_audio is None or self.first_hit < first_audio):
+            first_audio = self.first_hit
+        hits = sum(1 for s in self.sentences if s['hash'] in self.hits)
+        print(f"answer {self.answers}: {hits}/{len(self.sentences)} sentences hit, "
+              f"{sent} of {total} bytes sent, first audio after {((first_audio or time.monotonic()) - start) * 1000:.0f} ms")
+
+    async def run(self):
+        async for data in self.ws:
+            if isinstance(data, bytes):
+                continue
+            msg = json.loads(data)
+            kind, state = msg.get('type'), msg.get('state')
+            if kind == 'hello':
+                print(f"hello, features: {msg.get('features')}")
+                await self.ws.send(json.dumps({
+                    'type': 'hello', 'transport': 'websocket', 'session_id': self.session_id,
+                    'audio_params': {'format': 'opus', 'sample_rate': self.args.sample_rate,
+                                     'channels': 1, 'frame_duration': self.args.frame_duration},
+                }))
+            elif kind == 'tts' and state == 'cache_hit':
+                self.hits.add(msg.get('hash'))
+                if self.first_hit is None:
+                    self.first_hit = time.monotonic()
+            elif kind == 'listen' and state in ('start', 'detect'):
+                if self.answering is None or self.answering.done():
+                    self.answering = asyncio.create_task(self.answer())
+            elif kind == 'abort' and self.answering is not None:
+                self.answering.cancel()
+                await self.ws.send(self.message(type='tts', state='stop'))
+
+
+class OtaHandler(BaseHTTPRequestHandler):
+    def log_message(self, format, *args):
+        pass
+
+    def do_POST(self):
+        self.do_GET()
+
+    def do_GET(self):
+        body = json.dumps({
+            'websocket': {'url': self.server.websocket_url, 'token': 'test', 'version': 1},
+        }).encode()
+        self.send_response(200)
+        self.send_header('Content-Type', 'application/json')
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+
+async def main():
+    parser = argparse.ArgumentParser(description='TTS 缓存测试服务器')
+    parser.add_argument('sentences', nargs='+', help='每句对应一个 .p3 文件')
+    parser.add_argument('--port', type=int, default=8001, help='websocket 端口')
+    parser.add_argument('--ota-port', type=int, default=8002, help='OTA 端口')
+    parser.add_argument('--sample-rate', type=int, default=16000, help='p3 文件的采样率')
+    parser.add_argument('--frame-duration', type=int, default=60, help='p3 文件的帧长 (ms)')
+    parser.add_argument('--synth-delay', type=int, default=300, help='模拟合成每句第一帧的耗时 (ms)')
+    args = parser.parse_args()
+
+    sentences = [load_p3(path) for path in args.sentences]
+    ip = get_local_ip()
+
+    ota = ThreadingHTTPServer(('0.0.0.0', args.ota_port), OtaHandler)
+    ota.websocket_url = f"ws://{ip}:{args.port}/xiaozhi/v1/"
+    threading.Thread(target=ota.serve_forever, daemon=True).start()
+    print(f"OTA url: http://{ip}:{args.ota_port}/xiaozhi/ota/")
+    print(f"Websocket url: {ota.websocket_url}")
+
+    async def handler(ws, *_):
+        print(f"device connected: {ws.remote_address}")
+        await Session(ws, args, sentences).run()
+
+    async with websockets.serve(handler, '0.0.0.0', args.port):
+        await asyncio.Future()
+
+
+if __name__ == '__main__':
+    asyncio.run(main())
@@ -0,0 +1,137 @@
+/*
+ * 用 scripts/ota_delta.py 生成的测试向量检查设备上的 InflateDecoder / DeltaDecoder。
+ * 解码结果必须与 target.bin 完全一致，SHA-256 与 target.sha256 一致。
+ */
+#include "ota_decoder.h"
+
+#include <unity.h>
+#include <mbedtls/sha256.h>
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+extern const uint8_t base_bin_start[] asm("_binary_base_bin_start");
+extern const uint8_t base_bin_end[] asm("_binary_base_bin_end");
+extern const uint8_t target_bin_start[] asm("_binary_target_bin_start");
+extern const uint8_t target_bin_end[] asm("_binary_target_bin_end");
+extern const uint8_t target_bin_z_start[] asm("_binary_target_bin_z_start");
+extern const uint8_t target_bin_z_end[] asm("_binary_target_bin_z_end");
+extern const uint8_t target_patch_start[] asm("_binary_target_patch_start");
+extern const uint8_t target_patch_end[] asm("_binary_target_patch_end");
+extern const char target_sha256_start[] asm("_binary_target_sha256_start");
+
+// 不同的分块大小覆盖字段跨越两次 Feed 的情况
+static const size_t kChunkSizes[] = {1, 61, 4096, 64 * 1024};
+
+static std::string Sha256Hex(const std::vector<uint8_t>& data) {
+    uint8_t digest[32];
+    mbedtls_sha256(data.data(), data.size(), digest, 0);
+    std::string hex;
+    char byte[3];
+    for (int i = 0; i < 32; i++) {
+        snprintf(byte, sizeof(byte), "%02x", digest[i]);
+        hex += byte;
+    }
+    return hex;
+}
+
+static void CheckOutput(const std::vector<uint8_t>& output) {
+    size_t target_size = target_bin_end - target_bin_start;
+    TEST_ASSERT_EQUAL(target_size, output.size());
+    TEST_ASSERT_EQUAL_MEMORY(target_bin_start, output.data(), target_size);
+    TEST_ASSERT_EQUAL_STRING(target_sha256_start, Sha256Hex(output).c_str());
+}
+
+static bool Feed(OtaDecoder& decoder, const uint8_t* start, const uint8_t* end, size_t chunk_size) {
+    size_t size = end - start;
+    for (size_t offset = 0; offset < size; offset += chunk_size) {
+        if (!decoder.Feed(start + offset, std::min(chunk_size, size - offset))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static DeltaDecoder::BaseReader ReadBase(const uint8_t* base, size_t base_size) {
+    return [base, base_size](uint32_t offset, uint8_t* data, size_t size) {
+        if (offset + size > base_size) {
+            return false;
+        }
+        memcpy(data, base + offset, size);
+        return true;
+    };
+}
+
+TEST_CASE("Inflate the compressed image", "[ota_decoder]")
+{
+    for (size_t chunk_size : kChunkSizes) {
+        std::vector<uint8_t> output;
+        InflateDecoder decoder([&output](const uint8_t* data, size_t size) {
+            output.insert(output.end(), data, data + size);
+            return true;
+        });
+        TEST_ASSERT_TRUE(Feed(decoder, target_bin_z_start, target_bin_z_end, chunk_size));
+        TEST_ASSERT_TRUE(decoder.Finish());
+        CheckOutput(output);
+    }
+}
+
+TEST_CASE("Reject a truncated compressed image", "[ota_decoder]")
+{
+    InflateDecoder decoder([](const uint8_t* data, size_t size) {
+        return true;
+    });
+    size_t size = target_bin_z_end - target_bin_z_start;
+    decoder.Feed(target_bin_z_start, size / 2);
+    TEST_ASSERT_FALSE(decoder.Finish());
+}
+
+TEST_CASE("Apply the delta image to the base", "[ota_decoder]")
+{
+    size_t base_size = base_bin_end - base_bin_start;
+    for (size_t chunk_size : kChunkSizes) {
+        std::vector<uint8_t> output;
+        // 与 Ota::TryUpgrade 相同：先解压，再把补丁交给 DeltaDecoder
+        DeltaDecoder patcher(ReadBase(base_bin_start, base_size), base_size, [&output](const uint8_t* data, size_t size) {
+            output.insert(output.end(), data, data + size);
+            return true;
+        });
+        InflateDecoder decoder([&patcher](const uint8_t* data, size_t size) {
+            return patcher.Feed(data, size);
+        });
+        TEST_ASSERT_TRUE(Feed(decoder, target_patch_start, target_patch_end, chunk_size));
+        TEST_ASSERT_TRUE(decoder.Finish());
+        TEST_ASSERT_TRUE(patcher.Finish());
+        TEST_ASSERT_EQUAL(target_bin_end - target_bin_start, patcher.target_size());
+        CheckOutput(output);
+    }
+}
+
+TEST_CASE("Reject the delta image on a different base", "[ota_decoder]")
+{
+    size_t base_size = base_bin_end - base_bin_start;
+    std::vector<uint8_t> base(base_bin_start, base_bin_end);
+    base[base_size / 2] ^= 0xff;
+
+    size_t output_size = 0;
+    DeltaDecoder patcher(ReadBase(base.data(), base_size), base_size, [&output_size](const uint8_t* data, size_t size) {
+        output_size += size;
+        return true;
+    });
+    InflateDecoder decoder([&patcher](const uint8_t* data, size_t size) {
+        return patcher.Feed(data, size);
+    });
+    TEST_ASSERT_FALSE(Feed(decoder, target_patch_start, target_patch_end, 4096));
+    TEST_ASSERT_FALSE(patcher.Finish());
+    TEST_ASSERT_EQUAL(0, output_size);
+}
+
+extern "C" void app_main(void)
+{
+    UNITY_BEGIN();
+    unity_run_all_tests();
+    UNITY_END();
+}